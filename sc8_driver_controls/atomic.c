@@ -0,0 +1,72 @@
+/*
+ * Tritium ISR and main loop shared state
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Posts and consumes event flags without losing flags that interrupts set or clear at the same time
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include <signal.h>
+#include "tri86.h"
+#include "atomic.h"
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Set event flags
+ */
+void event_post( unsigned int mask )
+{
+	unsigned int sr;
+
+	ATOMIC_BEGIN( sr );
+	events |= mask;
+	ATOMIC_END( sr );
+}
+
+/*
+ * Clear event flags
+ */
+void event_clear( unsigned int mask )
+{
+	unsigned int sr;
+
+	ATOMIC_BEGIN( sr );
+	events &= ~mask;
+	ATOMIC_END( sr );
+}
+
+/*
+ * Test and clear event flags in one step
+ *	- Returns whichever of the flags in mask were set
+ */
+unsigned int event_consume( unsigned int mask )
+{
+	unsigned int sr, set;
+
+	ATOMIC_BEGIN( sr );
+	set = events & mask;
+	events &= ~set;
+	ATOMIC_END( sr );
+	return( set );
+}
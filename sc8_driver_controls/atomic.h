@@ -0,0 +1,43 @@
+/*
+ * Tritium ISR and main loop shared state header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following shared state functions
+ *	- event_post
+ *	- event_clear
+ *	- event_consume
+ *
+ */
+
+// Public function prototypes
+extern void event_post( unsigned int mask );
+extern void event_clear( unsigned int mask );
+extern unsigned int event_consume( unsigned int mask );
+
+// Hold interrupts off around a section, and put GIE back as it was
+//	- Safe to use before interrupts are enabled at startup, and inside an ISR
+#define ATOMIC_BEGIN(sr)		{ sr = READ_SR; dint(); }
+#define ATOMIC_END(sr)			{ if( sr & GIE ) eint(); }
+
+// Rules for data shared between the main loop and the interrupts
+//	- Interrupts never nest, so ISR code can use events directly
+//	- Main loop code changes events only through the functions above: a plain |= or &= is a load, modify and store
+//	  unless the compiler happens to emit a single bis or bic, and a flag an ISR posts in between is lost
+//	- Anything an ISR uses that is wider than a word, or spread over several variables, is written by the main loop into
+//	  a pending copy and published with an event, which the ISR consumes and latches into its own working copy
@@ -0,0 +1,517 @@
+/*
+ * Tritium CAN bootloader
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Resident CAN bootloader, linked as its own image into a protected flash region (see msp430x247_boot.x)
+ * - Owns the reset and interrupt vectors; interrupts are forwarded to the application vector table
+ * - Starts the application straight away unless it was asked to stay, or there is no valid application
+ * - Receives firmware in segment sized blocks with windowed acknowledgements, CRC checks each block,
+ *   programs and verifies it, and only writes the application reset vector once the whole image checks out
+ * - Completely self contained: it runs with interrupts off, before the C startup code, and while the
+ *   application region is erased, so it only uses locals and its own copies of the SPI, CAN and flash routines
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "bootload.h"
+
+// Private function prototypes
+void boot_start( void ) BOOT_CODE;
+void boot_run( void ) BOOT_CODE;
+void boot_exit( void ) BOOT_CODE;
+char boot_app_valid( void ) BOOT_CODE;
+signed char boot_program( unsigned int address, unsigned char *data, unsigned int bytes, unsigned int crc, unsigned int *reset_vector ) BOOT_CODE;
+signed char boot_finish( unsigned int crc, unsigned int reset_vector ) BOOT_CODE;
+unsigned int boot_crc( unsigned int crc, unsigned char *ptr, unsigned int bytes ) BOOT_CODE;
+void boot_flash_erase( unsigned int address ) BOOT_CODE;
+void boot_flash_write( unsigned int address, unsigned char *data, unsigned int bytes ) BOOT_CODE;
+unsigned char boot_spi( unsigned char data ) BOOT_CODE;
+unsigned char boot_mcp_read( unsigned char address ) BOOT_CODE;
+void boot_mcp_write( unsigned char address, unsigned char data ) BOOT_CODE;
+void boot_mcp_mode( unsigned char mode ) BOOT_CODE;
+void boot_can_init( void ) BOOT_CODE;
+unsigned int boot_can_receive( unsigned char *data ) BOOT_CODE;
+void boot_reply( unsigned char command, signed char result, unsigned int sequence, unsigned int value_a, unsigned int value_b ) BOOT_CODE;
+
+// Interrupt forwarding stubs, one "br &vector" instruction per application vector
+#define BOOT_STUB(n)			{ 0x4210, BOOT_APP_VECTORS + ((n) << 1) }
+const unsigned int boot_stubs[BOOT_VECTORS][2] BOOT_CODE = {
+	BOOT_STUB( 0), BOOT_STUB( 1), BOOT_STUB( 2), BOOT_STUB( 3), BOOT_STUB( 4), BOOT_STUB( 5), BOOT_STUB( 6), BOOT_STUB( 7),
+	BOOT_STUB( 8), BOOT_STUB( 9), BOOT_STUB(10), BOOT_STUB(11), BOOT_STUB(12), BOOT_STUB(13), BOOT_STUB(14), BOOT_STUB(15),
+	BOOT_STUB(16), BOOT_STUB(17), BOOT_STUB(18), BOOT_STUB(19), BOOT_STUB(20), BOOT_STUB(21), BOOT_STUB(22), BOOT_STUB(23),
+	BOOT_STUB(24), BOOT_STUB(25), BOOT_STUB(26), BOOT_STUB(27), BOOT_STUB(28), BOOT_STUB(29), BOOT_STUB(30), BOOT_STUB(31)
+};
+
+// Hardware vector table
+#define BOOT_VECTOR(n)			((void (*)(void))boot_stubs[n])
+void (* const boot_vectors[BOOT_VECTORS])(void) BOOT_VECTOR_TABLE = {
+	BOOT_VECTOR( 0), BOOT_VECTOR( 1), BOOT_VECTOR( 2), BOOT_VECTOR( 3), BOOT_VECTOR( 4), BOOT_VECTOR( 5), BOOT_VECTOR( 6), BOOT_VECTOR( 7),
+	BOOT_VECTOR( 8), BOOT_VECTOR( 9), BOOT_VECTOR(10), BOOT_VECTOR(11), BOOT_VECTOR(12), BOOT_VECTOR(13), BOOT_VECTOR(14), (void (*)(void))0xFFFF,
+	BOOT_VECTOR(16), BOOT_VECTOR(17), BOOT_VECTOR(18), BOOT_VECTOR(19), BOOT_VECTOR(20), BOOT_VECTOR(21), BOOT_VECTOR(22), BOOT_VECTOR(23),
+	BOOT_VECTOR(24), BOOT_VECTOR(25), BOOT_VECTOR(26), BOOT_VECTOR(27), BOOT_VECTOR(28), BOOT_VECTOR(29), BOOT_VECTOR(30), boot_reset
+};
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Reset entry point
+ *	- Nothing has set up the stack yet, so do that before calling anything
+ */
+__attribute__ ((naked)) BOOT_CODE void boot_reset( void )
+{
+	__asm__ __volatile__( "mov #0x2100, r1" );		// BOOT_STACK_TOP
+	WDTCTL = WDTPW | WDTHOLD;
+	boot_start();
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Decide whether to stay, then run the bootloader
+ *	- Never returns
+ */
+void boot_start( void )
+{
+	unsigned char block[BOOT_SEGMENT_SIZE];
+	unsigned char rx[8];
+	unsigned int address, block_address, block_bytes, block_crc, offset, reset_vector, idle;
+	unsigned char sequence, unacked, nak_sent, i;
+	signed char result;
+
+	// Stay only when asked to, or when there is nothing to run
+	if((( BOOT_HANDOFF != BOOT_HANDOFF_KEY ) || ( BOOT_HANDOFF_CHECK != (unsigned int)~BOOT_HANDOFF_KEY )) && ( boot_app_valid() == TRUE )) boot_run();
+	BOOT_HANDOFF = 0x0000;
+
+	// Clock, as clock_init()
+	BCSCTL1 = CALBC1_16MHZ;
+	DCOCTL = CALDCO_16MHZ;
+
+	// I/O: CAN controller, CAN bus power, and the front panel LEDs, green on while bootloading
+	P1OUT = CAN_PWR_OUT;
+	P1DIR = CAN_PWR_OUT;
+	P3OUT = CAN_CSn | LED_REDn;
+	P3DIR = CAN_CSn | CAN_MOSI | CAN_SCLK | LED_REDn | LED_GREENn;
+
+	// SPI, as usci_init(0)
+	P3SEL |= CAN_MOSI | CAN_MISO | CAN_SCLK;
+	UCB0CTL1 = UCSSEL_2 | UCSWRST;
+	UCB0CTL0 |= UCMST | UCSYNC | UCCKPL | UCMSB;
+	UCB0BR0 = 0x02;
+	UCB0BR1 = 0;
+	UCB0CTL1 &= ~UCSWRST;
+
+	// Timer A free running for timeouts
+	TACTL = TASSEL_2 | ID_3 | MC_2 | TACLR;
+
+	boot_can_init();
+	boot_reply( BOOT_CMD_PING, BOOT_OK, 0, BOOT_APP_START, BOOT_APP_END );
+
+	block_address = 0;
+	block_bytes = 0;
+	block_crc = 0;
+	offset = 0;
+	sequence = 0;
+	unacked = 0;
+	nak_sent = FALSE;
+	reset_vector = 0xFFFF;
+	idle = 0;
+
+	while( TRUE ){
+		// Go back to a valid application if the host goes away
+		if( TACTL & TAIFG ){
+			TACTL &= ~TAIFG;
+			idle++;
+			if(( idle >= BOOT_TIMEOUT ) && ( boot_app_valid() == TRUE )) boot_exit();
+		}
+
+		address = boot_can_receive( rx );
+		if( address == 0 ) continue;
+		idle = 0;
+
+		if( address == DC_CAN_BASE + DC_BOOT_DATA ){
+			// Block data, must arrive in sequence
+			if( block_bytes == 0 ) continue;
+			if( rx[0] != sequence ){
+				if( nak_sent == FALSE ) boot_reply( BOOT_REPLY_ACK, BOOT_ERROR_SEQUENCE, sequence, block_address, offset );
+				nak_sent = TRUE;
+				continue;
+			}
+			nak_sent = FALSE;
+			for( i = 1; ( i <= BOOT_DATA_BYTES ) && ( offset < block_bytes ); i++ ) block[offset++] = rx[i];
+			sequence++;
+			if( offset >= block_bytes ){
+				P3OUT ^= LED_REDn;
+				result = boot_program( block_address, block, block_bytes, block_crc, &reset_vector );
+				block_bytes = 0;
+				boot_reply( BOOT_CMD_BLOCK, result, sequence, block_address, offset );
+			}
+			else if( ++unacked >= BOOT_WINDOW ){
+				unacked = 0;
+				boot_reply( BOOT_REPLY_ACK, BOOT_OK, sequence, block_address, offset );
+			}
+		}
+		else if( address == DC_CAN_BASE + DC_BOOTLOAD ){
+			switch( rx[0] ){
+				case 'B':						// "BOOTLOAD" from a host that thinks the application is running
+				case BOOT_CMD_PING:
+					boot_reply( BOOT_CMD_PING, BOOT_OK, 0, BOOT_APP_START, BOOT_APP_END );
+					break;
+				case BOOT_CMD_ERASE:
+					P3OUT &= ~LED_REDn;
+					for( address = BOOT_APP_START; address < BOOT_APP_END; address += BOOT_SEGMENT_SIZE ) boot_flash_erase( address );
+					P3OUT |= LED_REDn;
+					block_bytes = 0;
+					reset_vector = 0xFFFF;
+					boot_reply( BOOT_CMD_ERASE, BOOT_OK, 0, 0, 0 );
+					break;
+				case BOOT_CMD_BLOCK:
+					block_address = rx[2] | ( rx[3] << 8 );
+					block_bytes = rx[4] | ( rx[5] << 8 );
+					block_crc = rx[6] | ( rx[7] << 8 );
+					if(( block_address < BOOT_APP_START ) || ( block_address >= BOOT_APP_END ) || ( block_address & ( BOOT_SEGMENT_SIZE - 1 ))
+							|| ( block_bytes == 0 ) || ( block_bytes > BOOT_SEGMENT_SIZE ) || ( block_bytes & 0x0001 )
+							|| ( block_bytes > ( BOOT_APP_END - block_address ))){
+						block_bytes = 0;
+						boot_reply( BOOT_CMD_BLOCK, BOOT_ERROR_ADDRESS, 0, block_address, 0 );
+						break;
+					}
+					offset = 0;
+					sequence = 0;
+					unacked = 0;
+					nak_sent = FALSE;
+					break;
+				case BOOT_CMD_DONE:
+					result = boot_finish( rx[4] | ( rx[5] << 8 ), reset_vector );
+					boot_reply( BOOT_CMD_DONE, result, 0, 0, 0 );
+					break;
+				case BOOT_CMD_RUN:
+					if( boot_app_valid() == TRUE ){
+						boot_reply( BOOT_CMD_RUN, BOOT_OK, 0, 0, 0 );
+						boot_exit();
+					}
+					boot_reply( BOOT_CMD_RUN, BOOT_ERROR_INVALID, 0, 0, 0 );
+					break;
+				default:
+					boot_reply( rx[0], BOOT_ERROR_COMMAND, 0, 0, 0 );
+					break;
+			}
+		}
+	}
+}
+
+/*
+ * Jump to the application's own reset handler
+ */
+void boot_run( void )
+{
+	((void (*)(void))( *(volatile unsigned int *)BOOT_APP_RESET ))();
+}
+
+/*
+ * Leave the bootloader through a clean reset, so the application starts from reset state
+ */
+void boot_exit( void )
+{
+	unsigned int i;
+
+	// Let the last reply get onto the bus
+	for( i = 0; i < BOOT_TX_POLLS; i++ ){
+		if(( boot_mcp_read( TXB0CTRL ) & 0x08 ) == 0x00 ) break;
+	}
+	BOOT_HANDOFF = 0x0000;
+	WDTCTL = 0x00;
+}
+
+/*
+ * An application is valid once its reset vector has been written
+ *	- The reset vector is only written after the whole image has passed its CRC check
+ */
+char boot_app_valid( void )
+{
+	if( *(volatile unsigned int *)BOOT_APP_RESET == 0xFFFF ) return( FALSE );
+	return( TRUE );
+}
+
+/*
+ * Check, program and verify one block
+ *	- Erases the segment first unless it is already blank, so a failed block can simply be resent
+ *	- The application reset vector is held back in reset_vector instead of being programmed
+ */
+signed char boot_program( unsigned int address, unsigned char *data, unsigned int bytes, unsigned int crc, unsigned int *reset_vector )
+{
+	unsigned char *flash;
+	unsigned int i;
+
+	if( boot_crc( BOOT_CRC_SEED, data, bytes ) != crc ) return( BOOT_ERROR_CRC );
+
+	if( address + bytes == BOOT_APP_END ){
+		*reset_vector = data[bytes - 2] | ( data[bytes - 1] << 8 );
+		data[bytes - 2] = 0xFF;
+		data[bytes - 1] = 0xFF;
+	}
+
+	flash = (unsigned char *)address;
+	for( i = 0; i < BOOT_SEGMENT_SIZE; i++ ){
+		if( flash[i] != 0xFF ){
+			boot_flash_erase( address );
+			break;
+		}
+	}
+	boot_flash_write( address, data, bytes );
+
+	for( i = 0; i < bytes; i++ ){
+		if( flash[i] != data[i] ) return( BOOT_ERROR_FLASH );
+	}
+	return( BOOT_OK );
+}
+
+/*
+ * Check the whole application region against the host's CRC, then write the held back reset vector
+ */
+signed char boot_finish( unsigned int crc, unsigned int reset_vector )
+{
+	unsigned char vector[2];
+
+	if( reset_vector == 0xFFFF ) return( BOOT_ERROR_INVALID );
+	vector[0] = (unsigned char)reset_vector;
+	vector[1] = (unsigned char)( reset_vector >> 8 );
+	if( boot_crc( boot_crc( BOOT_CRC_SEED, (unsigned char *)BOOT_APP_START, BOOT_APP_RESET - BOOT_APP_START ), vector, 2 ) != crc ) return( BOOT_ERROR_CRC );
+	if( *(volatile unsigned int *)BOOT_APP_RESET != 0xFFFF ) return( BOOT_ERROR_FLASH );
+	boot_flash_write( BOOT_APP_RESET, vector, 2 );
+	if( *(volatile unsigned int *)BOOT_APP_RESET != reset_vector ) return( BOOT_ERROR_FLASH );
+	return( BOOT_OK );
+}
+
+/*
+ * CRC-16 CCITT, continuing from crc
+ */
+unsigned int boot_crc( unsigned int crc, unsigned char *ptr, unsigned int bytes )
+{
+	unsigned char bit;
+
+	while( bytes-- ){
+		crc ^= ((unsigned int)*ptr++ << 8);
+		for( bit = 0; bit < 8; bit++ ){
+			if( crc & 0x8000 ) crc = ( crc << 1 ) ^ 0x1021;
+			else crc = crc << 1;
+		}
+	}
+	return( crc );
+}
+
+/*
+ * Erases one main flash segment
+ *	- Runs from flash, the CPU is held until the erase completes
+ */
+void boot_flash_erase( unsigned int address )
+{
+	FCTL2 = FWKEY | FSSEL_1 | BOOT_FLASH_DIVIDER;	// MCLK / 40
+	FCTL3 = FWKEY;									// Unlock
+	FCTL1 = FWKEY | ERASE;							// Segment erase
+	*(unsigned char *)address = 0;					// Dummy write starts the erase
+	while( FCTL3 & BUSY );
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY | LOCK;
+}
+
+/*
+ * Writes erased flash a word at a time
+ *	- Block write mode needs its code in RAM on this part; word writes from flash program a segment in ~20ms
+ */
+void boot_flash_write( unsigned int address, unsigned char *data, unsigned int bytes )
+{
+	unsigned int *ptr = (unsigned int *)address;
+
+	FCTL2 = FWKEY | FSSEL_1 | BOOT_FLASH_DIVIDER;	// MCLK / 40
+	FCTL3 = FWKEY;									// Unlock
+	FCTL1 = FWKEY | WRT;							// Byte / word write
+	for( ; bytes >= 2; bytes -= 2 ){
+		*ptr++ = data[0] | ( data[1] << 8 );
+		data += 2;
+		while( FCTL3 & BUSY );
+	}
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY | LOCK;
+}
+
+/*
+ * SPI exchange, as usci_exchange()
+ */
+unsigned char boot_spi( unsigned char data )
+{
+	UCB0TXBUF = data;
+	while(( IFG2 & UCB0RXIFG ) == 0x00 );
+	return( UCB0RXBUF );
+}
+
+/*
+ * Reads one MCP2515 register
+ */
+unsigned char boot_mcp_read( unsigned char address )
+{
+	unsigned char data;
+
+	can_select;
+	boot_spi( MCP_READ );
+	boot_spi( address );
+	data = boot_spi( 0x00 );
+	can_deselect;
+	return( data );
+}
+
+/*
+ * Writes one MCP2515 register
+ */
+void boot_mcp_write( unsigned char address, unsigned char data )
+{
+	can_select;
+	boot_spi( MCP_WRITE );
+	boot_spi( address );
+	boot_spi( data );
+	can_deselect;
+}
+
+/*
+ * Changes MCP2515 operating mode and waits for it to take effect
+ */
+void boot_mcp_mode( unsigned char mode )
+{
+	unsigned int i;
+
+	boot_mcp_write( CANCTRL, mode | 0x04 );			// Keep CLKOUT enabled at /1, as the application leaves it
+	for( i = 0; i < BOOT_TX_POLLS; i++ ){
+		if(( boot_mcp_read( CANSTAT ) & 0xE0 ) == mode ) break;
+	}
+}
+
+/*
+ * Sets up the MCP2515 for bootloading
+ *	- Keeps the bitrate the application was using if the MCP2515 still holds it, otherwise 500 kbit
+ *	- Receives DC_CAN_BASE frames only, polled, with rollover into buffer 1
+ */
+void boot_can_init( void )
+{
+	unsigned char cnf1, cnf2, cnf3, i;
+
+	cnf3 = boot_mcp_read( CNF3 );
+	cnf2 = boot_mcp_read( CNF2 );
+	cnf1 = boot_mcp_read( CNF1 );
+	if( cnf2 == 0x00 ){								// Reset value, bit timing never set
+		cnf3 = 0x05;								// 500 kbit, as can_timing()
+		cnf2 = 0xF8;
+		cnf1 = 0x00;
+	}
+
+	can_select;
+	boot_spi( MCP_RESET );
+	can_deselect;
+	boot_mcp_mode( 0x80 );							// Configuration mode
+
+	boot_mcp_write( CNF3, cnf3 );
+	boot_mcp_write( CNF2, cnf2 );
+	boot_mcp_write( CNF1, cnf1 );
+	boot_mcp_write( CANINTE, 0x00 );
+
+	boot_mcp_write( RXM0SIDH, (unsigned char)( RX_MASK_0 >> 3 ));
+	boot_mcp_write( RXM0SIDL, (unsigned char)( RX_MASK_0 << 5 ));
+	boot_mcp_write( RXM1SIDH, (unsigned char)( RX_MASK_0 >> 3 ));
+	boot_mcp_write( RXM1SIDL, (unsigned char)( RX_MASK_0 << 5 ));
+	for( i = RXF0SIDH; i <= RXF5SIDH; i += 4 ){
+		if( i == BFPCTRL ) continue;				// 0x0C - 0x0F are control registers, not a filter
+		boot_mcp_write( i, (unsigned char)( DC_CAN_BASE >> 3 ));
+		boot_mcp_write( i + 1, (unsigned char)( DC_CAN_BASE << 5 ));
+	}
+	boot_mcp_write( RXB0CTRL, 0x04 );				// Roll over into buffer 1 when buffer 0 is full
+
+	boot_mcp_mode( 0x00 );							// Normal mode
+}
+
+/*
+ * Polls for a received frame
+ *	- Returns the frame address with the data bytes in data[0..7], or 0 if nothing was waiting
+ *	- Reading through the READ RX command clears the receive flag
+ */
+unsigned int boot_can_receive( unsigned char *data )
+{
+	unsigned char status, command, sidh, sidl, i;
+
+	can_select;
+	boot_spi( MCP_STATUS );
+	status = boot_spi( 0x00 );
+	can_deselect;
+
+	if( status & 0x01 ) command = MCP_READ_RX;				// RXB0SIDH
+	else if( status & 0x02 ) command = MCP_READ_RX | 0x04;	// RXB1SIDH
+	else return( 0 );
+
+	can_select;
+	boot_spi( command );
+	sidh = boot_spi( 0x00 );
+	sidl = boot_spi( 0x00 );
+	boot_spi( 0x00 );										// EID8
+	boot_spi( 0x00 );										// EID0
+	boot_spi( 0x00 );										// DLC
+	for( i = 0; i < 8; i++ ) data[i] = boot_spi( 0x00 );
+	can_deselect;
+
+	if( sidl & 0x08 ) return( 0 );							// Extended frame, not ours
+	return(( sidh << 3 ) | ( sidl >> 5 ));
+}
+
+/*
+ * Sends a reply frame on DC_BOOT_REPLY
+ *	- Gives up quietly if the transmit buffer stays busy, the host will time out and retry
+ */
+void boot_reply( unsigned char command, signed char result, unsigned int sequence, unsigned int value_a, unsigned int value_b )
+{
+	unsigned int i;
+
+	for( i = 0; i < BOOT_TX_POLLS; i++ ){
+		if(( boot_mcp_read( TXB0CTRL ) & 0x08 ) == 0x00 ) break;
+	}
+	if( i == BOOT_TX_POLLS ) return;
+
+	can_select;
+	boot_spi( MCP_WRITE_TX );								// TXB0SIDH
+	boot_spi( (unsigned char)(( DC_CAN_BASE + DC_BOOT_REPLY ) >> 3 ));
+	boot_spi( (unsigned char)(( DC_CAN_BASE + DC_BOOT_REPLY ) << 5 ));
+	boot_spi( 0x00 );
+	boot_spi( 0x00 );
+	boot_spi( 8 );
+	boot_spi( command );
+	boot_spi( (unsigned char)result );
+	boot_spi( (unsigned char)sequence );
+	boot_spi( (unsigned char)( sequence >> 8 ));
+	boot_spi( (unsigned char)value_a );
+	boot_spi( (unsigned char)( value_a >> 8 ));
+	boot_spi( (unsigned char)value_b );
+	boot_spi( (unsigned char)( value_b >> 8 ));
+	can_deselect;
+
+	can_select;
+	boot_spi( MCP_RTS | 0x01 );
+	can_deselect;
+}
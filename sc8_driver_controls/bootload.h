@@ -0,0 +1,100 @@
+/*
+ * Tritium CAN bootloader header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following bootloader functions:
+ *	- boot_reset
+ *	- boot_request (macro, used by the application)
+ *
+ */
+
+// Public function prototypes
+extern void boot_reset( void );
+
+// Flash layout, must match msp430x247_app.x and msp430x247_boot.x (mspgcc), and lnk_msp430f247.cmd (TI)
+//	0x8000 - 0xF7BF	Application code and constants
+//	0xF7C0 - 0xF7FF	Application interrupt vectors, reached through the bootloader vector stubs
+//	0xF800 - 0xFFBF	Bootloader, never erased or written by itself
+//	0xFFC0 - 0xFFFF	Hardware interrupt vectors, owned by the bootloader
+#define BOOT_APP_START			0x8000
+#define BOOT_APP_END			0xF800			// First address past the application region
+#define BOOT_APP_VECTORS		0xF7C0
+#define BOOT_APP_RESET			0xF7FE			// Application reset vector, erased (0xFFFF) = no valid application
+#define BOOT_VECTORS			32
+#define BOOT_BSL_VECTOR			15				// 0xFFDE, BSL signature word, left erased so the ROM BSL stays enabled
+#define BOOT_RESET_VECTOR		31
+#define BOOT_SEGMENT_SIZE		512				// Main flash segment, bytes
+#define BOOT_STACK_TOP			0x2100			// End of RAM
+
+// Section placement for bootloader code and its vector table
+// The bootloader must not call anything outside these sections, the application region is erased under it
+// With mspgcc, bootload.c is left out of the application and linked on its own by msp430x247_boot.x, see makefile.targets
+#define BOOT_CODE				__attribute__ ((section (".bootloader")))
+#define BOOT_VECTOR_TABLE		__attribute__ ((section (".bootvectors")))
+
+// Bootload request handoff
+// Written to the bottom of RAM by the application just before a watchdog reset, and checked by the bootloader
+// before the C startup code of either gets a chance to overwrite it
+// Reserved: RAM starts at BOOT_HANDOFF_ADDR + 4 in msp430x247_app.x, msp430x247_boot.x and lnk_msp430f247.cmd, so no
+// variable that happens to hold the key can send a watchdog reset into the bootloader
+#define BOOT_HANDOFF_ADDR		0x1100
+#define BOOT_HANDOFF_KEY		0xB007
+#define BOOT_HANDOFF			(*(volatile unsigned int *)BOOT_HANDOFF_ADDR)
+#define BOOT_HANDOFF_CHECK		(*(volatile unsigned int *)(BOOT_HANDOFF_ADDR + 2))
+#define boot_request()			do{ BOOT_HANDOFF = BOOT_HANDOFF_KEY; BOOT_HANDOFF_CHECK = ~BOOT_HANDOFF_KEY; WDTCTL = 0x00; }while(0)
+
+// Flash timing generator: MCLK / 40 = 400 kHz, must be within 257 - 476 kHz
+#define BOOT_FLASH_DIVIDER		(40 - 1)
+
+// Timeouts, in Timer A overflows (SMCLK / 8, 32.8ms)
+#define BOOT_TIMEOUT			150				// Return to a valid application after 5s without a host
+#define BOOT_TX_POLLS			2000			// MCP2515 transmit buffer busy polls before giving up on a reply
+
+// CAN protocol
+//	Commands on DC_CAN_BASE + DC_BOOTLOAD, byte 0 = command
+//		The application's "BOOTLOAD" frame is also accepted, and answered like PING
+//		The application only acts on "BOOTLOAD" when stopped in neutral or off, otherwise it answers PING with BOOT_ERROR_BUSY
+//		BLOCK:	bytes 2-3 = address (segment aligned), bytes 4-5 = length (even, 2 - 512), bytes 6-7 = CRC-16 of the data
+//		DONE:	bytes 4-5 = CRC-16 over the whole application region as it should now read
+//	Block data on DC_CAN_BASE + DC_BOOT_DATA
+//		byte 0 = frame sequence within the block, bytes 1-7 = data
+//	Replies on DC_CAN_BASE + DC_BOOT_REPLY
+//		byte 0 = command (or BOOT_REPLY_ACK), byte 1 = result, bytes 2-3 = next expected data sequence
+//		PING replies also carry bytes 4-5 = BOOT_APP_START, bytes 6-7 = BOOT_APP_END
+//	The host may have BOOT_WINDOW data frames outstanding; the bootloader acknowledges every BOOT_WINDOW frames,
+//	and sends one negative acknowledgement with the expected sequence if a frame is missed
+#define BOOT_CMD_PING			0x01			// Announce / check presence, sent unsolicited on entry
+#define BOOT_CMD_ERASE			0x02			// Erase the whole application region
+#define BOOT_CMD_BLOCK			0x03			// Start a block, replied to once all its data is programmed and verified
+#define BOOT_CMD_DONE			0x04			// Check the whole image and mark the application valid
+#define BOOT_CMD_RUN			0x05			// Leave the bootloader and start the application
+#define BOOT_REPLY_ACK			0x10			// Data window acknowledgement
+
+#define BOOT_OK					0
+#define BOOT_ERROR_COMMAND		-1				// Unknown command, or data without a block
+#define BOOT_ERROR_ADDRESS		-2				// Block outside the application region, or bad length
+#define BOOT_ERROR_CRC			-3				// Block or image CRC mismatch
+#define BOOT_ERROR_FLASH		-4				// Flash did not verify after programming
+#define BOOT_ERROR_SEQUENCE		-5				// Data frame missed, resend from the sequence given
+#define BOOT_ERROR_INVALID		-6				// RUN refused, no valid application
+#define BOOT_ERROR_BUSY			-7				// Sent by the application: bootload refused, not stopped in neutral or off
+
+#define BOOT_DATA_BYTES			7				// Block data bytes per frame
+#define BOOT_WINDOW				16				// Data frames per acknowledgement
+#define BOOT_CRC_SEED			0xFFFF			// CRC-16 CCITT
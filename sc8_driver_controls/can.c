@@ -25,15 +25,21 @@
 #include "tri86.h"
 #include "can.h"
 #include "usci.h"
+#include "clock.h"
+#include "trace.h"
 
 // Public variables
 can_variables can;
 can_variables canq[CAN_BUF_LEN];
 can_variables *can_push_ptr;
+unsigned char can_state = CAN_STATE_ACTIVE;
 
 // Private variables
 unsigned char buffer[16];
 can_variables *can_pop_ptr;
+unsigned int can_bitrate = CAN_BITRATE_500;
+unsigned char can_backoff_count = 0;
+unsigned char can_recovery_count = 0;
 
 /**************************************************************************************************
  * PUBLIC FUNCTIONS
@@ -42,59 +48,32 @@ can_variables *can_pop_ptr;
 /*
  * Initialises MCP2515 CAN controller
  *	- Resets MCP2515 via SPI port (switches to config mode, clears errors)
- *	- Changes CLKOUT to /1 rate (16 MHz)
- *	- Sets up bit timing for 500 kbit operation
+ *	- Changes CLKOUT to the CLOCK_CLKPRE rate (16 MHz, or 2 MHz for DCO trimming)
+ *	- Sets up bit timing for the selected bitrate
  *	- Sets up receive filters and masks
  *	- Enables various interrupts on IRQ pin
  *	- Switches to normal (operating) mode
  */
 void can_init( unsigned int bitrate_index )
 {
-	unsigned int i;
+	// Remember bitrate for bus-off recovery re-init
+	can_bitrate = bitrate_index;
 
 	// Set up buffering
 	can_push_ptr = canq;
 	can_pop_ptr = can_push_ptr;
 
-	// Set up reset and clocking
+	// Start error active
+	can_state = CAN_STATE_ACTIVE;
+	can_backoff_count = 0;
+	can_recovery_count = 0;
+
+	// Reset, back in config mode with CLKOUT at the CLOCK_CLKPRE rate
 	can_reset();
-	for(i = 0; i < 1000; i++);
-	can_mod( CANCTRL, 0x03, 0x00 );			// CANCTRL register, modify lower 2 bits, CLK = /1 = 16 MHz
 	
 	// Set up bit timing
-	switch(bitrate_index){
-		case CAN_BITRATE_50:
-			buffer[0] = 0x05;
-			buffer[1] = 0xF8;
-			buffer[2] = 0x09;						
-			break;
-		case CAN_BITRATE_100:
-			buffer[0] = 0x05;
-			buffer[1] = 0xF8;
-			buffer[2] = 0x04;						
-			break;
-		case CAN_BITRATE_125:
-			buffer[0] = 0x05;
-			buffer[1] = 0xF8;
-			buffer[2] = 0x03;
-			break;
-		case CAN_BITRATE_250:
-			buffer[0] = 0x05;
-			buffer[1] = 0xF8;
-			buffer[2] = 0x01;						
-			break;
-		case CAN_BITRATE_1000:
-			buffer[0] = 0x02;
-			buffer[1] = 0xD0;
-			buffer[2] = 0x00;						
-			break;
-		case CAN_BITRATE_500:
-		default:
-			buffer[0] = 0x05;
-			buffer[1] = 0xF8;
-			buffer[2] = 0x00;						
-			break;
-	}	
+	can_timing( bitrate_index );
+
 	// Set up interrupts
 	buffer[3] = 0x63;						// CANINTE register: enable WAKE, ERROR, RX0 & RX1 interrupts on IRQ pin
 	buffer[4] = 0x00;						// CANINTF register: clear all IRQ flags
@@ -102,54 +81,71 @@ void can_init( unsigned int bitrate_index )
 	can_write( CNF3, &buffer[0], 6);		// Write to registers
 	
 	// Set up receive filtering & masks
-	// RXF0 - Buffer 0
-	buffer[ 0] = (unsigned char)(RX_ID_0A >> 3);
-	buffer[ 1] = (unsigned char)(RX_ID_0A << 5);
-	buffer[ 2] = 0x00;
-	buffer[ 3] = 0x00;
-	// RXF1 - Buffer 0
-	buffer[ 4] = (unsigned char)(RX_ID_0B >> 3);
-	buffer[ 5] = (unsigned char)(RX_ID_0B >> 3);
-	buffer[ 6] = 0x00;
-	buffer[ 7] = 0x00;
-	// RXF2 - Buffer 1
-	buffer[ 8] = (unsigned char)(RX_ID_1A >> 3);
-	buffer[ 9] = (unsigned char)(RX_ID_1A << 5);
-	buffer[10] = 0x00;
-	buffer[11] = 0x00;
+	// RXF0 & RXF1 - Buffer 0, RXF2 - Buffer 1
+	can_id_pack( RX_ID_0A, &buffer[0] );
+	can_id_pack( RX_ID_0B, &buffer[4] );
+	can_id_pack( RX_ID_1A, &buffer[8] );
 	can_write( RXF0SIDH, &buffer[0], 12 );
 	
-	// RXF3 - Buffer 1
-	buffer[ 0] = (unsigned char)(RX_ID_1B >> 3);
-	buffer[ 1] = (unsigned char)(RX_ID_1B << 5);
-	buffer[ 2] = 0x00;
-	buffer[ 3] = 0x00;
-	// RXF4 - Buffer 1
-	buffer[ 4] = (unsigned char)(RX_ID_1C >> 3);
-	buffer[ 5] = (unsigned char)(RX_ID_1C << 5);
-	buffer[ 6] = 0x00;
-	buffer[ 7] = 0x00;
-	// RXF5 - Buffer 1
-	buffer[ 8] = (unsigned char)(RX_ID_1D >> 3);
-	buffer[ 9] = (unsigned char)(RX_ID_1D << 5);
-	buffer[10] = 0x00;
-	buffer[11] = 0x00;
+	// RXF3, RXF4 & RXF5 - Buffer 1
+	can_id_pack( RX_ID_1B, &buffer[0] );
+	can_id_pack( RX_ID_1C, &buffer[4] );
+	can_id_pack( RX_ID_1D, &buffer[8] );
 	can_write( RXF3SIDH, &buffer[0], 12 );
 
-	// RXM0 - Buffer 0
-	buffer[ 0] = (unsigned char)(RX_MASK_0 >> 3);
-	buffer[ 1] = (unsigned char)(RX_MASK_0 << 5);
-	buffer[ 2] = 0x00;
-	buffer[ 3] = 0x00;
-	// RXM1 - Buffer 1
-	buffer[ 4] = (unsigned char)(RX_MASK_1 >> 3);
-	buffer[ 5] = (unsigned char)(RX_MASK_1 << 5);
-	buffer[ 6] = 0x00;
-	buffer[ 7] = 0x00;
+	// RXM0 - Buffer 0, RXM1 - Buffer 1
+	// The mask registers have no EXIDE bit, clear it
+	can_id_pack( RX_MASK_0, &buffer[0] );
+	can_id_pack( RX_MASK_1, &buffer[4] );
+	buffer[1] &= ~MCP_SIDL_EXIDE;
+	buffer[5] &= ~MCP_SIDL_EXIDE;
 	can_write( RXM0SIDH, &buffer[0], 8 );
 	
 	// Switch out of config mode into normal operating mode
-	can_mod( CANCTRL, 0xE0, 0x00 );			// CANCTRL register, modify upper 3 bits, mode = Normal
+	can_mod( CANCTRL, MCP_MODE_MASK, MCP_MODE_NORMAL );
+	can_wait_mode( MCP_MODE_NORMAL );
+}
+
+/*
+ * Detects the bus bitrate by listening to existing traffic
+ *	- Tries each bitrate preset in listen-only mode, so we never disturb the bus with error frames
+ *	- A preset is accepted once CAN_AUTOBAUD_FRAMES frames are received without a message error
+ *	- A message error rejects the preset straight away, otherwise it times out after CAN_AUTOBAUD_POLLS
+ *	- Returns the detected bitrate index, or default_index if the bus is silent
+ *	- Leaves the MCP2515 in listen-only mode, follow up with can_init() to go on the bus
+ */
+unsigned int can_autobaud( unsigned int default_index )
+{
+	static const unsigned char order[CAN_AUTOBAUD_RATES] = {
+		CAN_BITRATE_500, CAN_BITRATE_1000, CAN_BITRATE_250, CAN_BITRATE_125, CAN_BITRATE_100, CAN_BITRATE_50
+	};
+	unsigned char rate, frames, flags;
+	unsigned int i;
+
+	for( rate = 0; rate < CAN_AUTOBAUD_RATES; rate++ ){
+		// Reset to config mode, masks and filters default to zero = accept everything
+		can_reset();
+		can_timing( order[rate] );
+		buffer[3] = 0x00;					// CANINTE register: no interrupts on IRQ pin, we poll CANINTF
+		buffer[4] = 0x00;					// CANINTF register: clear all IRQ flags
+		buffer[5] = 0x00;					// EFLG register: clear all user-changable error flags
+		can_write( CNF3, &buffer[0], 6);
+		can_mod( CANCTRL, MCP_MODE_MASK, MCP_MODE_LISTEN );
+		can_wait_mode( MCP_MODE_LISTEN );
+
+		// Watch the bus
+		frames = 0;
+		for( i = 0; i < CAN_AUTOBAUD_POLLS; i++ ){
+			can_read( CANINTF, &flags, 1 );
+			if( flags & MCP_IRQ_MERR ) break;
+			if( flags & ( MCP_IRQ_RXB0 | MCP_IRQ_RXB1 )){
+				can_mod( CANINTF, flags & ( MCP_IRQ_RXB0 | MCP_IRQ_RXB1 ), 0x00 );
+				frames++;
+				if( frames == CAN_AUTOBAUD_FRAMES ) return( order[rate] );
+			}
+		}
+	}
+	return( default_index );
 }
 
 /*
@@ -174,6 +170,8 @@ void can_receive( void )
 		can_read( TEC, &buffer[1], 2 );
 		// Clear error flags
 		can_mod( EFLAG, buffer[0], 0x00 );	// Modify (to '0') all bits that were set
+		// Track error active / passive / bus-off state
+		can_update_state( buffer[0], buffer[1], buffer[2] );
 		// Return error code, a blank address field, and error registers in data field
 		can.status = CAN_ERROR;
 		can.address = 0x0000;
@@ -186,67 +184,17 @@ void can_receive( void )
 	}	
 	// No error, check for received messages, buffer 0
 	else if(( flags & MCP_IRQ_RXB0 ) != 0x00 ){
-		// Read in the info, address & message data
-		can_read( RXB0CTRL, &buffer[0], 14 );
+		// Read in the address & message data, the MCP2515 clears the IRQ flag when the read completes
+		can_read_rx( 0, &buffer[0] );
 		// Fill out return structure
-		// check for Remote Frame requests and indicate the status correctly
-		if(( buffer[0] & MCP_RXB0_RTR ) == 0x00 ){
-			// We've received a standard data packet
-			can.status = CAN_OK;
-			// Fill in the data
-			can.data.data_u8[0] = buffer[ 6];
-			can.data.data_u8[1] = buffer[ 7];
-			can.data.data_u8[2] = buffer[ 8];
-			can.data.data_u8[3] = buffer[ 9];
-			can.data.data_u8[4] = buffer[10];
-			can.data.data_u8[5] = buffer[11];
-			can.data.data_u8[6] = buffer[12];
-			can.data.data_u8[7] = buffer[13];
-		}
-		else{
-			// We've received a remote frame request
-			// Data is irrelevant with an RTR
-			can.status = CAN_RTR;
-		}
-		// Fill in the address
-		can.address = buffer[1];
-		can.address = can.address << 3;
-		buffer[2] = buffer[2] >> 5;
-		can.address = can.address | buffer[2];
-		// Clear the IRQ flag
-		can_mod( CANINTF, MCP_IRQ_RXB0, 0x00 );
+		can_unpack();
 	}
 	// No error, check for received messages, buffer 1
 	else if(( flags & MCP_IRQ_RXB1 ) != 0x00 ){
-		// Read in the info, address & message data
-		can_read( RXB1CTRL, &buffer[0], 14 );
+		// Read in the address & message data, the MCP2515 clears the IRQ flag when the read completes
+		can_read_rx( 2, &buffer[0] );
 		// Fill out return structure
-		// check for Remote Frame requests and indicate the status correctly
-		if(( buffer[0] & MCP_RXB1_RTR ) == 0x00 ){
-			// We've received a standard data packet
-			can.status = CAN_OK;
-			// Fill in the data
-			can.data.data_u8[0] = buffer[ 6];
-			can.data.data_u8[1] = buffer[ 7];
-			can.data.data_u8[2] = buffer[ 8];
-			can.data.data_u8[3] = buffer[ 9];
-			can.data.data_u8[4] = buffer[10];
-			can.data.data_u8[5] = buffer[11];
-			can.data.data_u8[6] = buffer[12];
-			can.data.data_u8[7] = buffer[13];
-		}
-		else{
-			// We've received a remote frame request
-			// Data is irrelevant with an RTR
-			can.status = CAN_RTR;
-		}
-		// Fill in the address
-		can.address = buffer[1];
-		can.address = can.address << 3;
-		buffer[2] = buffer[2] >> 5;
-		can.address = can.address | buffer[2];
-		// Clear the IRQ flag
-		can_mod( CANINTF, MCP_IRQ_RXB1, 0x00 );
+		can_unpack();
 	}
 	// Check for wakeup events
 	else if(( flags & MCP_IRQ_WAKE ) != 0x00 ){
@@ -267,7 +215,7 @@ void can_receive( void )
 /*
  * Transmits a CAN message to the bus
  *	- If there are packets in the Queue, pick out the next one and send it
- *	- Accepts address and data payload via can_interface structure
+ *	- Accepts address and data payload via can_interface structure, address | CAN_EXTENDED for a 29-bit ID
  *	- Uses status field to pass in DLC (length) code
  *	- Checks mailbox 1 is free, if not, returns -1 without transmitting packet
  *	- Busy waits while message is sent to CAN controller on SPI port
@@ -277,9 +225,14 @@ void can_receive( void )
  *		-1 = All mailboxes busy
  *		-2 = Dropped through all mailbox choices without transmitting (shouldn't happen)
  *		-3 = No packets to transmit in the queue
+ *		-4 = Transmission backed off due to error passive or bus-off state
  */
 char can_transmit( void )
 {
+	// Hold off while off the bus, or between transmissions while error passive
+	if(( can_state == CAN_STATE_BUSOFF ) || ( can_backoff_count != 0 )){
+		return(-4);
+	}
 	// Check Queue
 	if( can_push_ptr != can_pop_ptr ){
 		// Check for mailbox 1 busy
@@ -288,10 +241,7 @@ char can_transmit( void )
 		}
 		else{
 			// Format the data for the CAN controller
-			buffer[ 0] = (unsigned char)(can_pop_ptr->address >> 3);
-			buffer[ 1] = (unsigned char)(can_pop_ptr->address << 5);
-			buffer[ 2] = 0x00;											// EID8
-			buffer[ 3] = 0x00;											// EID0
+			can_id_pack( can_pop_ptr->address, &buffer[0] );			// SIDH, SIDL, EID8, EID0
 			buffer[ 4] = can_pop_ptr->status;							// DLC
 			buffer[ 5] = can_pop_ptr->data.data_u8[0];
 			buffer[ 6] = can_pop_ptr->data.data_u8[1];
@@ -303,7 +253,10 @@ char can_transmit( void )
 			buffer[12] = can_pop_ptr->data.data_u8[7];
 			// Setup mailbox 0 and send the message
 			can_write_tx( 0x00, &buffer[0] );
+			TRACE_TRANSMIT( can_pop_ptr );
 			can_rts( 0 );
+			// Space out transmissions while error passive
+			if( can_state == CAN_STATE_PASSIVE ) can_backoff_count = CAN_PASSIVE_BACKOFF;
 			// Deal with queue
 			can_pop_ptr++;
 			if(can_pop_ptr == ( canq + CAN_BUF_LEN )) can_pop_ptr = canq;
@@ -326,6 +279,48 @@ void can_push( void )
 }
 
 
+/*
+ * Discards all queued messages that have not yet been sent
+ */
+void can_flush( void )
+{
+	can_pop_ptr = can_push_ptr;
+}
+
+/*
+ * Returns the number of messages that can be pushed before the queue is full
+ */
+unsigned char can_queue_free( void )
+{
+	int used;
+	
+	used = can_push_ptr - can_pop_ptr;
+	if( used < 0 ) used += CAN_BUF_LEN;
+	return( CAN_BUF_LEN - 1 - used );
+}
+
+/*
+ * Services the bus error state machine
+ *	- Call once per Timer A tick (10ms)
+ *	- Counts down the transmit back-off while error passive
+ *	- Polls EFLG and TEC/REC while not error active, as the error IRQ only reports new errors
+ *	- Re-initialises the controller once bus-off recovery time has elapsed
+ */
+void can_tick( void )
+{
+	if( can_backoff_count != 0 ) can_backoff_count--;
+
+	if( can_state == CAN_STATE_BUSOFF ){
+		if( can_recovery_count != 0 ) can_recovery_count--;
+		if( can_recovery_count == 0 ) can_init( can_bitrate );
+	}
+	else if( can_state != CAN_STATE_ACTIVE ){
+		can_read( EFLAG, &buffer[0], 1 );
+		can_read( TEC, &buffer[1], 2 );
+		can_update_state( buffer[0], buffer[1], buffer[2] );
+	}
+}
+
 /*
  * Abort all pending transmissions
  */
@@ -371,15 +366,63 @@ void can_wake( void )
  * PRIVATE FUNCTIONS
  *************************************************************************************************/
 
+/*
+ * Fills CNF3, CNF2, CNF1 bit timing values for the selected bitrate into buffer[0..2]
+ *	- All presets assume the 16 MHz MCP2515 oscillator
+ */
+void can_timing( unsigned int bitrate_index )
+{
+	switch(bitrate_index){
+		case CAN_BITRATE_50:
+			buffer[0] = 0x05;
+			buffer[1] = 0xF8;
+			buffer[2] = 0x09;						
+			break;
+		case CAN_BITRATE_100:
+			buffer[0] = 0x05;
+			buffer[1] = 0xF8;
+			buffer[2] = 0x04;						
+			break;
+		case CAN_BITRATE_125:
+			buffer[0] = 0x05;
+			buffer[1] = 0xF8;
+			buffer[2] = 0x03;
+			break;
+		case CAN_BITRATE_250:
+			buffer[0] = 0x05;
+			buffer[1] = 0xF8;
+			buffer[2] = 0x01;						
+			break;
+		case CAN_BITRATE_1000:
+			// 8 TQ bit: single sample point at 75%, no room for triple sampling at BRP = 0
+			buffer[0] = 0x01;
+			buffer[1] = 0x91;
+			buffer[2] = 0x00;						
+			break;
+		case CAN_BITRATE_500:
+		default:
+			buffer[0] = 0x05;
+			buffer[1] = 0xF8;
+			buffer[2] = 0x00;						
+			break;
+	}
+}
+
 /*
  * Resets MCP2515 CAN controller via SPI port
  *	- SPI port must be already initialised
+ *	- The MCP2515 reports config mode once its oscillator is running again
+ *	- CLKOUT stops during the reset, clock_can_stop() moves the MSP430 off it first
+ *	- The reset puts CLKOUT back to /8, clock_can_reset() restores our rate and the MSP430 clock
  */
 void can_reset( void )
 {
+	clock_can_stop();
 	can_select;
 	usci_transmit( MCP_RESET );
 	can_deselect;
+	can_wait_mode( MCP_MODE_CONFIG );
+	clock_can_reset();
 }
  
 /*
@@ -427,6 +470,69 @@ void can_read_rx( unsigned char address, unsigned char *ptr )
 	can_deselect;
 }
 
+/*
+ * Packs an identifier into MCP2515 SIDH, SIDL, EID8 & EID0 register layout
+ *	- Used for transmit buffers, filters and masks
+ *	- Sets EXIDE for extended identifiers (address | CAN_EXTENDED)
+ */
+void can_id_pack( unsigned long id, unsigned char *ptr )
+{
+	if( id & CAN_EXTENDED ){
+		ptr[0] = (unsigned char)(id >> 21);
+		ptr[1] = ((unsigned char)(id >> 13) & 0xE0) | MCP_SIDL_EXIDE | ((unsigned char)(id >> 16) & 0x03);
+		ptr[2] = (unsigned char)(id >> 8);
+		ptr[3] = (unsigned char)id;
+	}
+	else{
+		ptr[0] = (unsigned char)(id >> 3);
+		ptr[1] = (unsigned char)(id << 5);
+		ptr[2] = 0x00;
+		ptr[3] = 0x00;
+	}
+}
+
+/*
+ * Fills in the can structure from a receive buffer read into buffer[]
+ *	- Decodes 11-bit or 29-bit (EXIDE) identifiers, and remote requests for either
+ */
+void can_unpack( void )
+{
+	unsigned char rtr;
+
+	if( buffer[1] & MCP_SIDL_EXIDE ){
+		can.address = CAN_EXTENDED
+					| ((unsigned long)buffer[0] << 21)
+					| ((unsigned long)(buffer[1] & 0xE0) << 13)
+					| ((unsigned long)(buffer[1] & 0x03) << 16)
+					| ((unsigned int)buffer[2] << 8)
+					| buffer[3];
+		rtr = buffer[4] & MCP_DLC_RTR;
+	}
+	else{
+		can.address = ((unsigned int)buffer[0] << 3) | (buffer[1] >> 5);
+		rtr = buffer[1] & MCP_SIDL_SRR;
+	}
+
+	// Check for Remote Frame requests and indicate the status correctly
+	if( rtr == 0x00 ){
+		// We've received a data packet
+		can.status = CAN_OK;
+		can.data.data_u8[0] = buffer[ 5];
+		can.data.data_u8[1] = buffer[ 6];
+		can.data.data_u8[2] = buffer[ 7];
+		can.data.data_u8[3] = buffer[ 8];
+		can.data.data_u8[4] = buffer[ 9];
+		can.data.data_u8[5] = buffer[10];
+		can.data.data_u8[6] = buffer[11];
+		can.data.data_u8[7] = buffer[12];
+	}
+	else{
+		// We've received a remote frame request
+		// Data is irrelevant with an RTR
+		can.status = CAN_RTR;
+	}
+}
+
 /*
  * Writes data bytes to the MCP2515
  *	- Pass in starting address, pointer to array of bytes, and number of bytes to write
@@ -522,6 +628,49 @@ unsigned char can_read_filter( void )
 	return status;
 }
  
+/*
+ * Waits for the MCP2515 to report an operating mode in CANSTAT
+ *	- Returns TRUE once it does, FALSE after CAN_MODE_POLLS reads
+ */
+char can_wait_mode( unsigned char mode )
+{
+	unsigned char status;
+	unsigned int i;
+
+	for( i = 0; i < CAN_MODE_POLLS; i++ ){
+		can_read( CANSTAT, &status, 1 );
+		if(( status & MCP_MODE_MASK ) == mode ) return( TRUE );
+	}
+	return( FALSE );
+}
+
+/*
+ * Updates bus error state from the MCP2515 error flags and counters
+ *	- On entering error passive, drop queued messages as they are now stale
+ *	- On entering bus-off, abort pending transmissions, drop the queue and start the recovery timer
+ */
+void can_update_state( unsigned char eflg, unsigned char tec, unsigned char rec )
+{
+	unsigned char new_state;
+	
+	if( eflg & MCP_EFLG_TXBO ) new_state = CAN_STATE_BUSOFF;
+	else if(( eflg & ( MCP_EFLG_TXEP | MCP_EFLG_RXEP )) || ( tec >= 128 ) || ( rec >= 128 )) new_state = CAN_STATE_PASSIVE;
+	else if(( eflg & MCP_EFLG_EWARN ) || ( tec >= 96 ) || ( rec >= 96 )) new_state = CAN_STATE_WARNING;
+	else new_state = CAN_STATE_ACTIVE;
+	
+	if( new_state == can_state ) return;
+	
+	if( new_state == CAN_STATE_BUSOFF ){
+		can_abort_transmit();
+		can_flush();
+		can_recovery_count = CAN_BUSOFF_RECOVERY;
+	}
+	else if(( new_state == CAN_STATE_PASSIVE ) && ( can_state < CAN_STATE_PASSIVE )){
+		can_flush();
+	}
+	can_state = new_state;
+}
+
 /*
  * Modifies selected register in MCP2515
  *	- Pass in register to be modified, bit mask, and bit data
@@ -22,26 +22,49 @@
 
 // Public function prototypes
 extern void	can_init( unsigned int bitrate_index );
+extern unsigned int can_autobaud( unsigned int default_index );
 extern char	can_transmit( void );
 extern void	can_receive( void );
 extern void can_push( void );
 extern void can_abort_transmit( void );
 extern void can_sleep( void );
 extern void can_wake( void );
+extern void can_tick( void );
+extern void can_flush( void );
+extern unsigned char can_queue_free( void );
 
 // Public variables
 typedef struct _can_variables {
 	unsigned int		status;
-	unsigned int 		address;
+	unsigned long 		address;			// 11-bit ID, or 29-bit ID | CAN_EXTENDED
 	group_64			data;
 } can_variables;
 
+// Extended (29-bit) identifiers carry this flag in the address field, so they never match an 11-bit ID
+#define CAN_EXTENDED	0x80000000UL
+#define CAN_EXT(id)		((unsigned long)(id) | CAN_EXTENDED)
+
 #define CAN_BUF_LEN		32
 extern can_variables	can;
 extern can_variables	canq[CAN_BUF_LEN];
 extern can_variables	*can_push_ptr;
+extern unsigned char	can_state;
+
+// Bus error states, tracked from EFLG and TEC/REC
+#define CAN_STATE_ACTIVE		0			// Normal operation
+#define CAN_STATE_WARNING		1			// TEC or REC >= 96, still error active
+#define CAN_STATE_PASSIVE		2			// TEC or REC >= 128, transmissions backed off
+#define CAN_STATE_BUSOFF		3			// TEC > 255, off the bus until recovery re-init
+
+// Error recovery timing, in Timer A ticks (10ms)
+#define CAN_PASSIVE_BACKOFF		1			// Minimum ticks between transmissions while error passive
+#define CAN_BUSOFF_RECOVERY		3			// Wait for 128 x 11 recessive bits (28ms at 50 kbit) before re-init
 
 // Receive filters and masks
+// Filters are 11-bit IDs, or CAN_EXT(29-bit ID) to match extended frames only
+// Masks are 11-bit, or CAN_EXT(29-bit mask) to compare extended ID bits as well
+// An extended mask also makes the buffer's 11-bit filters compare data bytes 0 & 1 against their (zero)
+// extended bits, so keep 11-bit and extended subscriptions on different buffers
 // Receive buffer 0, can choose two different receive blocks, with a single mask
 #define RX_MASK_0		0x07E0			// Only care about upper 6 bits of 11-bit address
 #define RX_ID_0A		DC_CAN_BASE		// Receive driver controls (ourself) packets, for RTR and bootloader trigger
@@ -50,11 +73,16 @@ extern can_variables	*can_push_ptr;
 #define RX_MASK_1		0x07E0			// Only care about upper 6 bits of 11-bit address
 #define RX_ID_1A		MC_CAN_BASE		// Receive packets from motor controller
 #define RX_ID_1B		EG_CAN_BASE		// Receive packets from eGear (series/parallel switch) controller
+#if MC_COUNT > 1
+#define RX_ID_1C		MC_CAN_BASE_1	// Receive packets from second motor controller
+#else
 #define RX_ID_1C		0x0000			// Unused
+#endif
 #define RX_ID_1D		0x0000			// Unused
 
 // Private function prototypes
 void 					can_reset( void );
+void					can_timing( unsigned int bitrate_index );
 void 					can_read( unsigned char address, unsigned char *ptr, unsigned char bytes );
 void 					can_read_rx( unsigned char address, unsigned char *ptr );
 void 					can_write( unsigned char address, unsigned char *ptr, unsigned char bytes );
@@ -63,6 +91,10 @@ void 					can_rts( unsigned char address );
 unsigned char 			can_read_status( void );
 unsigned char 			can_read_filter( void );
 void 					can_mod( unsigned char address, unsigned char mask, unsigned char data );
+void					can_update_state( unsigned char eflg, unsigned char tec, unsigned char rec );
+char					can_wait_mode( unsigned char mode );
+void					can_id_pack( unsigned long id, unsigned char *ptr );
+void					can_unpack( void );
 
 // SPI port interface macros
 #define can_select		P3OUT &= ~CAN_CSn
@@ -76,6 +108,19 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 #define CAN_BITRATE_500			4
 #define CAN_BITRATE_1000		5
 
+// Bitrate auto-detection
+#define CAN_AUTOBAUD_RATES		6			// Number of bitrate presets to try
+#define CAN_AUTOBAUD_FRAMES		2			// Error-free frames needed to accept a preset
+#define CAN_AUTOBAUD_POLLS		40000		// CANINTF polls per preset, approx 250ms with 8 MHz SPI
+
+// MCP2515 operating modes, CANCTRL REQOP and CANSTAT OPMOD
+#define MCP_MODE_MASK			0xE0
+#define MCP_MODE_NORMAL			0x00
+#define MCP_MODE_SLEEP			0x20
+#define MCP_MODE_LISTEN			0x60
+#define MCP_MODE_CONFIG			0x80
+#define CAN_MODE_POLLS			1000		// CANSTAT polls before giving up on a mode change, approx 6ms
+
 // Motor controller CAN base address and packet offsets
 #define	MC_CAN_BASE		0x400		// High = Serial Number             Low = "TRIa" string
 #define MC_LIMITS		0x01		// High = Active Motor/CAN counts   Low = Error & Limit flags
@@ -93,13 +138,42 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 #define MC_TEMP3		0x0D		// High = Heatsink Phase A Temp     Low = Unused
 #define MC_CUMULATIVE	0x0E		// High = DC Bus AmpHours           Low = Odometer
 
+// Motor controllers, MC_COUNT in tri86.h says how many are fitted
+// Each broadcasts from its own base, and takes DC_DRIVE and DC_POWER at its own driver controls base
+// The receive filters have room for MC_MAX, add to both lists and RX_ID_1D for a third
+#define MC_CAN_BASE_1	0x420
+#define MC_DRIVE_BASE_1	0x520
+#define MC_CAN_BASES	{ MC_CAN_BASE, MC_CAN_BASE_1 }
+#define MC_DRIVE_BASES	{ DC_CAN_BASE, MC_DRIVE_BASE_1 }
+#define MC_MAX			2
+#if MC_COUNT > MC_MAX
+#error "MC_COUNT is more than the CAN bases listed in can.h"
+#endif
+
 // Driver controls CAN base address and packet offsets
 #define DC_CAN_BASE		0x500
 #define DC_DRIVE		1
 #define DC_POWER		2
 #define DC_RESET		3
 #define DC_SWITCH		5
-#define DC_BOOTLOAD		22
+#define DC_LOG			18			// Telemetry logger request, see logger.h
+#define DC_LOG_DATA		19
+#define DC_PARAM		20			// Parameter read/write request, see param.h
+#define DC_PARAM_REPLY	21
+#define DC_BOOTLOAD		22			// Bootloader entry and commands, see bootload.h
+#define DC_BOOT_DATA	23
+#define DC_BOOT_REPLY	24
+#define DC_STARTUP		25			// Startup timing: bytes 0-1 = ms to first live DC_DRIVE, bytes 2-3 = ms to pedal supply in range,
+									// byte 4 = reset cause, byte 5 = previous run's late stage (0xFF none), byte 6 = its age in ticks,
+									// byte 7 = previous run's SPI timeouts
+#define DC_PROFILE		26			// Hot path profiler request and replies, see profile.h
+#define DC_EGEAR		27			// eGear changeover report, see egear.h
+#define DC_STACK		28			// RAM budget, send a remote request for it, see stack.h
+#define DC_STACK_ISR	29
+#define DC_STATUS		30			// Compact telemetry (USE_COMPACT_TELEMETRY): bytes 0-1 = switches, byte 2 = state, byte 3 = pedal flags,
+									// bytes 4-6 = pedal A and regen slider C raw ADC, 12 bits each, A in the low 12 bits,
+									// byte 7 = main loop passes in the busiest tick since the last DC_STATUS (255 = 255 or more)
+#define DC_TRACE		31			// Pedal to bus latency trace request and replies, see trace.h
 
 // Driver controls switch position packet bitfield positions (lower 16 bits)
 #define SW_MODE_R		0x0001
@@ -111,7 +185,7 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 #define SW_IGN_START	0x0040
 #define SW_BRAKE		0x0080
 #define SW_FUEL			0x0100
-#define SW_SPARE1		0x0200
+#define SW_MC_LOST		0x0200		// No velocity from the motor controller within VEHICLE_VELOCITY_TIMEOUT
 #define SW_SPARE2		0x0400
 #define SW_SPARE3		0x0800
 #define SW_ACCEL_FAULT	0x1000
@@ -277,6 +351,9 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 // MCP2515 RX ctrl bit definitions
 #define MCP_RXB0_RTR	0x08
 #define MCP_RXB1_RTR	0x08
+#define MCP_SIDL_SRR	0x10		// Standard frame remote request bit in RXBnSIDL
+#define MCP_SIDL_EXIDE	0x08		// Extended identifier bit in RXBnSIDL, TXBnSIDL and RXFnSIDL
+#define MCP_DLC_RTR		0x40		// Remote request bit in RXBnDLC and TXBnDLC, extended frames use this one
 
 // MCP2515 Interrupt flag register bit definitions
 #define MCP_IRQ_MERR	0x80
@@ -287,3 +364,13 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 #define MCP_IRQ_TXB0	0x04
 #define MCP_IRQ_RXB1	0x02
 #define MCP_IRQ_RXB0	0x01
+
+// MCP2515 Error flag register bit definitions
+#define MCP_EFLG_RX1OVR	0x80
+#define MCP_EFLG_RX0OVR	0x40
+#define MCP_EFLG_TXBO	0x20
+#define MCP_EFLG_TXEP	0x10
+#define MCP_EFLG_RXEP	0x08
+#define MCP_EFLG_TXWAR	0x04
+#define MCP_EFLG_RXWAR	0x02
+#define MCP_EFLG_EWARN	0x01
@@ -0,0 +1,228 @@
+/*
+ * Tritium clock module
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Runs MCLK and SMCLK from the factory calibrated DCO, or the MCP2515 crystal clock output on XIN
+ * - In CLOCK_TRIM mode, the DCO is measured against the crystal once a second and nudged towards INPUT_CLOCK,
+ *   and the tick period is recalculated from the measurement to take up what the DCO steps can't
+ * - If the reference is missing or fails, we stay on (or fall back to) the DCO with ACLK from the VLO
+ * - The watchdog runs from ACLK, and the WDT+ fails safe to MCLK (~2ms) if XIN stops under it, so every
+ *   move off the reference takes the watchdog to the VLO with it
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include <signal.h>
+#include "tri86.h"
+#include "can.h"
+#include "supervisor.h"
+#include "clock.h"
+
+// Public variables
+unsigned char clock_source = CLOCK_DCO;
+unsigned long clock_hz = INPUT_CLOCK;
+unsigned int clock_tick_period = INPUT_CLOCK / 8 / TICK_RATE;
+
+// Private variables
+unsigned char clock_trim_count = CLOCK_TRIM_PERIOD;
+unsigned int clock_trim_sum = 0;
+unsigned char clock_trim_missed = FALSE;
+unsigned char clock_resume = CLOCK_DCO;			// Source to pick up again after an MCP2515 reset
+
+// Private function prototypes
+void clock_fallback( void );
+unsigned int clock_measure( void );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Initialise clock module
+ *	- MCLK  = 16 MHz internal oscillator
+ *	- SMCLK = 16 MHz internal oscillator
+ *	- ACLK  = VLO, for the watchdog
+ *	- The MCP2515 clock output isn't running at CLOCK_CLKPRE until can_init(), clock_reference() then picks it up
+ */
+void clock_init( void )
+{
+	BCSCTL1 = CALBC1_16MHZ;
+	DCOCTL = CALDCO_16MHZ;
+	BCSCTL3 = LFXT1S_2;
+}
+
+/*
+ * Switch to the MCP2515 clock output, as selected by CLOCK_SOURCE
+ *	- Call after can_init()
+ *	- XIN takes an external digital clock in high frequency mode, ACLK = XIN / 8
+ */
+void clock_reference( void )
+{
+#if CLOCK_SOURCE != CLOCK_DCO
+	volatile unsigned int j;
+	unsigned char i;
+
+	BCSCTL1 = CALBC1_16MHZ | XTS | DIVA_3;
+	BCSCTL3 = LFXT1S_3;
+	for( i = 0; i < CLOCK_XT_POLLS; i++ ){
+		IFG1 &= ~OFIFG;
+		for( j = 0; j < 1000; j++ );
+		if(( IFG1 & OFIFG ) == 0x00 ) break;
+	}
+	if( IFG1 & OFIFG ){
+		clock_fallback();
+		return;
+	}
+#if CLOCK_SOURCE == CLOCK_CRYSTAL
+	BCSCTL2 = SELM_3 | SELS;					// MCLK = SMCLK = XIN
+	clock_hz = CLOCK_MCP_HZ;
+	clock_tick_period = CLOCK_MCP_HZ / 8 / TICK_RATE;
+#endif
+	clock_source = CLOCK_SOURCE;
+#endif
+}
+
+/*
+ * Checks the reference, and trims the DCO against it
+ *	- Call every tick, measures every CLOCK_TRIM_PERIOD ticks
+ */
+void clock_service( void )
+{
+	unsigned int count;
+
+	if( clock_source == CLOCK_DCO ) return;
+
+	// A failed XIN clock has switched the watchdog to its MCLK fail-safe, go back to the DCO and VLO
+	// MCLK has already failed over to the DCO in hardware, a failure more than ~2ms before this tick resets instead
+	if( IFG1 & OFIFG ){
+		clock_fallback();
+		return;
+	}
+
+#if CLOCK_SOURCE == CLOCK_TRIM
+	// One short burst per tick over the last CLOCK_TRIM_BURSTS ticks of the period
+	clock_trim_count--;
+	if( clock_trim_count < CLOCK_TRIM_BURSTS ){
+		count = clock_measure();
+		if( count == 0 ) clock_trim_missed = TRUE;
+		clock_trim_sum += count;
+	}
+	if( clock_trim_count != 0 ) return;
+	clock_trim_count = CLOCK_TRIM_PERIOD;
+	count = clock_trim_sum;
+	clock_trim_sum = 0;
+	if( clock_trim_missed == TRUE ){
+		clock_trim_missed = FALSE;
+		return;
+	}
+
+	// A count this far out is a glitched reference, not the DCO, leave the tick alone
+	if(( count > CLOCK_TRIM_TARGET + CLOCK_TRIM_LIMIT ) || ( count < CLOCK_TRIM_TARGET - CLOCK_TRIM_LIMIT )) return;
+
+	// Scale reduced by 64 first, count * 8 * CLOCK_REF_HZ alone overflows 32 bits just above the target
+	clock_hz = (unsigned long)count * ( 8 * CLOCK_REF_HZ / 64 ) / ( CLOCK_TRIM_EDGES / 64 );
+	clock_tick_period = clock_hz / 8 / TICK_RATE;
+
+	// Step DCOx:MODx one modulation step towards the target
+	if(( count > CLOCK_TRIM_TARGET + CLOCK_TRIM_DEADBAND ) && ( DCOCTL != 0x00 )) DCOCTL--;
+	else if(( count < CLOCK_TRIM_TARGET - CLOCK_TRIM_DEADBAND ) && ( DCOCTL != 0xFF )) DCOCTL++;
+#endif
+}
+
+/*
+ * Moves off the MCP2515 clock output before a reset stops it, called by can_reset()
+ *	- Back to the DCO and VLO, with the watchdog, clock_can_reset() picks the reference up again
+ */
+void clock_can_stop( void )
+{
+	clock_resume = clock_source;
+	if( clock_source != CLOCK_DCO ) clock_fallback();
+}
+
+/*
+ * Puts the MCP2515 clock output back after a reset, called by can_reset()
+ *	- A reset returns CLKOUT to /8, which in CLOCK_CRYSTAL mode is MCLK, so set CLOCK_CLKPRE straight away
+ *	- If we were running from the reference before the reset pick it up again, rather than stay on the DCO for good
+ *	- Waiting for XIN takes longer than the watchdog's fail-safe interval, so supervision is held meanwhile
+ *	- The trim measurement in progress spans the reset, start the period again
+ */
+void clock_can_reset( void )
+{
+	can_mod( CANCTRL, 0x03, CLOCK_CLKPRE );	// CANCTRL register, modify lower 2 bits, CLKOUT prescaler
+	if( clock_resume != CLOCK_DCO ){
+		clock_resume = CLOCK_DCO;
+		supervisor_hold();
+		clock_reference();
+		supervisor_resume();
+	}
+	clock_trim_count = CLOCK_TRIM_PERIOD;
+	clock_trim_sum = 0;
+	clock_trim_missed = FALSE;
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Back to the calibrated DCO, ACLK = VLO
+ *	- The watchdog interval follows ACLK, reload it for the VLO
+ */
+void clock_fallback( void )
+{
+	BCSCTL2 = SELM_0;
+	BCSCTL1 = CALBC1_16MHZ;
+	DCOCTL = CALDCO_16MHZ;
+	BCSCTL3 = LFXT1S_2;
+	IFG1 &= ~OFIFG;
+	clock_source = CLOCK_DCO;
+	clock_hz = INPUT_CLOCK;
+	clock_tick_period = INPUT_CLOCK / 8 / TICK_RATE;
+	supervisor_reclock();
+}
+
+/*
+ * Counts Timer A clocks (SMCLK / 8) across CLOCK_TRIM_BURST ACLK periods
+ *	- Timer A CCR2 captures ACLK (CCI2B), every edge has to be seen so interrupts are off for the burst
+ *	- Returns 0 if the reference stopped
+ */
+unsigned int clock_measure( void )
+{
+	unsigned int start, count, i, polls;
+
+	TACCTL2 = CM_1 | CCIS_1 | SCS | CAP;
+	dint();
+	for( i = 0; i <= CLOCK_TRIM_BURST; i++ ){
+		TACCTL2 &= ~( CCIFG | COV );
+		for( polls = 0; ( TACCTL2 & CCIFG ) == 0x00; polls++ ){
+			if( polls == CLOCK_TRIM_POLLS ){
+				eint();
+				TACCTL2 = 0x0000;
+				return( 0 );
+			}
+		}
+		if( i == 0 ) start = TACCR2;
+	}
+	count = TACCR2 - start;
+	if( TACCR2 < start ) count += TACCR0 + 1;	// Timer wrapped at the tick
+	eint();
+	TACCTL2 = 0x0000;
+	return( count );
+}
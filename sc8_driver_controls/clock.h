@@ -0,0 +1,68 @@
+/*
+ * Tritium clock module header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following clock functions:
+ *	- clock_init
+ *	- clock_reference
+ *	- clock_service
+ *	- clock_can_stop
+ *	- clock_can_reset
+ *
+ */
+
+// Public function prototypes
+extern void clock_init( void );
+extern void clock_reference( void );
+extern void clock_service( void );
+extern void clock_can_stop( void );
+extern void clock_can_reset( void );
+
+// Public variables
+extern unsigned char clock_source;			// Source in use, CLOCK_DCO if the reference failed
+extern unsigned long clock_hz;				// Best known MCLK frequency
+extern unsigned int clock_tick_period;		// Timer A period for TICK_RATE at clock_hz, loaded by the tick ISR
+
+// Clock sources, selected with CLOCK_SOURCE in tri86.h
+#define CLOCK_DCO			0				// Factory calibrated DCO, ACLK = VLO
+#define CLOCK_TRIM			1				// DCO, trimmed against the MCP2515 CLKOUT on XIN (ACLK)
+#define CLOCK_CRYSTAL		2				// MCLK & SMCLK run directly from the MCP2515 CLKOUT on XIN
+
+// MCP2515 oscillator, and the CLKOUT prescaler (CANCTRL CLKPRE) set after every MCP2515 reset
+#define CLOCK_MCP_HZ		16000000
+#if CLOCK_SOURCE == CLOCK_TRIM
+#define CLOCK_CLKPRE		0x03			// CLKOUT = /8 = 2MHz, ACLK = /8 again = 250kHz reference
+#define CLOCK_REF_HZ		(CLOCK_MCP_HZ / 8 / 8)
+#else
+#define CLOCK_CLKPRE		0x00			// CLKOUT = /1 = 16MHz
+#define CLOCK_REF_HZ		(CLOCK_MCP_HZ / 8)
+#endif
+
+// Reference start up, OFIFG polls before falling back to the DCO
+#define CLOCK_XT_POLLS		50
+
+// Trimming
+#define CLOCK_TRIM_PERIOD	100				// Ticks between measurements: 100 = 1 second
+#define CLOCK_TRIM_BURST	32				// ACLK periods per burst: 32 = 128us with interrupts off
+#define CLOCK_TRIM_BURSTS	8				// Bursts per measurement, one per tick at the end of the period
+#define CLOCK_TRIM_EDGES	(CLOCK_TRIM_BURST * CLOCK_TRIM_BURSTS)
+#define CLOCK_TRIM_POLLS	256				// Polls for an ACLK edge before the reference counts as stopped, ~10 per edge
+#define CLOCK_TRIM_TARGET	((unsigned int)((unsigned long)INPUT_CLOCK / 8 * CLOCK_TRIM_EDGES / CLOCK_REF_HZ))
+#define CLOCK_TRIM_DEADBAND	3				// Timer A counts, roughly one DCO modulation step
+#define CLOCK_TRIM_LIMIT	(CLOCK_TRIM_TARGET / 8)	// Timer A counts from the target a measurement is believed: 12.5%
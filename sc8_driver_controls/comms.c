@@ -0,0 +1,163 @@
+/*
+ * Tritium periodic comms
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Spreads the periodic frames other than DC_DRIVE over the comms period, at the SCHED_ slots in tri86.h
+ * - Queues the switch and compact status frames, on their slot and on a switch change
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "param.h"
+#include "pedal.h"
+#include "egear.h"
+#include "power.h"
+#include "comms.h"
+
+// Public variables
+volatile unsigned char comms_phase = 0;
+unsigned char loop_min = 0xFF;
+
+// Private variables
+unsigned char comms_last_phase = 0;
+unsigned int comms_sent = 0x0000;				// Slots already sent this period
+unsigned char comms_periods = 0;
+
+// Private function prototypes
+static unsigned char __inline__ sched_due( unsigned char phase, unsigned char slot );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Queue a switch position/activity frame
+ */
+void send_switches( unsigned int switches )
+{
+	can_push_ptr->address = DC_CAN_BASE + DC_SWITCH;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u8[7] = command.state;
+	can_push_ptr->data.data_u8[6] = command.flags;
+	can_push_ptr->data.data_u16[2] = 0;
+	can_push_ptr->data.data_u16[1] = 0;
+	can_push_ptr->data.data_u16[0] = switches;
+	can_push();
+}
+
+/*
+ * Send the periodic frames due by this point in the comms period
+ *	- Call every tick, frames are only sent while connected
+ *	- Catches up on any slot passed while the main loop was busy, so a late tick doesn't drop a frame
+ */
+void comms_schedule( unsigned int switches )
+{
+	unsigned char phase;
+
+	// New period when the phase wraps
+	phase = comms_phase;
+	if(phase < comms_last_phase){
+		comms_sent = 0x0000;
+		comms_periods++;
+		if(comms_periods == SCHED_ID_PERIODS) comms_periods = 0;
+	}
+	comms_last_phase = phase;
+	if(!(events & EVENT_CONNECTED)) return;
+
+	// Transmit bus command frame
+	if(sched_due(phase, SCHED_POWER)){
+		comms_sent |= (1 << SCHED_POWER);
+		power_send();
+	}
+
+	// Transmit switch position/activity frame, or everything packed into one in compact mode
+	if(sched_due(phase, SCHED_SWITCH)){
+		comms_sent |= (1 << SCHED_SWITCH);
+#ifdef USE_COMPACT_TELEMETRY
+		send_status(switches);
+#else
+		send_switches(switches);
+#endif
+	}
+
+	// Repeat the egear command for the current gear, changeovers are sent by the sequencer as they happen
+#ifdef USE_EGEAR
+	if(sched_due(phase, SCHED_EGEAR)){
+		comms_sent |= (1 << SCHED_EGEAR);
+		if(command.state == MODE_N) egear_send(EG_CMD_NEUTRAL);
+		else if((command.state == MODE_BL) || (command.state == MODE_DL) || (command.state == MODE_R)) egear_send(EG_CMD_LOW);
+		else if((command.state == MODE_BH) || (command.state == MODE_DH)) egear_send(EG_CMD_HIGH);
+	}
+#endif
+
+	// Transmit our ID frame at a slower rate, compact mode leaves it to remote requests
+#ifndef USE_COMPACT_TELEMETRY
+	if(sched_due(phase, SCHED_ID)){
+		comms_sent |= (1 << SCHED_ID);
+		if(comms_periods == 0){
+			can_push_ptr->address = DC_CAN_BASE;
+			can_push_ptr->status = 8;
+			can_push_ptr->data.data_u8[7] = 'T';
+			can_push_ptr->data.data_u8[6] = '0';
+			can_push_ptr->data.data_u8[5] = '8';
+			can_push_ptr->data.data_u8[4] = '6';
+			can_push_ptr->data.data_u32[0] = DEVICE_ID;
+			can_push();
+		}
+	}
+#endif
+}
+
+/*
+ * Queue a compact status frame
+ *	- Every byte used: switches, state and flags as in DC_SWITCH, then the raw pedal inputs and loop headroom
+ */
+void send_status( unsigned int switches )
+{
+	unsigned int pedal, slider;
+
+	pedal = ADC12MEM0 & 0x0FFF;
+	slider = ADC12MEM2 & 0x0FFF;
+	can_push_ptr->address = DC_CAN_BASE + DC_STATUS;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u16[0] = switches;
+	can_push_ptr->data.data_u8[2] = command.state;
+	can_push_ptr->data.data_u8[3] = command.flags;
+	can_push_ptr->data.data_u8[4] = pedal;
+	can_push_ptr->data.data_u8[5] = (pedal >> 8) | (slider << 4);
+	can_push_ptr->data.data_u8[6] = slider >> 4;
+	can_push_ptr->data.data_u8[7] = loop_min;
+	can_push();
+	loop_min = 0xFF;
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Whether a comms schedule slot is due at this phase of the period, and not yet sent
+ */
+static unsigned char __inline__ sched_due( unsigned char phase, unsigned char slot )
+{
+	return((phase >= slot) && !(comms_sent & (1 << slot)));
+}
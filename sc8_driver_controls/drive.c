@@ -0,0 +1,266 @@
+/*
+ * Tritium drive state machine
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Chooses the operating state from the switch positions and motor controller speed events
+ * - Drives the gear indicator LEDs to match
+ * - Overrides pedal commands in states that shouldn't drive the motor
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "pedal.h"
+#include "vehicle.h"
+#include "egear.h"
+#include "trace.h"
+#include "drive.h"
+
+// Public variables
+const unsigned int drive_base[MC_MAX] = MC_DRIVE_BASES;
+float drive_split[MC_MAX];
+
+// Private variables
+unsigned char charge_flash_count = CHARGE_FLASH_SPEED;
+const float drive_share[MC_MAX] = MC_SPLIT;
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Works out each motor controller's share of the current commands
+ *	- Scales the MC_SPLIT shares of the controllers fitted by the largest of them, so the controller with the
+ *	  largest share gets the whole pedal command, and an even split gives every controller the whole command
+ *	- Falls back to an even split if none of them is above zero
+ */
+void drive_init( void )
+{
+	unsigned char mc;
+	float largest;
+
+	largest = 0.0;
+	for( mc = 0; mc < MC_COUNT; mc++ ){
+		if( drive_share[mc] > largest ) largest = drive_share[mc];
+	}
+	for( mc = 0; mc < MC_COUNT; mc++ ){
+		if( largest > 0.0 ) drive_split[mc] = drive_share[mc] / largest;
+		else drive_split[mc] = 1.0;
+	}
+}
+
+/*
+ * Works out the next operating state
+ *	- Call once per ADC event, with the debounced switches
+ *	- Returns the next state, the caller updates command.state
+ */
+unsigned char drive_state( unsigned int switches )
+{
+	unsigned char next_state;
+
+	switch(command.state){
+		case MODE_OFF:
+			if(switches & SW_IGN_ON) next_state = MODE_N;
+			else next_state = MODE_OFF;
+			P5OUT &= ~(LED_GEAR_ALL);
+			break;
+		case MODE_N:
+#ifndef USE_EGEAR
+			if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_R;
+			else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BL;
+			else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DL;
+#else
+			if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_CO_R;
+			else if ( (switches & SW_MODE_B) && ( (events & EVENT_SLOW) || (!(events & EVENT_OVER_VEL_LTOH) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_BL;
+			else if ( (switches & SW_MODE_B) && ( ((events & EVENT_OVER_VEL_HTOL) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_BH;
+			else if ( (switches & SW_MODE_D) && ( (events & EVENT_SLOW) || (!(events & EVENT_OVER_VEL_LTOH) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_DL;
+			else if ( (switches & SW_MODE_D) && ( ((events & EVENT_OVER_VEL_HTOL) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_DH;
+#endif
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else if (switches & SW_FUEL) next_state = MODE_CHARGE;
+			else next_state = MODE_N;
+			P5OUT &= ~(LED_GEAR_ALL);
+			P5OUT |= LED_GEAR_3;
+			break;
+		case MODE_CO_R:
+		case MODE_CO_BL:
+		case MODE_CO_BH:
+		case MODE_CO_DL:
+		case MODE_CO_DH:
+			if(switches & SW_MODE_N) next_state = MODE_N;
+			else if((command.state == MODE_CO_R) && (current_egear == EG_STATE_LOW)) next_state = MODE_R;
+			else if((command.state == MODE_CO_BL) && (current_egear == EG_STATE_LOW)) next_state = MODE_BL;
+			else if((command.state == MODE_CO_BH) && (current_egear == EG_STATE_HIGH)) next_state = MODE_BH;
+			else if((command.state == MODE_CO_DL) && (current_egear == EG_STATE_LOW)) next_state = MODE_DL;
+			else if((command.state == MODE_CO_DH) && (current_egear == EG_STATE_HIGH)) next_state = MODE_DH;
+#ifdef USE_EGEAR
+			else if(egear_phase == EGEAR_FAILED) next_state = MODE_N;		// Changeover timed out
+#endif
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else if (switches & SW_FUEL) next_state = MODE_CHARGE;
+			else next_state = command.state;
+			break;
+		case MODE_R:
+			if(switches & SW_MODE_N) next_state = MODE_N;
+			else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BL;	// Assume already in low egear
+			else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DL;	// Assume already in low egear
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else if (switches & SW_FUEL) next_state = MODE_CHARGE;
+			else next_state = MODE_R;
+			P5OUT &= ~(LED_GEAR_ALL);
+			P5OUT |= LED_GEAR_4;
+			break;
+		case MODE_BL:
+			if(switches & SW_MODE_N) next_state = MODE_N;
+			else if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_R;		// Assume already in low egear
+			else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DL;	// Assume already in low egear
+#ifdef USE_EGEAR
+			else if(events & EVENT_OVER_VEL_LTOH) next_state = MODE_CO_BH;
+#endif
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else if (switches & SW_FUEL) next_state = MODE_CHARGE;
+			else next_state = MODE_BL;
+			P5OUT &= ~(LED_GEAR_ALL);
+			P5OUT |= LED_GEAR_2;
+			break;
+		case MODE_BH:
+			if(switches & SW_MODE_N) next_state = MODE_N;
+			else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DH;
+#ifdef USE_EGEAR
+			else if(!(events & EVENT_OVER_VEL_HTOL)) next_state = MODE_CO_BL;
+#endif
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else if (switches & SW_FUEL) next_state = MODE_CHARGE;
+			else next_state = MODE_BH;
+			P5OUT &= ~(LED_GEAR_ALL);
+			P5OUT |= LED_GEAR_2;
+			break;
+		case MODE_DL:
+			if(switches & SW_MODE_N) next_state = MODE_N;
+			else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BL;	// Assume already in low egear
+			else if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_R;		// Assume already in low egear
+#ifdef USE_EGEAR
+			else if(events & EVENT_OVER_VEL_LTOH) next_state = MODE_CO_DH;
+#endif
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else if (switches & SW_FUEL) next_state = MODE_CHARGE;
+			else next_state = MODE_DL;
+			P5OUT &= ~(LED_GEAR_ALL);
+			P5OUT |= LED_GEAR_1;
+			break;
+		case MODE_DH:
+			if(switches & SW_MODE_N) next_state = MODE_N;
+			else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BH;
+#ifdef USE_EGEAR
+			else if(!(events & EVENT_OVER_VEL_HTOL)) next_state = MODE_CO_DL;
+#endif
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else if (switches & SW_FUEL) next_state = MODE_CHARGE;
+			else next_state = MODE_DH;
+			P5OUT &= ~(LED_GEAR_ALL);
+			P5OUT |= LED_GEAR_1;
+			break;
+		case MODE_CHARGE:
+			if(!(switches & SW_FUEL)) next_state = MODE_N;
+			else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
+			else next_state = MODE_CHARGE;
+			// Flash N LED in charge mode
+			charge_flash_count--;
+			P5OUT &= ~(LED_GEAR_4 | LED_GEAR_2 | LED_GEAR_1);
+			if(charge_flash_count == 0){
+				charge_flash_count = (CHARGE_FLASH_SPEED * 2);
+				P5OUT |= LED_GEAR_3;
+			}
+			else if(charge_flash_count == CHARGE_FLASH_SPEED){
+				P5OUT &= ~LED_GEAR_3;
+			}
+			break;
+		default:
+			next_state = MODE_OFF;
+			break;
+	}
+	return( next_state );
+}
+
+/*
+ * Overrides pedal commands if necessary
+ *	- Call before each drive command is sent
+ */
+void drive_limit( unsigned int switches )
+{
+	if(switches & SW_IGN_ON){
+		switch(command.state){
+			case MODE_R:
+			case MODE_DL:
+			case MODE_DH:
+			case MODE_BL:
+			case MODE_BH:
+#ifndef REGEN_ON_BRAKE
+#ifdef CUTOUT_ON_BRAKE
+				if(switches & SW_BRAKE){
+					command.current = 0.0;	
+					command.rpm = 0.0;
+				}
+#endif
+#endif
+				break;
+			case MODE_CHARGE:
+			case MODE_N:
+			case MODE_START:
+			case MODE_OFF:
+			case MODE_ON:
+			case MODE_CO_R:
+			case MODE_CO_DL:
+			case MODE_CO_DH:
+			case MODE_CO_BL:
+			case MODE_CO_BH:
+			default:
+				command.current = 0.0;
+				command.rpm = 0.0;
+				break;
+		}
+	}
+	else{
+		command.current = 0.0;
+		command.rpm = 0.0;
+	}
+}
+
+/*
+ * Queue a drive command frame to each motor controller
+ *	- Same speed to all, current is this controller's share of the pedal command, from drive_init()
+ */
+void drive_send( void )
+{
+	unsigned char mc;
+	float current;
+
+	for( mc = 0; mc < MC_COUNT; mc++ ){
+		current = command.current * drive_split[mc];
+		if( current > 1.0 ) current = 1.0;
+		can_push_ptr->address = drive_base[mc] + DC_DRIVE;
+		can_push_ptr->status = 8;
+		can_push_ptr->data.data_fp[1] = current;
+		can_push_ptr->data.data_fp[0] = command.rpm;
+		if( mc == 0 ) TRACE_FRAME_QUEUED( can_push_ptr );
+		can_push();
+	}
+}
@@ -0,0 +1,198 @@
+/*
+ * Tritium eGear changeover sequencer
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Runs the low / high contactor changeover as soon as the drive state machine enters a MODE_CO_* state,
+ *   rather than a step per 100ms comms event
+ * - Each step is taken as soon as the frame that allows it arrives: MC_LIMITS reporting neutral lets the
+ *   contactors open, EG_STATUS reporting neutral lets the target gear close
+ * - Unanswered commands are repeated, and the changeover is abandoned after EGEAR_TIMEOUT
+ * - Reports each changeover's outcome and duration on DC_EGEAR
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "vehicle.h"
+#include "atomic.h"
+#include "egear.h"
+
+// Public variables
+unsigned char egear_phase = EGEAR_IDLE;
+
+// Private variables
+unsigned char egear_target;						// EG_STATE_LOW or EG_STATE_HIGH
+unsigned char egear_from;						// current_egear at the start
+unsigned char egear_command = EGEAR_CMD_NONE;	// Last command sent
+unsigned char egear_retries;
+unsigned int egear_start;						// tick_count on entering the changeover state
+unsigned int egear_sent;						// tick_count of the last command
+unsigned int egear_mc_wait;						// Ticks spent waiting for the motor controller
+
+// Private function prototypes
+void egear_issue( unsigned char command );
+void egear_finish( unsigned char result );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Follow a drive state change
+ *	- Call when the state machine picks a new state, before command.state is updated
+ *	- Entering a changeover state starts the sequence straight away, leaving one early cancels it
+ */
+void egear_state( unsigned char next_state )
+{
+	unsigned char target;
+
+	switch( next_state ){
+		case MODE_CO_R:
+		case MODE_CO_BL:
+		case MODE_CO_DL:
+			target = EG_STATE_LOW;
+			break;
+		case MODE_CO_BH:
+		case MODE_CO_DH:
+			target = EG_STATE_HIGH;
+			break;
+		default:
+			target = EG_STATE_NEUTRAL;
+			break;
+	}
+
+	if( target != EG_STATE_NEUTRAL ){
+		egear_phase = EGEAR_WAIT_MC;
+		egear_target = target;
+		egear_from = current_egear;
+		egear_command = EGEAR_CMD_NONE;
+		egear_retries = 0;
+		egear_start = tick_count;
+		egear_mc_wait = 0;
+		// Send the zero current drive command now rather than at the next comms event
+		event_post( EVENT_COMMS );
+		egear_update();
+	}
+	else{
+		if(( egear_phase == EGEAR_WAIT_MC ) || ( egear_phase == EGEAR_NEUTRAL ) || ( egear_phase == EGEAR_ENGAGE )){
+			egear_finish( EGEAR_RESULT_CANCELLED );
+		}
+		// Changeover finished, resume driving without waiting for the next comms event
+		if( egear_phase == EGEAR_DONE ) event_post( EVENT_COMMS );
+		egear_phase = EGEAR_IDLE;
+	}
+}
+
+/*
+ * Take the next changeover step if it's allowed yet
+ *	- Call on receipt of EG_STATUS and MC_LIMITS
+ */
+void egear_update( void )
+{
+	switch( egear_phase ){
+		case EGEAR_WAIT_MC:
+		case EGEAR_NEUTRAL:
+		case EGEAR_ENGAGE:
+			if( current_egear == egear_target ){
+				egear_finish( EGEAR_RESULT_DONE );
+			}
+			else if( current_egear == EG_STATE_NEUTRAL ){
+				// Contactors open, close the target gear
+				egear_phase = EGEAR_ENGAGE;
+				if( egear_target == EG_STATE_HIGH ) egear_issue( EG_CMD_HIGH );
+				else egear_issue( EG_CMD_LOW );
+			}
+			else if(( egear_phase == EGEAR_WAIT_MC ) && ( events & EVENT_MC_NEUTRAL )){
+				// No motor current, safe to open the contactors
+				egear_phase = EGEAR_NEUTRAL;
+				egear_mc_wait = tick_count - egear_start;
+				egear_issue( EG_CMD_NEUTRAL );
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Retry and timeout handling
+ *	- Call every tick
+ */
+void egear_tick( void )
+{
+	if(( egear_phase != EGEAR_WAIT_MC ) && ( egear_phase != EGEAR_NEUTRAL ) && ( egear_phase != EGEAR_ENGAGE )) return;
+
+	if(( tick_count - egear_start ) >= EGEAR_TIMEOUT ){
+		if( egear_phase == EGEAR_WAIT_MC ) egear_mc_wait = tick_count - egear_start;
+		egear_finish( EGEAR_RESULT_TIMEOUT );
+		egear_phase = EGEAR_FAILED;
+	}
+	else if(( egear_command != EGEAR_CMD_NONE ) && (( tick_count - egear_sent ) >= EGEAR_RETRY )){
+		if( egear_retries != 0xFF ) egear_retries++;
+		egear_issue( egear_command );
+	}
+}
+
+/*
+ * Queue an eGear command frame
+ */
+void egear_send( unsigned char command )
+{
+	can_push_ptr->address = EG_CAN_BASE + EG_COMMAND;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u32[0] = 0;
+	can_push_ptr->data.data_u32[1] = 0;
+	can_push_ptr->data.data_u8[0] = command;
+	can_push();
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Send a changeover command and start its retry timer
+ */
+void egear_issue( unsigned char command )
+{
+	egear_send( command );
+	egear_command = command;
+	egear_sent = tick_count;
+}
+
+/*
+ * End the changeover and report it
+ */
+void egear_finish( unsigned char result )
+{
+	egear_phase = EGEAR_DONE;
+	egear_command = EGEAR_CMD_NONE;
+
+	can_push_ptr->address = DC_CAN_BASE + DC_EGEAR;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u8[0] = result;
+	can_push_ptr->data.data_u8[1] = egear_from;
+	can_push_ptr->data.data_u8[2] = egear_target;
+	can_push_ptr->data.data_u8[3] = egear_retries;
+	can_push_ptr->data.data_u16[2] = ( tick_count - egear_start ) * ( 1000 / TICK_RATE );
+	can_push_ptr->data.data_u16[3] = egear_mc_wait * ( 1000 / TICK_RATE );
+	can_push();
+}
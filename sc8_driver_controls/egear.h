@@ -0,0 +1,59 @@
+/*
+ * Tritium eGear changeover sequencer header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following eGear changeover functions
+ *	- egear_state
+ *	- egear_update
+ *	- egear_tick
+ *	- egear_send
+ *
+ */
+
+// Public function prototypes
+extern void egear_state( unsigned char next_state );
+extern void egear_update( void );
+extern void egear_tick( void );
+extern void egear_send( unsigned char command );
+
+// Public variables
+extern unsigned char egear_phase;
+
+// Changeover phases
+#define EGEAR_IDLE				0				// No changeover in progress
+#define EGEAR_WAIT_MC			1				// Waiting for the motor controller to reach neutral (zero current)
+#define EGEAR_NEUTRAL			2				// Commanded the contactors to neutral
+#define EGEAR_ENGAGE			3				// Commanded the target gear
+#define EGEAR_DONE				4				// Target gear reported
+#define EGEAR_FAILED			5				// Timed out, the state machine drops back to MODE_N
+
+// Timing, ticks
+#define EGEAR_RETRY				5				// Resend an unanswered command after 50ms
+#define EGEAR_TIMEOUT			200				// Give up on the whole changeover after 2s
+
+// No command outstanding
+#define EGEAR_CMD_NONE			0xFF
+
+// Changeover report, sent on DC_EGEAR when a changeover finishes
+//	byte 0 = result, byte 1 = eGear state at the start, byte 2 = target state, byte 3 = command retries
+//	bytes 4-5 = ms from entering the changeover state to the target gear being reported (or to giving up)
+//	bytes 6-7 = ms of that spent waiting for the motor controller to reach neutral
+#define EGEAR_RESULT_DONE		0
+#define EGEAR_RESULT_TIMEOUT	1
+#define EGEAR_RESULT_CANCELLED	2				// Left the changeover state first, eg: driver selected neutral
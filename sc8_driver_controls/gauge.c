@@ -29,7 +29,10 @@
 // Include files
 #include <msp430x24x.h>
 #include "tri86.h"
+#include "param.h"
 #include "gauge.h"
+#include "atomic.h"
+#include "clock.h"
 
 // Public variables
 gauge_variables	gauge;
@@ -50,7 +53,7 @@ void gauge_init( void )
 	gauge.g2_count = 0;
 	gauge.g3_duty = 0;
 	gauge.g4_duty = 0;
-	events |= (EVENT_GAUGE1 | EVENT_GAUGE2 | EVENT_GAUGE3 | EVENT_GAUGE4);
+	event_post( EVENT_GAUGE1 | EVENT_GAUGE2 | EVENT_GAUGE3 | EVENT_GAUGE4 );
 }
 
 /*
@@ -64,9 +67,9 @@ void gauge_tach_update( float motor_rpm )
 		gauge.g1_count = 0;
 	}
 	else {
-		gauge.g1_count = (unsigned int)( ((float)GAUGE_FREQ * GAUGE1_SCALE) / motor_rpm );
+		gauge.g1_count = (unsigned int)( (GAUGE_RATE * GAUGE1_SCALE) / motor_rpm );
 	}
-	events |= EVENT_GAUGE1;
+	event_post( EVENT_GAUGE1 );
 }
 
 /*
@@ -82,9 +85,9 @@ void gauge_power_update( float battery_voltage, float battery_current )
 		gauge.g2_count = 0;
 	}
 	else {
-		gauge.g2_count = (unsigned int)( ((float)GAUGE_FREQ * GAUGE2_SCALE) / temp );
+		gauge.g2_count = (unsigned int)( (GAUGE_RATE * GAUGE2_SCALE) / temp );
 	}
-	events |= EVENT_GAUGE2;
+	event_post( EVENT_GAUGE2 );
 }
 
 /*
@@ -100,7 +103,7 @@ void gauge_temp_update( float motor_temp, float controller_temp )
 	// Check limits
 	if(temp > GAUGE_PWM_PERIOD) temp = GAUGE_PWM_PERIOD;
 	gauge.g3_duty = temp;
-	events |= EVENT_GAUGE3;
+	event_post( EVENT_GAUGE3 );
 }
 
 /*
@@ -115,6 +118,6 @@ void gauge_fuel_update( float battery_voltage )
 	// Check limits
 	if(temp > GAUGE_PWM_PERIOD) temp = GAUGE_PWM_PERIOD;
 	gauge.g4_duty = temp;
-	events |= EVENT_GAUGE4;
+	event_post( EVENT_GAUGE4 );
 }
 
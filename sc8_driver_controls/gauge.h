@@ -35,6 +35,7 @@ extern void gauge_temp_update( float motor_temp, float controller_temp );
 extern void gauge_fuel_update( float battery_voltage );
 
 // Public variables
+// Pending settings: written by the update functions, then latched by the Timer B ISR when it consumes EVENT_GAUGEx
 typedef struct _gauge_variables {
 	unsigned int g1_count;
 	unsigned int g2_count;
@@ -50,13 +51,15 @@ extern gauge_variables gauge;
 // Fuel and Temp outputs are PWM hardware outputs
 #define GAUGE_FREQ			10000						
 #define GAUGE_PWM_PERIOD	(INPUT_CLOCK / 8 / GAUGE_FREQ)
+// Actual ISR rate, from the measured clock
+#define GAUGE_RATE			((float)clock_hz / 8 / GAUGE_PWM_PERIOD)
 
 // Tachometer gauge scaling
 // BMW e36 gauge cluster: 350Hz = 7000rpm = full scale
 // With timer ISR at 10kHz, output count = (10000 * 20) / rpm
 // Do scaling in floating point maths to make user modifications simple
 // Below the minimum, do not try to display a value
-#define GAUGE1_SCALE		20.0f
+#define GAUGE1_SCALE_DEFAULT	20.0f
 #define GAUGE1_MIN			100
 #define GAUGE1_MAX			7000
 
@@ -64,10 +67,14 @@ extern gauge_variables gauge;
 // BMW e36 gauge cluster: 325Hz = 260km/h = full scale
 // With timer ISR at 10kHz, output count = (10000 * 0.8) / km/h
 // Below the minimum, do not try to display a value
-#define GAUGE2_SCALE		0.8f
+#define GAUGE2_SCALE_DEFAULT	0.8f
 #define GAUGE2_MIN			10
 #define GAUGE2_MAX			260
 
+// Tunable values, read from the parameter store RAM copy (see param.h), defaults above
+#define GAUGE1_SCALE		(param_value[PARAM_GAUGE1_SCALE].data_fp)
+#define GAUGE2_SCALE		(param_value[PARAM_GAUGE2_SCALE].data_fp)
+
 // Fuel gauge scaling
 // BMW e36 gauge cluster: 10 Ohm = Empty, 100 Ohm = Full
 
@@ -46,6 +46,10 @@
 /*----------------------------------------------------------------------------*/
 /* Version: 1.213                                                             */
 /*----------------------------------------------------------------------------*/
+/* TI compiler only.  The mspgcc build links the application with              */
+/* msp430x247_app.x and the bootloader, as a separate image, with              */
+/* msp430x247_boot.x; keep the bootloader layout of all three in step.         */
+/*----------------------------------------------------------------------------*/
 
 /****************************************************************************/
 /* Specify the system memory map                                            */
@@ -56,44 +60,47 @@ MEMORY
     SFR                     : origin = 0x0000, length = 0x0010
     PERIPHERALS_8BIT        : origin = 0x0010, length = 0x00F0
     PERIPHERALS_16BIT       : origin = 0x0100, length = 0x0100
-    RAM                     : origin = 0x1100, length = 0x1000
+    RAM                     : origin = 0x1104, length = 0x0FFC     /* 0x1100 - 0x1103: bootload handoff */
     INFOA                   : origin = 0x10C0, length = 0x0040
     INFOB                   : origin = 0x1080, length = 0x0040
     INFOC                   : origin = 0x1040, length = 0x0040
     INFOD                   : origin = 0x1000, length = 0x0040
-    FLASH                   : origin = 0x8000, length = 0x7FC0
-    BSLSIGNATURE            : origin = 0xFFDE, length = 0x0002, fill = 0xFFFF
-    INT00                   : origin = 0xFFC0, length = 0x0002
-    INT01                   : origin = 0xFFC2, length = 0x0002
-    INT02                   : origin = 0xFFC4, length = 0x0002
-    INT03                   : origin = 0xFFC6, length = 0x0002
-    INT04                   : origin = 0xFFC8, length = 0x0002
-    INT05                   : origin = 0xFFCA, length = 0x0002
-    INT06                   : origin = 0xFFCC, length = 0x0002
-    INT07                   : origin = 0xFFCE, length = 0x0002
-    INT08                   : origin = 0xFFD0, length = 0x0002
-    INT09                   : origin = 0xFFD2, length = 0x0002
-    INT10                   : origin = 0xFFD4, length = 0x0002
-    INT11                   : origin = 0xFFD6, length = 0x0002
-    INT12                   : origin = 0xFFD8, length = 0x0002
-    INT13                   : origin = 0xFFDA, length = 0x0002
-    INT14                   : origin = 0xFFDC, length = 0x0002
-    INT16                   : origin = 0xFFE0, length = 0x0002
-    INT17                   : origin = 0xFFE2, length = 0x0002
-    INT18                   : origin = 0xFFE4, length = 0x0002
-    INT19                   : origin = 0xFFE6, length = 0x0002
-    INT20                   : origin = 0xFFE8, length = 0x0002
-    INT21                   : origin = 0xFFEA, length = 0x0002
-    INT22                   : origin = 0xFFEC, length = 0x0002
-    INT23                   : origin = 0xFFEE, length = 0x0002
-    INT24                   : origin = 0xFFF0, length = 0x0002
-    INT25                   : origin = 0xFFF2, length = 0x0002
-    INT26                   : origin = 0xFFF4, length = 0x0002
-    INT27                   : origin = 0xFFF6, length = 0x0002
-    INT28                   : origin = 0xFFF8, length = 0x0002
-    INT29                   : origin = 0xFFFA, length = 0x0002
-    INT30                   : origin = 0xFFFC, length = 0x0002
-    RESET                   : origin = 0xFFFE, length = 0x0002
+    FLASH                   : origin = 0x8000, length = 0x77C0
+    /* Application vectors, the hardware vectors forward here through the bootloader */
+    INT00                   : origin = 0xF7C0, length = 0x0002
+    INT01                   : origin = 0xF7C2, length = 0x0002
+    INT02                   : origin = 0xF7C4, length = 0x0002
+    INT03                   : origin = 0xF7C6, length = 0x0002
+    INT04                   : origin = 0xF7C8, length = 0x0002
+    INT05                   : origin = 0xF7CA, length = 0x0002
+    INT06                   : origin = 0xF7CC, length = 0x0002
+    INT07                   : origin = 0xF7CE, length = 0x0002
+    INT08                   : origin = 0xF7D0, length = 0x0002
+    INT09                   : origin = 0xF7D2, length = 0x0002
+    INT10                   : origin = 0xF7D4, length = 0x0002
+    INT11                   : origin = 0xF7D6, length = 0x0002
+    INT12                   : origin = 0xF7D8, length = 0x0002
+    INT13                   : origin = 0xF7DA, length = 0x0002
+    INT14                   : origin = 0xF7DC, length = 0x0002
+    INT16                   : origin = 0xF7E0, length = 0x0002
+    INT17                   : origin = 0xF7E2, length = 0x0002
+    INT18                   : origin = 0xF7E4, length = 0x0002
+    INT19                   : origin = 0xF7E6, length = 0x0002
+    INT20                   : origin = 0xF7E8, length = 0x0002
+    INT21                   : origin = 0xF7EA, length = 0x0002
+    INT22                   : origin = 0xF7EC, length = 0x0002
+    INT23                   : origin = 0xF7EE, length = 0x0002
+    INT24                   : origin = 0xF7F0, length = 0x0002
+    INT25                   : origin = 0xF7F2, length = 0x0002
+    INT26                   : origin = 0xF7F4, length = 0x0002
+    INT27                   : origin = 0xF7F6, length = 0x0002
+    INT28                   : origin = 0xF7F8, length = 0x0002
+    INT29                   : origin = 0xF7FA, length = 0x0002
+    INT30                   : origin = 0xF7FC, length = 0x0002
+    RESET                   : origin = 0xF7FE, length = 0x0002
+    /* Resident CAN bootloader and hardware vectors, see bootload.h */
+    BOOTLOADER              : origin = 0xF800, length = 0x07C0
+    BOOTVECTORS             : origin = 0xFFC0, length = 0x0040
 }
 
 /****************************************************************************/
@@ -111,7 +118,8 @@ SECTIONS
     .text       : {} > FLASH                /* Code                              */
     .cinit      : {} > FLASH                /* Initialization tables             */
     .const      : {} > FLASH                /* Constant data                     */
-    .bslsignature  : {} > BSLSIGNATURE      /* BSL Signature                     */
+    .bootloader : {} > BOOTLOADER           /* Bootloader code, never erased by itself */
+    .bootvectors : {} > BOOTVECTORS         /* Hardware vectors, BSL signature left erased */
     .cio        : {} > RAM                  /* C I/O Buffer                      */
 
     .pinit      : {} > FLASH                /* C++ Constructor tables            */
@@ -0,0 +1,169 @@
+/*
+ * Tritium telemetry logger
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Flight recorder for driveability problems
+ * - Records pedal inputs, commands, state, switches, motor rpm and fault flags at 100 Hz into a RAM ring buffer
+ * - A fault event freezes the buffer LOGGER_POST_TRIGGER entries later, keeping the lead-up and aftermath
+ * - The frozen buffer is streamed out over CAN on request, without crowding out drive commands
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "pedal.h"
+#include "logger.h"
+
+// Private variables
+log_entry logger_buffer[LOGGER_ENTRIES];
+unsigned char logger_head;					// Next entry to write
+unsigned char logger_count;					// Valid entries in buffer
+unsigned char logger_cause;					// Freeze cause, LOG_CAUSE_NONE while recording
+unsigned char logger_post;					// Entries left to record after a trigger
+unsigned char logger_frozen;
+unsigned char logger_request;				// Command waiting for logger_service
+unsigned int logger_dump_offset;			// Next byte to stream
+unsigned char logger_dumping;
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Clears the buffer and starts recording
+ */
+void logger_init( void )
+{
+	logger_head = 0;
+	logger_count = 0;
+	logger_cause = LOG_CAUSE_NONE;
+	logger_post = 0;
+	logger_frozen = FALSE;
+	logger_request = 0xFF;
+	logger_dumping = FALSE;
+}
+
+/*
+ * Records one entry
+ *	- Call once per ADC event, after the pedal and state machine have been processed
+ */
+void logger_record( unsigned int analog_a, unsigned int analog_c, unsigned int switches, float motor_rpm )
+{
+	log_entry *entry;
+
+	if( logger_frozen == TRUE ) return;
+
+	entry = &logger_buffer[logger_head];
+	entry->pedal = ( analog_a & 0x0FFF ) | ((unsigned int)command.state << 12 );
+	entry->regen = ( analog_c & 0x0FFF ) | ((unsigned int)can_state << 12 );
+	entry->rpm = (int)command.rpm;
+	entry->current = (unsigned char)( command.current * 255.0 );
+	entry->flags = command.flags;
+	entry->motor_rpm = (int)motor_rpm;
+	entry->switches = switches;
+
+	logger_head++;
+	if( logger_head == LOGGER_ENTRIES ) logger_head = 0;
+	if( logger_count < LOGGER_ENTRIES ) logger_count++;
+
+	// Count down to freeze after a trigger
+	if( logger_cause != LOG_CAUSE_NONE ){
+		if( logger_post == 0 ) logger_frozen = TRUE;
+		else logger_post--;
+	}
+}
+
+/*
+ * Signals a fault event
+ *	- Only the first event is kept until the logger is re-armed
+ */
+void logger_trigger( unsigned char cause )
+{
+	if( logger_cause != LOG_CAUSE_NONE ) return;
+	logger_cause = cause;
+	logger_post = LOGGER_POST_TRIGGER;
+}
+
+/*
+ * Accepts a logger request from the CAN receive dispatch
+ */
+void logger_receive( void )
+{
+	logger_request = can.data.data_u8[0];
+}
+
+/*
+ * Handles logger requests and streams the buffer
+ *	- Call from the main loop when nothing more urgent is waiting
+ *	- Queues at most LOG_FRAMES_PER_SERVICE data frames, and only while the CAN queue has room to spare
+ */
+void logger_service( void )
+{
+	unsigned int position;
+	unsigned char i, frames;
+
+	switch( logger_request ){
+		case LOG_CMD_STATUS:
+			can_push_ptr->address = DC_CAN_BASE + DC_LOG_DATA;
+			can_push_ptr->status = 8;
+			can_push_ptr->data.data_u16[0] = LOG_STATUS_OFFSET;
+			can_push_ptr->data.data_u8[2] = logger_cause;
+			can_push_ptr->data.data_u8[3] = sizeof(log_entry);
+			can_push_ptr->data.data_u16[2] = logger_count;
+			can_push_ptr->data.data_u16[3] = logger_count * sizeof(log_entry);
+			can_push();
+			break;
+		case LOG_CMD_DUMP:
+			if( logger_cause == LOG_CAUSE_NONE ) logger_cause = LOG_CAUSE_REQUEST;
+			logger_frozen = TRUE;
+			logger_dump_offset = 0;
+			logger_dumping = TRUE;
+			break;
+		case LOG_CMD_ARM:
+			logger_init();
+			break;
+	}
+	logger_request = 0xFF;
+
+	if( logger_dumping == FALSE ) return;
+
+	for( frames = 0; frames < LOG_FRAMES_PER_SERVICE; frames++ ){
+		if( logger_dump_offset >= ( logger_count * sizeof(log_entry) )){
+			logger_dumping = FALSE;
+			return;
+		}
+		if( can_queue_free() <= LOG_QUEUE_RESERVE ) return;
+
+		can_push_ptr->address = DC_CAN_BASE + DC_LOG_DATA;
+		can_push_ptr->status = 8;
+		can_push_ptr->data.data_u16[0] = logger_dump_offset;
+		// Oldest entry is at the write position once the buffer has wrapped
+		position = logger_dump_offset;
+		if( logger_count == LOGGER_ENTRIES ) position += logger_head * sizeof(log_entry);
+		for( i = 0; i < LOG_DATA_BYTES; i++ ){
+			if( position >= LOGGER_BYTES ) position -= LOGGER_BYTES;
+			can_push_ptr->data.data_u8[2 + i] = ((unsigned char *)logger_buffer)[position];
+			position++;
+		}
+		can_push();
+		logger_dump_offset += LOG_DATA_BYTES;
+	}
+}
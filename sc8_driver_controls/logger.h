@@ -0,0 +1,72 @@
+/*
+ * Tritium telemetry logger header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following logger functions:
+ *	- logger_init
+ *	- logger_record
+ *	- logger_trigger
+ *	- logger_receive
+ *	- logger_service
+ *
+ */
+
+// Public function prototypes
+extern void logger_init( void );
+extern void logger_record( unsigned int analog_a, unsigned int analog_c, unsigned int switches, float motor_rpm );
+extern void logger_trigger( unsigned char cause );
+extern void logger_receive( void );
+extern void logger_service( void );
+
+// Log entry, one per ADC event (100 Hz)
+typedef struct _log_entry {
+	unsigned int pedal;							// Pedal A ADC in bits 0-11, command state in bits 12-15
+	unsigned int regen;							// Regen slider C ADC in bits 0-11, CAN bus error state in bits 12-13
+	int rpm;									// Commanded rpm
+	unsigned char current;						// Commanded current, 0 - 255 = 0 - 100%
+	unsigned char flags;						// Pedal fault flags
+	int motor_rpm;								// Measured motor rpm
+	unsigned int switches;						// Switch inputs, DC_SWITCH layout
+} log_entry;
+
+// Buffer sizing
+#define LOGGER_ENTRIES			100				// 1 second of history = 1200 bytes of RAM
+#define LOGGER_POST_TRIGGER		25				// Entries still recorded after a trigger
+#define LOGGER_BYTES			(LOGGER_ENTRIES * sizeof(log_entry))
+
+// Freeze causes
+#define LOG_CAUSE_NONE			0
+#define LOG_CAUSE_PEDAL			1				// command.flags non-zero
+#define LOG_CAUSE_CAN			2				// CAN controller error
+#define LOG_CAUSE_OFF_MOVING	3				// Switched to MODE_OFF above ENGAGE_VEL speeds
+#define LOG_CAUSE_REQUEST		4				// Dump requested over CAN
+#define LOG_CAUSE_MC_LOST		5				// Motor controller link timed out
+
+// CAN protocol, requests on DC_CAN_BASE + DC_LOG, replies and data on DC_CAN_BASE + DC_LOG_DATA
+//	Request: byte 0 = command
+//	Status reply: bytes 0-1 = 0xFFFF, byte 2 = cause, byte 3 = sizeof(log_entry), bytes 4-5 = entries, bytes 6-7 = total bytes
+//	Data frames: bytes 0-1 = byte offset from the oldest entry, bytes 2-7 = log data
+#define LOG_CMD_STATUS			0x00
+#define LOG_CMD_DUMP			0x01			// Freeze (if not already) and stream the whole buffer, oldest first
+#define LOG_CMD_ARM				0x02			// Clear the freeze and start recording again
+
+#define LOG_STATUS_OFFSET		0xFFFF
+#define LOG_DATA_BYTES			6
+#define LOG_FRAMES_PER_SERVICE	4				// Data frames queued per call to logger_service
+#define LOG_QUEUE_RESERVE		8				// Leave this much CAN queue free for drive commands
@@ -0,0 +1,165 @@
+/* Application linker script for the MSP430F247 with the resident CAN bootloader, mspgcc (GNU ld)  */
+/*                                                                                                 */
+/* Follows the stock mspgcc msp430x247 script, except that the application is kept out of the     */
+/* top 2k of flash and its interrupt vector table is moved down to the application vectors that    */
+/* the bootloader stubs forward to.  crt430x247.o supplies the 16 entry table for 0xFFE0 - 0xFFFF, */
+/* so it lands at 0xF7E0 - 0xF7FF with the reset vector at BOOT_APP_RESET.                          */
+/* Flash layout must match bootload.h, msp430x247_boot.x and lnk_msp430f247.cmd                     */
+/*                                                                                                 */
+/*    0x8000 - 0xF7BF    Application code and constants                                            */
+/*    0xF7C0 - 0xF7DF    Application vectors for 0xFFC0 - 0xFFDF, unused by mspgcc                 */
+/*    0xF7E0 - 0xF7FF    Application vectors for 0xFFE0 - 0xFFFF                                   */
+/*    0xF800 - 0xFFFF    Bootloader, linked separately by msp430x247_boot.x                        */
+/*                                                                                                 */
+/* RAM starts 4 bytes up, at 0x1104: 0x1100 - 0x1103 hold the bootload request handoff             */
+/* (BOOT_HANDOFF_ADDR), which must not be shared with application variables.                       */
+
+OUTPUT_FORMAT("elf32-msp430","elf32-msp430","elf32-msp430")
+
+MEMORY
+{
+  text          (rx)    : ORIGIN = 0x8000, LENGTH = 0x77C0
+  data          (rwx)   : ORIGIN = 0x1104, LENGTH = 0x0FFC
+  vectors       (rw)    : ORIGIN = 0xF7E0, LENGTH = 0x20
+  infomem       (rx)    : ORIGIN = 0x1000, LENGTH = 0x100
+  infomemnobits (rx)    : ORIGIN = 0x1000, LENGTH = 0x100
+}
+
+SECTIONS
+{
+  .text :
+  {
+    . = ALIGN(2);
+    *(.init)
+    *(.init0)  /* Start here after reset               */
+    *(.init1)
+    *(.init2)  /* Copy data loop                       */
+    *(.init3)
+    *(.init4)  /* Clear bss                            */
+    *(.init5)
+    *(.init6)  /* C++ constructors                     */
+    *(.init7)
+    *(.init8)
+    *(.init9)  /* Call main                            */
+     __ctors_start = . ;
+     *(.ctors)
+     __ctors_end = . ;
+     __dtors_start = . ;
+     *(.dtors)
+     __dtors_end = . ;
+    . = ALIGN(2);
+    *(.text)
+    . = ALIGN(2);
+    *(.text.*)
+    . = ALIGN(2);
+    *(.rodata)
+    *(.rodata.*)
+    . = ALIGN(2);
+    *(.fini9)
+    *(.fini8)
+    *(.fini7)
+    *(.fini6)  /* C++ destructors                      */
+    *(.fini5)
+    *(.fini4)
+    *(.fini3)
+    *(.fini2)
+    *(.fini1)
+    *(.fini0)  /* Infinite loop after program termination */
+    *(.fini)
+    _etext = . ;
+  }  > text
+
+  .data : AT (ADDR (.text) + SIZEOF (.text))
+  {
+     PROVIDE (__data_start = .) ;
+    . = ALIGN(2);
+    *(.data)
+    *(SORT(.data.*))
+    . = ALIGN(2);
+    *(.gnu.linkonce.d*)
+    . = ALIGN(2);
+     _edata = . ;
+  }  > data
+  PROVIDE (__data_load_start = LOADADDR(.data) );
+  PROVIDE (__data_size = SIZEOF(.data) );
+
+  /* Bootloader code must never end up in the application image */
+  .bootloader :
+  {
+    *(.bootloader)
+    *(.bootloader.*)
+    *(.bootvectors)
+  }
+  ASSERT( SIZEOF(.bootloader) == 0, "bootloader code in the application image, link bootload.c with msp430x247_boot.x" )
+
+  .infomem :
+  {
+    *(.infomem)
+    . = ALIGN(2);
+    *(.infomem.*)
+  }  > infomem
+
+  .infomemnobits :
+  {
+    *(.infomemnobits)
+    . = ALIGN(2);
+    *(.infomemnobits.*)
+  }  > infomemnobits
+
+  .bss :
+  {
+     PROVIDE (__bss_start = .) ;
+    *(.bss)
+    *(SORT(.bss.*))
+    *(COMMON)
+     PROVIDE (__bss_end = .) ;
+     _end = . ;
+  }  > data
+  PROVIDE (__bss_size = SIZEOF(.bss) );
+
+  .noinit :
+  {
+     PROVIDE (__noinit_start = .) ;
+    *(.noinit)
+    *(.noinit.*)
+     PROVIDE (__noinit_end = .) ;
+     _end = . ;
+  }  > data
+
+  .vectors :
+  {
+     PROVIDE (__vectors_start = .) ;
+    *(.vectors*)
+     _vectors_end = . ;
+  }  > vectors
+
+  /* Profiling, and stabs and DWARF debugging sections, as the stock script */
+  .profiler 0 : { *(.profiler) }
+  .stab 0 : { *(.stab) }
+  .stabstr 0 : { *(.stabstr) }
+  .stab.excl 0 : { *(.stab.excl) }
+  .stab.exclstr 0 : { *(.stab.exclstr) }
+  .stab.index 0 : { *(.stab.index) }
+  .stab.indexstr 0 : { *(.stab.indexstr) }
+  .comment 0 : { *(.comment) }
+  .debug          0 : { *(.debug) }
+  .line           0 : { *(.line) }
+  .debug_srcinfo  0 : { *(.debug_srcinfo) }
+  .debug_sfnames  0 : { *(.debug_sfnames) }
+  .debug_aranges  0 : { *(.debug_aranges) }
+  .debug_pubnames 0 : { *(.debug_pubnames) }
+  .debug_info     0 : { *(.debug_info) *(.gnu.linkonce.wi.*) }
+  .debug_abbrev   0 : { *(.debug_abbrev) }
+  .debug_line     0 : { *(.debug_line) }
+  .debug_frame    0 : { *(.debug_frame) }
+  .debug_str      0 : { *(.debug_str) }
+  .debug_loc      0 : { *(.debug_loc) }
+  .debug_macinfo  0 : { *(.debug_macinfo) }
+
+  PROVIDE (__stack = 0x2100) ;
+  PROVIDE (__data_start_rom = _etext) ;
+  PROVIDE (__data_end_rom   = _etext + SIZEOF (.data)) ;
+  PROVIDE (__noinit_start_rom = _etext + SIZEOF (.data)) ;
+  PROVIDE (__noinit_end_rom = _etext + SIZEOF (.data) + SIZEOF (.noinit)) ;
+  PROVIDE (__subdevice_has_heap = 0) ;
+}
@@ -0,0 +1,78 @@
+/* Bootloader linker script for the MSP430F247, mspgcc (GNU ld)                                    */
+/*                                                                                                 */
+/* Links bootload.c on its own, without the C startup code (-nostartfiles), into the top 2k of     */
+/* flash.  The bootloader only uses locals, so there must be nothing to initialise in RAM; any     */
+/* libgcc helpers it pulls in are kept inside its own region so they survive an application erase. */
+/* Flash layout must match bootload.h, msp430x247_app.x and lnk_msp430f247.cmd                      */
+/*                                                                                                 */
+/*    0xF800 - 0xFFBF    Bootloader code and vector stubs                                          */
+/*    0xFFC0 - 0xFFFF    Hardware interrupt vectors, BSL signature at 0xFFDE left erased            */
+
+OUTPUT_FORMAT("elf32-msp430","elf32-msp430","elf32-msp430")
+ENTRY(boot_reset)
+
+MEMORY
+{
+  bootloader    (rx)    : ORIGIN = 0xF800, LENGTH = 0x07C0
+  bootvectors   (rw)    : ORIGIN = 0xFFC0, LENGTH = 0x0040
+  data          (rwx)   : ORIGIN = 0x1104, LENGTH = 0x0FFC
+}
+
+SECTIONS
+{
+  .bootloader :
+  {
+     PROVIDE (__boot_start = .) ;
+    *(.bootloader)
+    *(.bootloader.*)
+    . = ALIGN(2);
+    *(.text)
+    *(.text.*)
+    . = ALIGN(2);
+    *(.rodata)
+    *(.rodata.*)
+    . = ALIGN(2);
+     __boot_end = . ;
+  }  > bootloader
+
+  .bootvectors :
+  {
+    *(.bootvectors)
+  }  > bootvectors
+  ASSERT( SIZEOF(.bootvectors) == 0x40, "bootloader vector table must fill 0xFFC0 - 0xFFFF" )
+
+  /* Nothing runs the C startup code for the bootloader, so it can't have initialised or zeroed data */
+  .data :
+  {
+    *(.data)
+    *(.data.*)
+    *(.bss)
+    *(.bss.*)
+    *(COMMON)
+    *(.noinit)
+    *(.noinit.*)
+  }  > data
+  ASSERT( SIZEOF(.data) == 0, "bootloader must not use static or global variables" )
+
+  /* Nor has it any business with the application's vectors */
+  .vectors :
+  {
+    *(.vectors*)
+  }
+  ASSERT( SIZEOF(.vectors) == 0, "bootloader linked with the C startup code, use -nostartfiles" )
+
+  .stab 0 : { *(.stab) }
+  .stabstr 0 : { *(.stabstr) }
+  .comment 0 : { *(.comment) }
+  .debug          0 : { *(.debug) }
+  .line           0 : { *(.line) }
+  .debug_aranges  0 : { *(.debug_aranges) }
+  .debug_pubnames 0 : { *(.debug_pubnames) }
+  .debug_info     0 : { *(.debug_info) *(.gnu.linkonce.wi.*) }
+  .debug_abbrev   0 : { *(.debug_abbrev) }
+  .debug_line     0 : { *(.debug_line) }
+  .debug_frame    0 : { *(.debug_frame) }
+  .debug_str      0 : { *(.debug_str) }
+  .debug_loc      0 : { *(.debug_loc) }
+  .debug_macinfo  0 : { *(.debug_macinfo) }
+}
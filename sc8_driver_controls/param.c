@@ -0,0 +1,653 @@
+/*
+ * Tritium parameter store
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Keeps tuning parameters in INFO flash so they can be changed without a rebuild
+ * - Parameters are read from a RAM copy, loaded once at startup
+ * - Changes are appended to a circular log of records across INFO segments D, C & B, so each
+ *   segment is only erased once every PARAM_RECORDS writes
+ * - The segment ahead of the write position is always kept erased, so compaction can move current
+ *   records into it before their old segment is erased
+ * - Compaction drops records that hold a parameter's compiled-in default, as loading starts from
+ *   the defaults anyway
+ * - Each record carries a sequence number and a CRC, so a write interrupted by a power loss
+ *   is ignored and the previous value is used
+ * - Parameters can be read, written and committed over CAN (see param.h for the protocol)
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include <signal.h>
+#include "tri86.h"
+#include "can.h"
+#include "param.h"
+#include "pedal.h"
+#include "gauge.h"
+#include "power.h"
+#include "atomic.h"
+#include "supervisor.h"
+
+// Public variables
+group_32 param_value[PARAM_COUNT];
+unsigned long param_dirty;
+
+// Private variables
+unsigned char param_head;					// Next record slot to write
+unsigned char param_sequence;				// Sequence number for the next record
+can_variables param_request;				// Latest protocol request waiting for service
+unsigned char param_pending = FALSE;
+
+// Compiled-in defaults and limits by parameter index, the one copy the host tools load defaults from as well
+//	- Integer parameters are 16-bit values, held here as floats, which represent them exactly
+const param_info param_table[PARAM_COUNT] = {
+	{ PEDAL_TRAVEL_MIN_DEFAULT,	0,		ADC_MAX - 1 },	// PARAM_PEDAL_TRAVEL_MIN
+	{ PEDAL_TRAVEL_MAX_DEFAULT,	0,		ADC_MAX - 1 },	// PARAM_PEDAL_TRAVEL_MAX
+	{ REGEN_TRAVEL_MIN_DEFAULT,	0,		ADC_MAX - 1 },	// PARAM_REGEN_TRAVEL_MIN
+	{ REGEN_TRAVEL_MAX_DEFAULT,	0,		ADC_MAX - 1 },	// PARAM_REGEN_TRAVEL_MAX
+	{ REGEN_BRAKE_DEFAULT,		0.0,	REGEN_MAX },	// PARAM_REGEN_BRAKE
+	{ RPM_FWD_MAX_DEFAULT,		0,		20000 },		// PARAM_RPM_FWD_MAX
+	{ RPM_REV_MAX_DEFAULT,		-20000,	0 },			// PARAM_RPM_REV_MAX
+	{ ENGAGE_VEL_F_DEFAULT,		0,		1000 },			// PARAM_ENGAGE_VEL_F
+	{ ENGAGE_VEL_R_DEFAULT,		-1000,	0 },			// PARAM_ENGAGE_VEL_R
+	{ CHANGE_VEL_LTOH_DEFAULT,	0,		20000 },		// PARAM_CHANGE_VEL_LTOH
+	{ CHANGE_VEL_HTOL_DEFAULT,	0,		20000 },		// PARAM_CHANGE_VEL_HTOL
+	{ REGEN_THRESHOLD_DEFAULT,	-1000,	0 },			// PARAM_REGEN_THRESHOLD
+	{ GAUGE1_SCALE_DEFAULT,		0.001,	1000.0 },		// PARAM_GAUGE1_SCALE
+	{ GAUGE2_SCALE_DEFAULT,		0.001,	1000.0 },		// PARAM_GAUGE2_SCALE
+	{ DEVICE_ID_DEFAULT,		0,		65535 },		// PARAM_DEVICE_ID
+	{ REGEN_VOLT_MAX_DEFAULT,	0,		1000 },			// PARAM_REGEN_VOLT_MAX
+	{ POWER_VOLT_MIN_DEFAULT,	0,		1000 },			// PARAM_POWER_VOLT_MIN
+	{ POWER_CURRENT_MAX_DEFAULT,	1,		1000 },			// PARAM_POWER_CURRENT_MAX
+};
+
+// Private function prototypes
+char param_append( unsigned char index, group_32 value );
+char param_free( unsigned char first, unsigned char index, group_32 value );
+char param_write( unsigned char index, group_32 value );
+char param_copy( unsigned char first, unsigned char index, group_32 value );
+char param_needed( unsigned char slot );
+char param_check( unsigned char index, group_32 value );
+group_32 param_default( unsigned char index );
+unsigned char param_live( void );
+group_32 param_stored( unsigned char index );
+char param_valid( param_record *record );
+char param_blank( param_record *record );
+char param_newest( unsigned char slot );
+unsigned int param_crc( param_record *record );
+void param_flash_erase( unsigned char *ptr );
+void param_flash_write( unsigned char *ptr, unsigned char *data, unsigned char bytes );
+
+// Record slot address in INFO flash
+#define param_slot(n)		((param_record *)(PARAM_FLASH_START + ((n) * PARAM_RECORD_SIZE)))
+
+// param_free() result while the appended value is still to be written, never leaves this file
+#define PARAM_PENDING		1
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Loads parameters from INFO flash into RAM
+ *	- Starts from the compiled-in defaults
+ *	- Finds the newest valid record, then replays the log from oldest to newest so the
+ *	  latest record for each parameter wins
+ */
+void param_init( void )
+{
+	param_record *record;
+	unsigned char slot, newest, i;
+	unsigned char found = FALSE;
+
+	param_defaults();
+	param_dirty = 0x0000;
+
+	// Find the newest record
+	newest = 0;
+	param_sequence = 0;
+	for( slot = 0; slot < PARAM_RECORDS; slot++ ){
+		record = param_slot( slot );
+		if( param_valid( record )){
+			if(( found == FALSE ) || ((signed char)( record->sequence - param_sequence ) > 0 )){
+				newest = slot;
+				param_sequence = record->sequence;
+				found = TRUE;
+			}
+		}
+	}
+
+	if( found == FALSE ){
+		param_head = 0;
+		return;
+	}
+
+	// Replay the log, starting just after the newest record (the oldest end of the log)
+	slot = newest;
+	for( i = 0; i < PARAM_RECORDS; i++ ){
+		slot++;
+		if( slot == PARAM_RECORDS ) slot = 0;
+		record = param_slot( slot );
+		if( param_valid( record )) param_value[record->index] = record->value;
+	}
+
+	param_head = newest + 1;
+	if( param_head == PARAM_RECORDS ) param_head = 0;
+	param_sequence++;
+
+	// Records written before a limit was tightened, or travel limits a power loss split, may be out of range now
+	// Marked changed, so the next commit brings flash back in step and the log never holds more than PARAM_LIVE_MAX
+	for( i = 0; i < PARAM_COUNT; i++ ){
+		if( param_check( i, param_value[i] ) != PARAM_OK ){
+			param_value[i] = param_default( i );
+			param_dirty |= ( 1UL << i );
+		}
+	}
+}
+
+/*
+ * Updates a parameter in RAM
+ *	- Takes effect immediately, but is only kept over a reset after param_commit()
+ *	- Refuses values outside the limits in param_table, and travel limits that would meet or cross
+ *	- Refuses to take a parameter away from its default once PARAM_LIVE_MAX others are, the log has no room for more
+ */
+char param_set( unsigned char index, group_32 value )
+{
+	if( index >= PARAM_COUNT ) return( PARAM_ERROR_INDEX );
+	if( param_check( index, value ) != PARAM_OK ) return( PARAM_ERROR_RANGE );
+	if( param_value[index].data_u32 != value.data_u32 ){
+		if(( param_value[index].data_u32 == param_default( index ).data_u32 ) && ( param_live() >= PARAM_LIVE_MAX )) return( PARAM_ERROR_FULL );
+		param_value[index] = value;
+		param_dirty |= ( 1UL << index );
+	}
+	return( PARAM_OK );
+}
+
+/*
+ * Writes all changed parameters to INFO flash
+ *	- Interrupts are disabled while the flash controller is busy: up to ~13ms for a segment
+ *	  erase, and a commit after param_defaults() can run PARAM_COUNT of them back to back, so only commit
+ *	  parked, with supervision held (see param_service())
+ *	- Parameters going back to their defaults are written first, and values flash already holds aren't
+ *	  written again, so the log never has to hold more than PARAM_LIVE_MAX current records part way through
+ */
+char param_commit( void )
+{
+	unsigned char index, pass, away;
+	char result;
+
+	for( pass = 0; pass < 2; pass++ ){
+		for( index = 0; index < PARAM_COUNT; index++ ){
+			if( !( param_dirty & ( 1UL << index ))) continue;
+			away = ( param_value[index].data_u32 != param_default( index ).data_u32 ) ? 1 : 0;
+			if( away != pass ) continue;
+			if( param_value[index].data_u32 != param_stored( index ).data_u32 ){
+				result = param_append( index, param_value[index] );
+				if( result != PARAM_OK ) return( result );
+			}
+			param_dirty &= ~( 1UL << index );
+		}
+	}
+	return( PARAM_OK );
+}
+
+/*
+ * Restores compiled-in defaults in RAM
+ *	- Marks all parameters changed, so a following param_commit() makes it permanent
+ */
+void param_defaults( void )
+{
+	unsigned char index;
+
+	for( index = 0; index < PARAM_COUNT; index++ ) param_value[index] = param_default( index );
+	param_dirty = 0xFFFFFFFFUL >> ( 32 - PARAM_COUNT );
+}
+
+/*
+ * Accepts a protocol request from the CAN receive dispatch
+ *	- Only copies the frame, param_service() does the work later
+ *	- A newer request replaces one that has not been serviced yet
+ */
+void param_receive( void )
+{
+	param_request = can;
+	param_pending = TRUE;
+}
+
+/*
+ * Services a waiting protocol request and queues the reply
+ *	- Call from the main loop when nothing more urgent is waiting
+ *	- Commits are only allowed when parked, as interrupts and the drive command are held off during flash writes
+ *	- The caller decides from both the drive mode (N or off) and the measured speed (EVENT_SLOW), so a vehicle
+ *	  in gear, rolling in neutral, or with no speed reports from the motor controller, is refused
+ *	- The main loop stages can't check in during a commit, so supervision is held for its duration
+ */
+void param_service( unsigned char parked )
+{
+	unsigned char index;
+	group_32 value;
+
+	if( param_pending == FALSE ) return;
+	param_pending = FALSE;
+
+	index = param_request.data.data_u8[1];
+	can_push_ptr->address = DC_CAN_BASE + DC_PARAM_REPLY;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u8[0] = param_request.data.data_u8[0];
+	can_push_ptr->data.data_u8[1] = index;
+	can_push_ptr->data.data_u8[2] = PARAM_OK;
+	can_push_ptr->data.data_u8[3] = PARAM_TYPE_INT;
+	can_push_ptr->data.data_u32[1] = 0;
+
+	switch( param_request.data.data_u8[0] ){
+		case PARAM_CMD_INFO:
+			can_push_ptr->data.data_u8[4] = PARAM_COUNT;
+			can_push_ptr->data.data_u8[5] = PARAM_VERSION;
+			break;
+		case PARAM_CMD_WRITE:
+			value.data_u32 = param_request.data.data_u32[1];
+			can_push_ptr->data.data_u8[2] = param_set( index, value );
+			// Fall through to read back the value now in use
+		case PARAM_CMD_READ:
+			if( index >= PARAM_COUNT ){
+				can_push_ptr->data.data_u8[2] = PARAM_ERROR_INDEX;
+				break;
+			}
+			if( param_is_float( index )) can_push_ptr->data.data_u8[3] = PARAM_TYPE_FLOAT;
+			can_push_ptr->data.data_u32[1] = param_value[index].data_u32;
+			break;
+		case PARAM_CMD_COMMIT:
+			if( parked == FALSE ) can_push_ptr->data.data_u8[2] = PARAM_ERROR_BUSY;
+			else{
+				supervisor_hold();
+				can_push_ptr->data.data_u8[2] = param_commit();
+				supervisor_resume();
+			}
+			break;
+		case PARAM_CMD_DEFAULTS:
+			param_defaults();
+			break;
+		default:
+			can_push_ptr->data.data_u8[2] = PARAM_ERROR_COMMAND;
+			break;
+	}
+	can_push();
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Appends a record to the log
+ *	- Keeps the segment after the head erased, see param_free()
+ *	- Skips slots left part-written by a power loss
+ */
+char param_append( unsigned char index, group_32 value )
+{
+	unsigned char start, next;
+	unsigned char segments = 0;
+	char result;
+
+	while( TRUE ){
+		start = param_head;
+		result = PARAM_PENDING;
+		// Entering a segment: it should be the erased spare, clear out anything a power loss left in it
+		if(( param_head % PARAM_SEGMENT_RECORDS ) == 0 ){
+			if( segments == 2 * PARAM_SEGMENTS ) return( PARAM_ERROR_FLASH );
+			segments++;
+			result = param_free( param_head, index, value );
+		}
+		// Free the segment after this one, unless already erased (also finishes a compaction cut short by a power loss)
+		if( result == PARAM_PENDING ){
+			next = param_head - ( param_head % PARAM_SEGMENT_RECORDS ) + PARAM_SEGMENT_RECORDS;
+			if( next == PARAM_RECORDS ) next = 0;
+			result = param_free( next, index, value );
+		}
+		if( result != PARAM_PENDING ) return( result );
+		// Filled this segment with records moved forwards, carry on in the next one
+		if(( param_head != start ) && (( param_head % PARAM_SEGMENT_RECORDS ) == 0 )) continue;
+
+		if( param_blank( param_slot( param_head ))) return( param_write( index, value ));
+		param_head++;
+		if( param_head == PARAM_RECORDS ) param_head = 0;
+	}
+}
+
+/*
+ * Moves the records still current in a segment to the head, then erases the segment
+ *	- The records are re-appended before the erase, and the head is never in the segment being
+ *	  erased, so every current value is in flash at all times: this order is what makes compaction
+ *	  safe against a power loss, don't change it
+ *	- With the segment after the head always kept erased like this, the log has one spare segment
+ *	- The parameter being appended isn't copied, its new value is written once everything else has
+ *	  been, so a log holding nothing but current records still has room for the write
+ *	- Returns PARAM_OK once the new value has been written, PARAM_PENDING if it still has to be
+ */
+char param_free( unsigned char first, unsigned char index, group_32 value )
+{
+	param_record *record;
+	unsigned char slot;
+	unsigned char replace = FALSE;
+	unsigned char written = FALSE;
+	char result;
+
+	slot = first;
+	while( TRUE ){
+		if( slot < ( first + PARAM_SEGMENT_RECORDS )){
+			record = param_slot( slot );
+			slot++;
+			if( param_needed( slot - 1 ) == FALSE ) continue;
+			if( record->index == index ){
+				replace = TRUE;
+				continue;
+			}
+			result = param_copy( first, record->index, record->value );
+		}
+		else if(( replace == TRUE ) && ( written == FALSE )){
+			// Everything else is safe, now the new value
+			result = param_copy( first, index, value );
+			written = TRUE;
+		}
+		else break;
+
+		if( result == PARAM_PENDING ){
+			// Started over
+			replace = FALSE;
+			written = FALSE;
+			slot = first;
+		}
+		else if( result != PARAM_OK ) return( result );
+	}
+
+	for( slot = first; slot < ( first + PARAM_SEGMENT_RECORDS ); slot++ ){
+		if( param_blank( param_slot( slot )) == FALSE ){
+			param_flash_erase( (unsigned char *)param_slot( first ));
+			break;
+		}
+	}
+	if( written == TRUE ) return( PARAM_OK );
+	return( PARAM_PENDING );
+}
+
+/*
+ * Writes a record at the first blank slot from the head, outside the segment being freed
+ *	- With none left, a compaction of that segment was cut short by a power loss and left a
+ *	  part-written slot.  If the segment it was copying into holds nothing that isn't also in the
+ *	  one being freed, that is erased so the compaction can start over
+ *	- Returns PARAM_PENDING after starting over, without writing
+ */
+char param_copy( unsigned char first, unsigned char index, group_32 value )
+{
+	unsigned char slot, start;
+
+	while(( param_head != first ) && ( param_blank( param_slot( param_head )) == FALSE )){
+		param_head++;
+		if( param_head == PARAM_RECORDS ) param_head = 0;
+	}
+	if( param_head != first ) return( param_write( index, value ));
+
+	start = (( first == 0 ) ? PARAM_RECORDS : first ) - PARAM_SEGMENT_RECORDS;
+	for( slot = start; slot < ( start + PARAM_SEGMENT_RECORDS ); slot++ ){
+		if( param_needed( slot )) return( PARAM_ERROR_FLASH );
+	}
+	param_flash_erase( (unsigned char *)param_slot( start ));
+	param_head = start;
+	return( PARAM_PENDING );
+}
+
+/*
+ * Writes a record at the head
+ *	- Reads the record back to verify it
+ */
+char param_write( unsigned char index, group_32 value )
+{
+	param_record record;
+	param_record *written;
+
+	record.index = index;
+	record.sequence = param_sequence;
+	record.value = value;
+	record.crc = param_crc( &record );
+	written = param_slot( param_head );
+	param_flash_write( (unsigned char *)written, (unsigned char *)&record, PARAM_RECORD_SIZE );
+
+	param_sequence++;
+	param_head++;
+	if( param_head == PARAM_RECORDS ) param_head = 0;
+
+	// Verify
+	if(( written->crc != record.crc ) || ( param_valid( written ) == FALSE )) return( PARAM_ERROR_FLASH );
+	return( PARAM_OK );
+}
+
+/*
+ * Compiled-in default value of a parameter, from param_table
+ */
+group_32 param_default( unsigned char index )
+{
+	group_32 value;
+
+	value.data_32 = 0;
+	if( param_is_float( index )) value.data_fp = param_table[index].value;
+	else value.data_32 = (long)param_table[index].value;
+	return( value );
+}
+
+/*
+ * Number of parameters away from their defaults in RAM
+ */
+unsigned char param_live( void )
+{
+	unsigned char index, count;
+
+	count = 0;
+	for( index = 0; index < PARAM_COUNT; index++ ){
+		if( param_value[index].data_u32 != param_default( index ).data_u32 ) count++;
+	}
+	return( count );
+}
+
+/*
+ * Value of a parameter as flash holds it: its newest valid record, or the default if there is none
+ */
+group_32 param_stored( unsigned char index )
+{
+	param_record *record;
+	group_32 value;
+	unsigned char slot, i;
+
+	// Walk the log from its oldest end, so the last match is the newest
+	value = param_default( index );
+	slot = param_head;
+	for( i = 0; i < PARAM_RECORDS; i++ ){
+		record = param_slot( slot );
+		if(( record->index == index ) && param_valid( record )) value = record->value;
+		slot++;
+		if( slot == PARAM_RECORDS ) slot = 0;
+	}
+	return( value );
+}
+
+/*
+ * Checks a value against the parameter's limits
+ *	- The pedal and slider scaling divide by max - min, so each max has to stay above its min
+ */
+char param_check( unsigned char index, group_32 value )
+{
+	float number;
+
+	if( param_is_float( index )) number = value.data_fp;
+	else number = value.data_32;
+	// Written this way round so that a NaN fails as well
+	if( !(( number >= param_table[index].min ) && ( number <= param_table[index].max ))) return( PARAM_ERROR_RANGE );
+
+	switch( index ){
+		case PARAM_PEDAL_TRAVEL_MIN:
+			if( value.data_32 >= param_value[PARAM_PEDAL_TRAVEL_MAX].data_32 ) return( PARAM_ERROR_RANGE );
+			break;
+		case PARAM_PEDAL_TRAVEL_MAX:
+			if( value.data_32 <= param_value[PARAM_PEDAL_TRAVEL_MIN].data_32 ) return( PARAM_ERROR_RANGE );
+			break;
+		case PARAM_REGEN_TRAVEL_MIN:
+			if( value.data_32 >= param_value[PARAM_REGEN_TRAVEL_MAX].data_32 ) return( PARAM_ERROR_RANGE );
+			break;
+		case PARAM_REGEN_TRAVEL_MAX:
+			if( value.data_32 <= param_value[PARAM_REGEN_TRAVEL_MIN].data_32 ) return( PARAM_ERROR_RANGE );
+			break;
+	}
+	return( PARAM_OK );
+}
+
+/*
+ * Checks for a record with a valid index and CRC
+ */
+char param_valid( param_record *record )
+{
+	if( record->index >= PARAM_COUNT ) return( FALSE );
+	if( record->crc != param_crc( record )) return( FALSE );
+	return( TRUE );
+}
+
+/*
+ * Checks for an erased record slot
+ */
+char param_blank( param_record *record )
+{
+	unsigned int *ptr = (unsigned int *)record;
+	unsigned char i;
+
+	for( i = 0; i < ( PARAM_RECORD_SIZE / 2 ); i++ ){
+		if( *ptr++ != 0xFFFF ) return( FALSE );
+	}
+	return( TRUE );
+}
+
+/*
+ * Checks that no later record in the log holds the same parameter
+ */
+char param_newest( unsigned char slot )
+{
+	param_record *record;
+	unsigned char index, next;
+
+	index = param_slot( slot )->index;
+	next = slot + 1;
+	if( next == PARAM_RECORDS ) next = 0;
+	while( next != param_head ){
+		record = param_slot( next );
+		if(( record->index == index ) && param_valid( record )) return( FALSE );
+		next++;
+		if( next == PARAM_RECORDS ) next = 0;
+	}
+	return( TRUE );
+}
+
+/*
+ * Checks whether erasing a record's segment would change the value of its parameter
+ *	- Only matters for the newest record of a parameter, and then only if the newest one left
+ *	  outside the segment, or the default if there is none, holds a different value
+ *	- So records that just restate a default are dropped by compaction instead of being copied
+ */
+char param_needed( unsigned char slot )
+{
+	param_record *record, *other;
+	unsigned char first, next, i;
+	unsigned long value;
+
+	record = param_slot( slot );
+	if(( param_valid( record ) == FALSE ) || ( param_newest( slot ) == FALSE )) return( FALSE );
+
+	// Walk the log from its oldest end, so the last match is the newest
+	value = param_default( record->index ).data_u32;
+	first = slot - ( slot % PARAM_SEGMENT_RECORDS );
+	next = param_head;
+	for( i = 0; i < PARAM_RECORDS; i++ ){
+		if(( next < first ) || ( next >= ( first + PARAM_SEGMENT_RECORDS ))){
+			other = param_slot( next );
+			if(( other->index == record->index ) && param_valid( other )){
+				value = other->value.data_u32;
+			}
+		}
+		next++;
+		if( next == PARAM_RECORDS ) next = 0;
+	}
+	if( value == record->value.data_u32 ) return( FALSE );
+	return( TRUE );
+}
+
+/*
+ * CRC-16 (CCITT polynomial) over a record, excluding the CRC itself
+ *	- Seeded with PARAM_VERSION so a change of record layout invalidates old records
+ */
+unsigned int param_crc( param_record *record )
+{
+	unsigned char *ptr = (unsigned char *)record;
+	unsigned int crc = 0xFFFF ^ PARAM_VERSION;
+	unsigned char i, bit;
+
+	for( i = 0; i < ( PARAM_RECORD_SIZE - 2 ); i++ ){
+		crc ^= ((unsigned int)*ptr++ << 8);
+		for( bit = 0; bit < 8; bit++ ){
+			if( crc & 0x8000 ) crc = ( crc << 1 ) ^ 0x1021;
+			else crc = crc << 1;
+		}
+	}
+	return( crc );
+}
+
+/*
+ * Erases the flash segment containing ptr
+ *	- Writing FWKEY without LOCKA leaves segment A locked
+ */
+void param_flash_erase( unsigned char *ptr )
+{
+	unsigned int sr;
+
+	ATOMIC_BEGIN( sr );
+	FCTL2 = FWKEY | FSSEL_1 | PARAM_FLASH_DIVIDER;	// MCLK / 40
+	FCTL3 = FWKEY;									// Unlock
+	FCTL1 = FWKEY | ERASE;							// Segment erase
+	*ptr = 0;										// Dummy write starts the erase
+	while( FCTL3 & BUSY );
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY | LOCK;
+	ATOMIC_END( sr );
+}
+
+/*
+ * Writes bytes to erased flash
+ */
+void param_flash_write( unsigned char *ptr, unsigned char *data, unsigned char bytes )
+{
+	unsigned char i;
+	unsigned int sr;
+
+	ATOMIC_BEGIN( sr );
+	FCTL2 = FWKEY | FSSEL_1 | PARAM_FLASH_DIVIDER;	// MCLK / 40
+	FCTL3 = FWKEY;									// Unlock
+	FCTL1 = FWKEY | WRT;							// Byte / word write
+	for( i = 0; i < bytes; i++ ){
+		*ptr++ = *data++;
+		while( FCTL3 & BUSY );
+	}
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY | LOCK;
+	ATOMIC_END( sr );
+}
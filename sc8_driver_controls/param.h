@@ -0,0 +1,128 @@
+/*
+ * Tritium parameter store header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following parameter store functions:
+ *	- param_init
+ *	- param_set
+ *	- param_commit
+ *	- param_defaults
+ *	- param_receive
+ *	- param_service
+ *
+ */
+
+// Public function prototypes
+extern void param_init( void );
+extern char param_set( unsigned char index, group_32 value );
+extern char param_commit( void );
+extern void param_defaults( void );
+extern void param_receive( void );
+extern void param_service( unsigned char parked );
+
+// Public variables
+// RAM copy of all parameters, loaded once at startup
+// Tuning macros in pedal.h, gauge.h and tri86.h read straight from here
+extern group_32 param_value[];
+extern unsigned long param_dirty;
+
+// Parameter indices
+#define PARAM_PEDAL_TRAVEL_MIN		0			// ADC counts
+#define PARAM_PEDAL_TRAVEL_MAX		1			// ADC counts
+#define PARAM_REGEN_TRAVEL_MIN		2			// ADC counts
+#define PARAM_REGEN_TRAVEL_MAX		3			// ADC counts
+#define PARAM_REGEN_BRAKE			4			// Regen current when braking, %
+#define PARAM_RPM_FWD_MAX			5			// rpm
+#define PARAM_RPM_REV_MAX			6			// rpm
+#define PARAM_ENGAGE_VEL_F			7			// rpm
+#define PARAM_ENGAGE_VEL_R			8			// rpm
+#define PARAM_CHANGE_VEL_LTOH		9			// rpm
+#define PARAM_CHANGE_VEL_HTOL		10			// rpm
+#define PARAM_REGEN_THRESHOLD		11			// A
+#define PARAM_GAUGE1_SCALE			12			// Tacho pulse scaling
+#define PARAM_GAUGE2_SCALE			13			// Power gauge pulse scaling
+#define PARAM_DEVICE_ID				14			// Serial number
+#define PARAM_REGEN_VOLT_MAX		15			// Pack voltage at full charge, V
+#define PARAM_POWER_VOLT_MIN		16			// Pack voltage the bus current limit reaches its floor at, V
+#define PARAM_POWER_CURRENT_MAX		17			// Pack discharge current limit, A
+#define PARAM_COUNT					18
+
+// Parameters stored as floats, all others are 16-bit integers in the lower half of the value
+#define PARAM_FLOATS				((1UL << PARAM_REGEN_BRAKE) | (1UL << PARAM_GAUGE1_SCALE) | (1UL << PARAM_GAUGE2_SCALE))
+#define param_is_float(index)		((PARAM_FLOATS >> (index)) & 0x0001)
+
+// Return codes
+#define PARAM_OK					0
+#define PARAM_ERROR_INDEX			-1			// No such parameter
+#define PARAM_ERROR_FLASH			-2			// Flash write did not verify, or no space after compaction
+#define PARAM_ERROR_COMMAND			-3			// Unknown protocol command
+#define PARAM_ERROR_BUSY			-4			// Commit refused unless in neutral or off, and stopped (EVENT_SLOW)
+#define PARAM_ERROR_RANGE			-5			// Value outside the parameter's limits, or travel limits out of order
+#define PARAM_ERROR_FULL			-6			// PARAM_LIVE_MAX parameters are already away from their defaults
+
+// CAN protocol, requests on DC_CAN_BASE + DC_PARAM, replies on DC_CAN_BASE + DC_PARAM_REPLY
+//	Request: byte 0 = command, byte 1 = parameter index, bytes 4-7 = value (int32 or float)
+//	Reply:   byte 0 = command, byte 1 = parameter index, byte 2 = return code, byte 3 = type, bytes 4-7 = value
+//	Info reply carries PARAM_COUNT in byte 4 and PARAM_VERSION in byte 5, so a host can enumerate by index
+#define PARAM_CMD_INFO				0x00
+#define PARAM_CMD_READ				0x01
+#define PARAM_CMD_WRITE				0x02		// RAM only, takes effect immediately
+#define PARAM_CMD_COMMIT			0x03		// Write changed parameters to flash
+#define PARAM_CMD_DEFAULTS			0x04		// Restore defaults in RAM, commit to keep them
+
+#define PARAM_TYPE_INT				0
+#define PARAM_TYPE_FLOAT			1
+
+// Flash record layout version, part of the CRC seed so records from other layouts are ignored
+// 2: the log keeps a spare erased segment, which a version 1 log may not have room for
+#define PARAM_VERSION				2
+
+// INFO flash usage: segments D, C & B form one circular record log, one of them always kept erased as a spare
+// Records that restate a default are dropped, so the log holds PARAM_LIVE_MAX parameters away from their defaults:
+// param_set() refuses to take one more away, and with all of them away each write costs an erase
+// Segment A holds the factory DCO calibration constants and is never touched
+#define PARAM_FLASH_START			0x1000		// INFOD, see lnk_msp430f247.cmd
+#define PARAM_SEGMENT_SIZE			64			// Bytes
+#define PARAM_SEGMENTS				3
+#define PARAM_RECORD_SIZE			8			// Bytes
+#define PARAM_SEGMENT_RECORDS		(PARAM_SEGMENT_SIZE / PARAM_RECORD_SIZE)
+#define PARAM_RECORDS				(PARAM_SEGMENT_RECORDS * PARAM_SEGMENTS)
+#define PARAM_LIVE_MAX				(PARAM_RECORDS - PARAM_SEGMENT_RECORDS)
+
+// Flash timing generator: MCLK / 40 = 400 kHz, must be within 257 - 476 kHz
+#define PARAM_FLASH_DIVIDER			(40 - 1)
+
+// Compiled-in default and limits of a parameter, values outside the limits are refused by param_set()
+typedef struct _param_info {
+	float value;
+	float min;
+	float max;
+} param_info;
+
+// Record stored in flash
+typedef struct _param_record {
+	unsigned char index;						// Parameter index, 0xFF = erased
+	unsigned char sequence;						// Write counter, identifies the newest record
+	group_32 value;
+	unsigned int crc;							// CRC-16 over index, sequence and value
+} param_record;
+
+#if PARAM_COUNT > 32
+#error "param_dirty only tracks 32 parameters"
+#endif
@@ -22,6 +22,8 @@
  * - Inputs:
  *		Pedal A & B (redundant dual outputs from hall sensor pedals)
  *		Regen slider C
+ *		Brake switch regen request
+ *		Battery voltage and current (from the motor controller)
  *		Vehicle velocity (motor rpm at present, don't know km/h)
  *		Selected operating mode (neutral, drive, etc)
  * - Outputs:
@@ -34,18 +36,26 @@
 // Include files
 #include <msp430x24x.h>
 #include "tri86.h"
+#include "param.h"
 #include "pedal.h"
+#include "vehicle.h"
 
 // Public variables
 command_variables	command;
 
+// Private variables
+float regen_level = 0.0;				// Ramped regen current, %
+
+// Private function prototypes
+float pedal_regen( unsigned int analog_c, unsigned char apply );
+
 /**************************************************************************************************
  * PUBLIC FUNCTIONS
  *************************************************************************************************/
 
 /*
  * Process analog pedal inputs
- * Basic stuff only at this point: map channel A to 0-100% current, no regen or redundancy
+ * Basic stuff only at this point: map channel A to 0-100% current, regen from the slider, no redundancy
  *
  */
 void process_pedal( unsigned int analog_a, unsigned int analog_b, unsigned int analog_c, unsigned char request_regen )
@@ -80,36 +90,34 @@ void process_pedal( unsigned int analog_a, unsigned int analog_b, unsigned int a
 		// Check limits and clip upper travel region
 		if(pedal > CURRENT_MAX) pedal = CURRENT_MAX;
 		
-		// // Scale regen input to a 0.0 to REGEN_MAX range
-		// // Clip lower travel region of regen input
-		// if(analog_c > REGEN_TRAVEL_MIN) regen = (analog_c - REGEN_TRAVEL_MIN);
-		// else regen = 0.0;
-		// // Scale regen input
-		// regen = regen * REGEN_MAX / REGEN_TRAVEL;
-		// // Check limits and clip upper travel region
-		// if(regen > REGEN_MAX) regen = REGEN_MAX;
-		regen = 0.15;
 		// Choose target motor velocity
+		// Regen only ramps in the states that use it, on the brake in R and with the pedal released in B,
+		// and starts again from zero after any other state
 		switch(command.state){
 			case MODE_R:
-				if( request_regen == FALSE ){
+				regen = pedal_regen( analog_c, request_regen );
+				if(( request_regen == FALSE ) && (( pedal > 0.0 ) || ( regen == 0.0 ))){
 					command.current = pedal;
 					command.rpm = RPM_REV_MAX;
 				}
 				else{
+					// Braking, or letting regen fade out after the brake is released
 					command.current = regen;
 					command.rpm = 0.0;
 				}
 				break;
 			case MODE_DL:
 			case MODE_DH:
+				regen_level = 0.0;
 				command.current = pedal;
 				command.rpm = RPM_FWD_MAX;
 				break;
 			case MODE_BL:
 			case MODE_BH:
+				regen = pedal_regen( analog_c, ( request_regen != FALSE ) || ( pedal == 0.0 ));
 				if( pedal > 0.0 ){
-					command.current = regen;
+					// Pedal sets speed, the regen ramp and derating only apply once it's released
+					command.current = B_DRIVE_CURRENT;
 					command.rpm = pedal*RPM_FWD_MAX;
 				} 
 				else{
@@ -123,6 +131,7 @@ void process_pedal( unsigned int analog_a, unsigned int analog_b, unsigned int a
 			case MODE_ON:
 			case MODE_OFF:
 			default:
+				regen_level = 0.0;
 				command.current = 0.0;
 				command.rpm = 0.0;
 				break;
@@ -132,5 +141,49 @@ void process_pedal( unsigned int analog_a, unsigned int analog_b, unsigned int a
 	else{
 		command.current = 0.0;
 		command.rpm = 0.0;
+		regen_level = 0.0;
+	}
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Regen current for this ADC event
+ *	- Blends the slider position into the brake regen level, then ramps towards it at REGEN_RAMP
+ *	- Derates near full pack voltage and above REGEN_CHARGE_MAX charge current, and falls back to the
+ *	  fixed brake level while the bus readings are stale
+ *	- Only called in R and B, every other state clears regen_level so the next ramp starts from zero
+ */
+float pedal_regen( unsigned int analog_c, unsigned char apply )
+{
+	float slider, target, limit;
+
+	if( apply == FALSE ) target = 0.0;
+	else{
+		// Scale regen slider to 0.0 to 1.0, clipping both ends of its travel
+		if( analog_c > REGEN_TRAVEL_MIN ) slider = (float)( analog_c - REGEN_TRAVEL_MIN ) / REGEN_TRAVEL;
+		else slider = 0.0;
+		if( slider > 1.0 ) slider = 1.0;
+		target = REGEN_BRAKE + slider * ( REGEN_MAX - REGEN_BRAKE );
+
+		if( vehicle_age( VEHICLE_BUS ) == VEHICLE_AGE_UNKNOWN ){
+			if( target > REGEN_BRAKE ) target = REGEN_BRAKE;
+		}
+		else{
+			// Fade out over the top REGEN_VOLT_BAND of pack voltage
+			limit = ( REGEN_VOLT_MAX - battery_voltage ) / REGEN_VOLT_BAND;
+			if( limit < 0.0 ) limit = 0.0;
+			if( limit < 1.0 ) target = target * limit;
+			// Scale back in proportion to any charge current over the limit (bus current is negative when charging)
+			if( -battery_current > REGEN_CHARGE_MAX ) target = target * REGEN_CHARGE_MAX / -battery_current;
+		}
 	}
+
+	// Ramp towards the target
+	if( regen_level < target - REGEN_RAMP ) regen_level += REGEN_RAMP;
+	else if( regen_level > target + REGEN_RAMP ) regen_level -= REGEN_RAMP;
+	else regen_level = target;
+	return( regen_level );
 }
@@ -47,8 +47,9 @@ extern command_variables command;
 // Command parameter limits
 #define CURRENT_MAX				1.0					// %, absolute value
 #define REGEN_MAX				1.0					// %, absolute value
-#define RPM_FWD_MAX				4000				// Forwards max speed, rpm
-#define RPM_REV_MAX				-1500				// Reverse max speed, rpm
+#define RPM_FWD_MAX_DEFAULT		4000				// Forwards max speed, rpm
+#define RPM_REV_MAX_DEFAULT		-1500				// Reverse max speed, rpm
+#define REGEN_BRAKE_DEFAULT		0.15				// Regen current on brake switch, slider at minimum, %
 
 // Analog pedal input scaling
 // Single input channel only (no redundancy)
@@ -58,11 +59,11 @@ extern command_variables command;
 
 #define ADC_MAX					4096
 #ifdef HALL_PEDAL
-	#define PEDAL_TRAVEL_MIN	245					// Hall pedal type sensor 0.3 - 3.9V travel
-	#define PEDAL_TRAVEL_MAX	3195
+	#define PEDAL_TRAVEL_MIN_DEFAULT	245			// Hall pedal type sensor 0.3 - 3.9V travel
+	#define PEDAL_TRAVEL_MAX_DEFAULT	3195
 #else
-	#define PEDAL_TRAVEL_MIN	200
-	#define PEDAL_TRAVEL_MAX	(ADC_MAX - 200)
+	#define PEDAL_TRAVEL_MIN_DEFAULT	200
+	#define PEDAL_TRAVEL_MAX_DEFAULT	(ADC_MAX - 200)
 #endif
 
 #define PEDAL_TRAVEL			(PEDAL_TRAVEL_MAX - PEDAL_TRAVEL_MIN)
@@ -72,8 +73,28 @@ extern command_variables command;
 
 // Analog input for linear slider type pot for regenerative strenght control
 // Channel C = 0.00 to 5.00 Volts = 0 to 4096 counts
-#define REGEN_TRAVEL_MIN		200
-#define REGEN_TRAVEL_MAX		(ADC_MAX - 200)
+#define REGEN_TRAVEL_MIN_DEFAULT	200
+#define REGEN_TRAVEL_MAX_DEFAULT	(ADC_MAX - 200)
 #define REGEN_TRAVEL			(REGEN_TRAVEL_MAX - REGEN_TRAVEL_MIN)
 #define REGEN_ERROR_MIN			0
 #define REGEN_ERROR_MAX			(ADC_MAX - 0)
+
+// Regen controller
+// Slider sets regen strength from REGEN_BRAKE (bottom of travel) to REGEN_MAX (top)
+// Applied on the brake switch in R, and in B (one pedal driving) whenever the pedal is released
+// Ramped in and out, then derated from the latest MC_BUS readings to protect a full pack
+#define REGEN_RAMP				0.02				// Max change per ADC event (10ms), %: 0 to full in 0.5s
+#define REGEN_VOLT_MAX_DEFAULT	160					// Pack voltage at full charge, V: no regen at or above this
+#define REGEN_VOLT_BAND			5.0					// Regen fades out over this far below REGEN_VOLT_MAX, V
+#define REGEN_CHARGE_MAX		50.0				// Battery charge current limit while regenerating, A
+#define B_DRIVE_CURRENT			REGEN_BRAKE			// Motor current limit while the pedal sets speed in B, %: fixed, not derated
+
+// Tunable values, read from the parameter store RAM copy (see param.h), defaults above
+#define PEDAL_TRAVEL_MIN		(param_value[PARAM_PEDAL_TRAVEL_MIN].data_16[0])
+#define PEDAL_TRAVEL_MAX		(param_value[PARAM_PEDAL_TRAVEL_MAX].data_16[0])
+#define REGEN_TRAVEL_MIN		(param_value[PARAM_REGEN_TRAVEL_MIN].data_16[0])
+#define REGEN_TRAVEL_MAX		(param_value[PARAM_REGEN_TRAVEL_MAX].data_16[0])
+#define REGEN_BRAKE				(param_value[PARAM_REGEN_BRAKE].data_fp)
+#define REGEN_VOLT_MAX			(param_value[PARAM_REGEN_VOLT_MAX].data_16[0])
+#define RPM_FWD_MAX				(param_value[PARAM_RPM_FWD_MAX].data_16[0])
+#define RPM_REV_MAX				(param_value[PARAM_RPM_REV_MAX].data_16[0])
@@ -0,0 +1,132 @@
+/*
+ * Tritium bus current limit
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Works out the bus current limit sent to the motor controller in DC_POWER, from the latest pack and
+ *   temperature readings, instead of a fixed 100%
+ * - Each reading gives its own limit, the lowest one wins, and readings gone stale are left out
+ * - Smoothed, with hysteresis on the sent value, and a tightened limit is sent straight away rather than
+ *   at the next comms event
+ * - Settles back to exactly 100% once nothing is limiting
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "param.h"
+#include "pedal.h"
+#include "vehicle.h"
+#include "drive.h"
+#include "power.h"
+
+// Private variables
+float power_smooth;								// Filtered limit
+
+// Private function prototypes
+float power_derate( float value, float start, float end );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Start at full power
+ */
+void power_init( void )
+{
+	power_smooth = 1.0;
+	command.bus_current = 1.0;
+}
+
+/*
+ * Update the bus current limit
+ *	- Call every tick
+ */
+void power_tick( void )
+{
+	float limit, temp;
+
+	limit = 1.0;
+	if( vehicle_age( VEHICLE_BUS ) != VEHICLE_AGE_UNKNOWN ){
+		temp = power_derate( battery_voltage, POWER_VOLT_MIN + POWER_VOLT_BAND, POWER_VOLT_MIN );
+		if( temp < limit ) limit = temp;
+		if( battery_current > POWER_CURRENT_MAX ){
+			temp = command.bus_current * POWER_CURRENT_MAX / battery_current;
+			if( temp < limit ) limit = temp;
+		}
+	}
+	if( vehicle_age( VEHICLE_TEMP1 ) != VEHICLE_AGE_UNKNOWN ){
+		temp = power_derate( motor_temp, POWER_MOTOR_TEMP_START, POWER_MOTOR_TEMP_MAX );
+		if( temp < limit ) limit = temp;
+		temp = power_derate( controller_temp, POWER_CTRL_TEMP_START, POWER_CTRL_TEMP_MAX );
+		if( temp < limit ) limit = temp;
+	}
+	if( limit < POWER_FLOOR ) limit = POWER_FLOOR;
+
+	// Smooth
+	if( limit < power_smooth ) power_smooth += ( limit - power_smooth ) * POWER_FILTER_DOWN;
+	else power_smooth += ( limit - power_smooth ) * POWER_FILTER_UP;
+
+	// Only move the sent limit on a real change, and send a cut straight away
+	if( power_smooth < command.bus_current - POWER_HYSTERESIS ){
+		command.bus_current = power_smooth;
+		if( events & EVENT_CONNECTED ) power_send();
+	}
+	else if(( power_smooth > command.bus_current + POWER_HYSTERESIS ) || (( power_smooth >= 1.0 - POWER_HYSTERESIS ) && ( command.bus_current < 1.0 ))){
+		if( power_smooth >= 1.0 - POWER_HYSTERESIS ) command.bus_current = 1.0;
+		else command.bus_current = power_smooth;
+	}
+}
+
+/*
+ * Queue a bus command frame to each motor controller
+ *	- Scaled by the same shares as the drive current, each controller's own bus limit is its part of the pack (see tri86.h)
+ */
+void power_send( void )
+{
+	unsigned char mc;
+
+	for( mc = 0; mc < MC_COUNT; mc++ ){
+		can_push_ptr->address = drive_base[mc] + DC_POWER;
+		can_push_ptr->status = 8;
+		can_push_ptr->data.data_fp[1] = command.bus_current * drive_split[mc];
+		can_push_ptr->data.data_fp[0] = 0.0;
+		can_push();
+	}
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Linear derating
+ *	- 1.0 at start, falling to POWER_FLOOR at end, works in either direction
+ */
+float power_derate( float value, float start, float end )
+{
+	float fraction;
+
+	fraction = ( value - start ) / ( end - start );
+	if( fraction <= 0.0 ) return( 1.0 );
+	if( fraction >= 1.0 ) return( POWER_FLOOR );
+	return( 1.0 - fraction * ( 1.0 - POWER_FLOOR ));
+}
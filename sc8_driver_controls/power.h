@@ -0,0 +1,54 @@
+/*
+ * Tritium bus current limit header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following bus current limit functions
+ *	- power_init
+ *	- power_tick
+ *	- power_send
+ *
+ */
+
+// Public function prototypes
+extern void power_init( void );
+extern void power_tick( void );
+extern void power_send( void );
+
+// Pack voltage: limit falls from full (1.0) at POWER_VOLT_MIN + POWER_VOLT_BAND to POWER_FLOOR at POWER_VOLT_MIN
+#define POWER_VOLT_MIN_DEFAULT	100				// V
+#define POWER_VOLT_BAND			10.0			// V
+// Pack discharge current: limit scales back in proportion to any current over POWER_CURRENT_MAX
+#define POWER_CURRENT_MAX_DEFAULT	60			// A
+// Temperatures: limit falls from full (1.0) at the start temperature to POWER_FLOOR at the max
+#define POWER_MOTOR_TEMP_START	100.0			// C
+#define POWER_MOTOR_TEMP_MAX	130.0			// C
+#define POWER_CTRL_TEMP_START	70.0			// C
+#define POWER_CTRL_TEMP_MAX		90.0			// C
+// Lowest limit we'll ever send, enough to limp off the road
+#define POWER_FLOOR				0.1				// Fraction of full bus current
+
+// Smoothing, fraction of the difference taken per tick: pull in quickly, release slowly
+#define POWER_FILTER_DOWN		0.25
+#define POWER_FILTER_UP			0.02
+// Hysteresis: the sent limit only moves when the smoothed limit is this far from it, or to return to full (1.0)
+#define POWER_HYSTERESIS		0.02			// Fraction of full bus current
+
+// Tunable values, read from the parameter store RAM copy (see param.h), defaults above
+#define POWER_VOLT_MIN			(param_value[PARAM_POWER_VOLT_MIN].data_16[0])
+#define POWER_CURRENT_MAX		(param_value[PARAM_POWER_CURRENT_MAX].data_16[0])
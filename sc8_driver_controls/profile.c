@@ -0,0 +1,126 @@
+/*
+ * Tritium hot path profiler
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Times the main loop hot paths on the target, against per-path cycle budgets
+ * - Enabled with USE_PROFILE in tri86.h, the measurement points compile away otherwise
+ * - Results are read, and cleared, over CAN with tools/dcprof
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "profile.h"
+
+// Private variables
+unsigned int profile_mark[PROFILE_SLOTS];
+unsigned int profile_min[PROFILE_SLOTS];
+unsigned int profile_max[PROFILE_SLOTS];
+unsigned char profile_over[PROFILE_SLOTS];
+unsigned char profile_request = 0xFF;
+const unsigned int profile_budget[PROFILE_SLOTS] = {
+	PROFILE_PEDAL_BUDGET, PROFILE_STATE_BUDGET, PROFILE_CAN_RX_BUDGET, PROFILE_GAUGE_BUDGET
+};
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Clears all measurements
+ */
+void profile_init( void )
+{
+	unsigned char i;
+
+	for( i = 0; i < PROFILE_SLOTS; i++ ){
+		profile_min[i] = 0xFFFF;
+		profile_max[i] = 0;
+		profile_over[i] = 0;
+	}
+}
+
+/*
+ * Marks the start of a hot path
+ */
+void profile_start( unsigned char slot )
+{
+	profile_mark[slot] = TAR;
+}
+
+/*
+ * Marks the end of a hot path, and updates its statistics
+ *	- Handles one wrap of Timer A at the tick, runs are much shorter than a tick
+ */
+void profile_stop( unsigned char slot )
+{
+	unsigned int now, count;
+	unsigned long cycles;
+
+	now = TAR;
+	count = now - profile_mark[slot];
+	if( now < profile_mark[slot] ) count += TACCR0 + 1;
+	cycles = (unsigned long)count * PROFILE_CYCLES_PER_COUNT;
+	if( cycles > 0xFFFF ) cycles = 0xFFFF;
+
+	if( cycles < profile_min[slot] ) profile_min[slot] = cycles;
+	if( cycles > profile_max[slot] ) profile_max[slot] = cycles;
+	if(( cycles > profile_budget[slot] ) && ( profile_over[slot] != 0xFF )) profile_over[slot]++;
+}
+
+/*
+ * Accepts a profiler request from the CAN receive dispatch
+ *	- Ignores our own replies
+ */
+void profile_receive( void )
+{
+	if( can.data.data_u8[0] & PROFILE_REPLY ) return;
+	profile_request = can.data.data_u8[0];
+}
+
+/*
+ * Handles profiler requests
+ *	- Call from the main loop when nothing more urgent is waiting
+ */
+void profile_service( void )
+{
+	unsigned char i;
+
+	switch( profile_request ){
+		case PROFILE_CMD_REPORT:
+			if( can_queue_free() <= PROFILE_SLOTS ) return;	// Try again next time round
+			for( i = 0; i < PROFILE_SLOTS; i++ ){
+				can_push_ptr->address = DC_CAN_BASE + DC_PROFILE;
+				can_push_ptr->status = 8;
+				can_push_ptr->data.data_u8[0] = PROFILE_REPLY | i;
+				can_push_ptr->data.data_u8[1] = profile_over[i];
+				can_push_ptr->data.data_u16[1] = ( profile_min[i] == 0xFFFF ) ? 0 : profile_min[i];
+				can_push_ptr->data.data_u16[2] = profile_max[i];
+				can_push_ptr->data.data_u16[3] = profile_budget[i];
+				can_push();
+			}
+			break;
+		case PROFILE_CMD_RESET:
+			profile_init();
+			break;
+	}
+	profile_request = 0xFF;
+}
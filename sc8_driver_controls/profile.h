@@ -0,0 +1,70 @@
+/*
+ * Tritium hot path profiler header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following profiler functions:
+ *	- profile_init
+ *	- profile_start
+ *	- profile_stop
+ *	- profile_receive
+ *	- profile_service
+ *
+ */
+
+// Public function prototypes
+extern void profile_init( void );
+extern void profile_start( unsigned char slot );
+extern void profile_stop( unsigned char slot );
+extern void profile_receive( void );
+extern void profile_service( void );
+
+// Measurement points compile away unless USE_PROFILE is set in tri86.h
+#ifdef USE_PROFILE
+#define PROFILE_START(slot)		profile_start(slot)
+#define PROFILE_STOP(slot)		profile_stop(slot)
+#else
+#define PROFILE_START(slot)
+#define PROFILE_STOP(slot)
+#endif
+
+// Profiled hot paths
+#define PROFILE_PEDAL			0				// process_pedal()
+#define PROFILE_STATE			1				// Drive state machine and output control
+#define PROFILE_CAN_RX			2				// can_receive() and the receive dispatch
+#define PROFILE_GAUGE			3				// gauge_tach_update()
+#define PROFILE_SLOTS			4
+
+// Budgets, MCLK cycles
+#define PROFILE_PEDAL_BUDGET	8000
+#define PROFILE_STATE_BUDGET	1500
+#define PROFILE_CAN_RX_BUDGET	2500
+#define PROFILE_GAUGE_BUDGET	3000
+
+// Timer A runs at MCLK / 8, so times are to the nearest 8 cycles
+#define PROFILE_CYCLES_PER_COUNT	8
+
+// CAN protocol, requests and replies on DC_CAN_BASE + DC_PROFILE
+//	Request: byte 0 = command
+//	Reply, one per slot: byte 0 = slot, byte 1 = runs over budget (saturates at 255),
+//		bytes 2-3 = minimum cycles, bytes 4-5 = maximum cycles, bytes 6-7 = budget
+//	The minimum is the uninterrupted cost, the maximum includes any interrupts taken during the run
+//	Budgets are checked against the maximum, by the over count here and by tools/dcprof and tools/dcbench
+#define PROFILE_CMD_REPORT		0x00
+#define PROFILE_CMD_RESET		0x01
+#define PROFILE_REPLY			0x80			// Set in byte 0 of replies, so they can't be mistaken for requests
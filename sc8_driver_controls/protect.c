@@ -0,0 +1,183 @@
+/*
+ * Tritium output protection
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Fast protection for the switched 12V outputs and the 5V pedal supply
+ * - Each sense channel is checked in the ADC ISR as soon as its conversion completes, tripping the output
+ *   within one conversion sequence instead of waiting for the main loop
+ * - Tripped outputs are retried with an exponential back-off from the main loop
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include <signal.h>
+#include "tri86.h"
+#include "can.h"
+#include "stack.h"
+#include "atomic.h"
+#include "protect.h"
+
+// Public variables
+volatile unsigned int protect_faults;
+
+// Private variables
+protect_channel protect_state[PROTECT_CHANNELS];
+
+// Private function prototypes
+void protect_setup( unsigned char channel, volatile unsigned char *port, unsigned char pin, unsigned int fault, unsigned int low, unsigned int high );
+void protect_trip( protect_channel *ch );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Initialise channel thresholds and clear all faults
+ *	- Call before the ADC starts converting
+ */
+void protect_init( void )
+{
+	protect_setup( PROTECT_SUPPLY, &P6OUT, ANLG_V_ENABLE, SW_ACCEL_FAULT, PROTECT_SUPPLY_LOW, PROTECT_SUPPLY_HIGH );
+	protect_setup( PROTECT_BRAKE, &P1OUT, BRAKE_OUT, SW_BRAKE_FAULT, 0, PROTECT_BRAKE_HIGH );
+	protect_setup( PROTECT_REVERSE, &P1OUT, REVERSE_OUT, SW_REV_FAULT, 0, PROTECT_REVERSE_HIGH );
+	protect_setup( PROTECT_CAN_PWR, &P1OUT, CAN_PWR_OUT, SW_CAN_FAULT, 0, PROTECT_CAN_PWR_HIGH );
+	protect_faults = 0x0000;
+}
+
+/*
+ * Check one sense reading against its window
+ *	- Called from the ADC ISR with the conversion result for the channel
+ *	- The first reading after an output turns on is skipped, to ride through inrush and supply rise time
+ */
+void protect_sample( unsigned char channel, unsigned int value )
+{
+	protect_channel *ch;
+
+	STACK_PROBE(STACK_ADC);
+	ch = &protect_state[channel];
+	if( ch->tripped == TRUE ) return;
+	if( !(*ch->port & ch->pin) ){
+		ch->settled = FALSE;
+		return;
+	}
+	if( ch->settled == FALSE ){
+		ch->settled = TRUE;
+		return;
+	}
+	if(( value >= ch->high ) || ( value < ch->low )) protect_trip( ch );
+}
+
+/*
+ * Request an output on or off
+ *	- Replaces direct port writes in the main loop, so a tripped output stays off until its retry
+ */
+void protect_output( unsigned char channel, unsigned char on )
+{
+	protect_channel *ch;
+	unsigned int sr;
+
+	ch = &protect_state[channel];
+	ch->request = on;
+	ATOMIC_BEGIN( sr );
+	if( on == FALSE ){
+		*ch->port &= ~ch->pin;
+	}
+	else if(( ch->tripped == FALSE ) && !(*ch->port & ch->pin)){
+		ch->settled = FALSE;
+		*ch->port |= ch->pin;
+	}
+	ATOMIC_END( sr );
+}
+
+/*
+ * Service retry back-off
+ *	- Call once per ADC event from the main loop
+ *	- A tripped channel is re-enabled after its back-off delay, which doubles on every trip
+ *	- The fault bit clears once the output has then run cleanly for PROTECT_RETRY_CLEAR
+ */
+void protect_tick( void )
+{
+	protect_channel *ch;
+	unsigned char i;
+	unsigned int sr;
+
+	for( i = 0; i < PROTECT_CHANNELS; i++ ){
+		ch = &protect_state[i];
+		ATOMIC_BEGIN( sr );
+		if( ch->tripped == TRUE ){
+			if( ch->timer != 0 ) ch->timer--;
+			else{
+				ch->tripped = FALSE;
+				ch->timer = PROTECT_RETRY_CLEAR;
+				if( ch->retry_delay < PROTECT_RETRY_MAX ) ch->retry_delay <<= 1;
+				if( ch->request == TRUE ){
+					ch->settled = FALSE;
+					*ch->port |= ch->pin;
+				}
+			}
+		}
+		else if(( protect_faults & ch->fault ) && ( *ch->port & ch->pin )){
+			if( ch->timer != 0 ) ch->timer--;
+			else{
+				protect_faults &= ~ch->fault;
+				ch->retry_delay = PROTECT_RETRY_MIN;
+			}
+		}
+		ATOMIC_END( sr );
+	}
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Fill out one channel
+ */
+void protect_setup( unsigned char channel, volatile unsigned char *port, unsigned char pin, unsigned int fault, unsigned int low, unsigned int high )
+{
+	protect_channel *ch;
+
+	ch = &protect_state[channel];
+	ch->port = port;
+	ch->pin = pin;
+	ch->fault = fault;
+	ch->low = low;
+	ch->high = high;
+	ch->request = FALSE;
+	ch->settled = FALSE;
+	ch->tripped = FALSE;
+	ch->retry_delay = PROTECT_RETRY_MIN;
+	ch->timer = 0;
+}
+
+/*
+ * Turn a channel off and start its back-off
+ *	- Runs in interrupt context
+ */
+void protect_trip( protect_channel *ch )
+{
+	STACK_PROBE(STACK_ADC);
+	*ch->port &= ~ch->pin;
+	ch->tripped = TRUE;
+	ch->settled = FALSE;
+	ch->timer = ch->retry_delay;
+	protect_faults |= ch->fault;
+}
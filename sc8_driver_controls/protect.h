@@ -0,0 +1,72 @@
+/*
+ * Tritium output protection header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following output protection functions:
+ *	- protect_init
+ *	- protect_sample
+ *	- protect_output
+ *	- protect_tick
+ *
+ */
+
+// Public function prototypes
+extern void protect_init( void );
+extern void protect_sample( unsigned char channel, unsigned int value );
+extern void protect_output( unsigned char channel, unsigned char on );
+extern void protect_tick( void );
+
+// Public variables
+// Fault bits in DC_SWITCH layout, set while a channel is tripped or retrying
+extern volatile unsigned int protect_faults;
+
+// Channels, in ADC sequence order from ADC12MEM3
+#define PROTECT_SUPPLY				0			// 5V pedal supply (ANLG_SENSE_V), switched by ANLG_V_ENABLE
+#define PROTECT_BRAKE				1			// Brake light current (ANLG_BRAKE_I), switched by BRAKE_OUT
+#define PROTECT_REVERSE				2			// Reverse light current (ANLG_REVERSE_I), switched by REVERSE_OUT
+#define PROTECT_CAN_PWR				3			// CAN bus power current (ANLG_CAN_PWR_I), switched by CAN_PWR_OUT
+#define PROTECT_CHANNELS			4
+
+// Threshold windows, ADC counts against the 2.5V internal reference
+// Scaling follows the sense dividers and shunt amplifiers on PHLN-3000-0033E, recheck if the board changes
+#define PROTECT_SUPPLY_LOW			2460		// 4.5V through the 1/3 sense divider
+#define PROTECT_SUPPLY_HIGH			3000		// 5.5V
+#define PROTECT_BRAKE_HIGH			2800		// Brake lights, ~3.5A
+#define PROTECT_REVERSE_HIGH		2000		// Reversing lights, ~2.5A
+#define PROTECT_CAN_PWR_HIGH		1600		// CAN bus power, ~2A
+
+// Retry back-off, in ADC events (10ms)
+// The delay doubles on every trip up to the maximum, and resets once a channel has run cleanly for PROTECT_RETRY_CLEAR
+#define PROTECT_RETRY_MIN			10			// 100ms
+#define PROTECT_RETRY_MAX			1280		// 12.8s
+#define PROTECT_RETRY_CLEAR			200			// 2s
+
+// Channel state
+typedef struct _protect_channel {
+	volatile unsigned char *port;				// Output register for the switched supply
+	unsigned char pin;
+	unsigned int fault;							// DC_SWITCH fault bit
+	unsigned int low;							// Trip below this when on and settled, 0 = no lower limit
+	unsigned int high;							// Trip at or above this at any time
+	unsigned char request;						// Main loop wants the output on
+	unsigned char settled;						// Output has been on for a full conversion
+	unsigned char tripped;
+	unsigned int retry_delay;					// Current back-off, doubles on each trip
+	unsigned int timer;							// Ticks until retry, or ticks of clean running
+} protect_channel;
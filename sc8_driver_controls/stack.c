@@ -0,0 +1,104 @@
+/*
+ * Tritium stack and RAM usage
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Fills the free RAM between the static sections and the stack with a known pattern at startup
+ * - Scans for the lowest word that no longer holds the pattern to find the stack high water mark,
+ *   which covers the main loop, soft float calls and any ISR that interrupted them at the time
+ * - Records the stack pointer at each ISR's deepest call site, to show how deep the main loop and the ISR went together
+ * - Reports the RAM budget over CAN
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "stack.h"
+
+// Public variables
+unsigned int stack_isr_sp[STACK_SLOTS] = { STACK_TOP, STACK_TOP, STACK_TOP, STACK_TOP };
+
+// Private variables
+unsigned int stack_peak = 0;					// Bytes, from the last scan
+unsigned int stack_scan_tick = 0;
+
+// End of the static sections, from the linker
+extern unsigned int __noinit_end;
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Paint unused RAM
+ *	- Call first thing in main, before interrupts are enabled
+ *	- Everything below the current stack pointer is free, so stops there
+ */
+void stack_paint( void )
+{
+	unsigned int *ptr;
+	unsigned int sp;
+
+	sp = READ_SP;
+	for( ptr = &__noinit_end; ptr < (unsigned int *)sp; ptr++ ) *ptr = STACK_PAINT;
+}
+
+/*
+ * Update the high water mark
+ *	- Call from the idle loop, the scan is only run every STACK_SCAN_TICKS
+ *	- Scans up from the bottom of free RAM, so a frame that skipped over words without writing them is still counted
+ */
+void stack_service( void )
+{
+	unsigned int *ptr;
+
+	if(( tick_count - stack_scan_tick ) < STACK_SCAN_TICKS ) return;
+	stack_scan_tick = tick_count;
+
+	for( ptr = &__noinit_end; ptr < (unsigned int *)STACK_TOP; ptr++ ){
+		if( *ptr != STACK_PAINT ) break;
+	}
+	stack_peak = STACK_TOP - (unsigned int)ptr;
+}
+
+/*
+ * Queue the RAM budget frames
+ */
+void stack_send( void )
+{
+	unsigned int used;
+
+	used = (unsigned int)&__noinit_end - RAM_START;
+	can_push_ptr->address = DC_CAN_BASE + DC_STACK;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u16[0] = used;
+	can_push_ptr->data.data_u16[1] = stack_peak;
+	can_push_ptr->data.data_u16[2] = RAM_SIZE - used - stack_peak;
+	can_push_ptr->data.data_u16[3] = RAM_SIZE;
+	can_push();
+
+	can_push_ptr->address = DC_CAN_BASE + DC_STACK_ISR;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u16[0] = STACK_TOP - stack_isr_sp[STACK_TIMER_A];
+	can_push_ptr->data.data_u16[1] = STACK_TOP - stack_isr_sp[STACK_TIMER_B];
+	can_push_ptr->data.data_u16[2] = STACK_TOP - stack_isr_sp[STACK_ADC];
+	can_push_ptr->data.data_u16[3] = STACK_TOP - stack_isr_sp[STACK_UART];
+	can_push();
+}
@@ -0,0 +1,59 @@
+/*
+ * Tritium stack and RAM usage header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following stack usage functions
+ *	- stack_paint
+ *	- stack_service
+ *	- stack_send
+ *
+ */
+
+// Public function prototypes
+extern void stack_paint( void );
+extern void stack_service( void );
+extern void stack_send( void );
+
+// Public variables
+extern unsigned int stack_isr_sp[];
+
+// Deepest stack seen in each ISR, a few cycles, so left in all builds
+//	- Placed at the deepest call site on each ISR's path, so the reading includes every frame the ISR stacks up
+//	- trace_mark(), called from adc_isr with USE_TRACE, is shared with the main loop and isn't probed
+#define STACK_PROBE(slot)		{ unsigned int probe_sp = READ_SP; if( probe_sp < stack_isr_sp[slot] ) stack_isr_sp[slot] = probe_sp; }
+
+// Probed ISRs
+#define STACK_TIMER_A			0				// timer_a0, probed in supervisor_tick
+#define STACK_TIMER_B			1				// timer_b0, calls nothing, probed in the ISR
+#define STACK_ADC				2				// adc_isr, probed in protect_sample and protect_trip
+#define STACK_UART				3				// uart_tx_isr, calls nothing, only with USE_UART_TELEMETRY
+#define STACK_SLOTS				4
+
+// Memory map, see msp430x247_app.x
+//	Static sections (.data, .bss, .noinit) run up from RAM_START, after the bootload handoff, the linker marks their end with __noinit_end
+//	The stack runs down from STACK_TOP, everything between is painted at startup and scanned for the high water mark
+#define RAM_START				0x1100
+#define RAM_SIZE				0x1000
+#define STACK_TOP				0x2100
+#define STACK_PAINT				0xA5A5
+#define STACK_SCAN_TICKS		100				// Rescan once a second, from the idle loop
+
+// Report, sent on DC_STACK in reply to a remote request on DC_STACK, bytes
+//	DC_STACK:		u16[0] = static sections, u16[1] = peak stack, u16[2] = never used (RAM_SIZE - both), u16[3] = RAM_SIZE
+//	DC_STACK_ISR:	u16[0..3] = deepest stack seen in timer_a0, timer_b0, adc_isr and uart_tx_isr, 0 if not run
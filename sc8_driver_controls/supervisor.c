@@ -0,0 +1,162 @@
+/*
+ * Tritium deadline supervisor
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Keeps the watchdog running, and only kicks it while every main loop stage is checking in on time
+ * - A stage that hangs or overruns stops the kicks, and the watchdog resets us ~0.7s later
+ * - The first stage to miss its deadline is kept in uninitialised RAM, and reported with the reset cause
+ *   on DC_STARTUP after the restart
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "usci.h"
+#include "clock.h"
+#include "stack.h"
+#include "supervisor.h"
+
+// Public variables
+supervisor_record supervisor_last;
+unsigned char supervisor_reset;
+
+// Private variables
+supervisor_record supervisor_now __attribute__ ((section (".noinit")));
+unsigned char supervisor_age[SUPERVISOR_STAGES];
+const unsigned char supervisor_deadline[SUPERVISOR_STAGES] = {
+	SUPERVISOR_ADC_DEADLINE, SUPERVISOR_STATE_DEADLINE, SUPERVISOR_COMMS_DEADLINE, SUPERVISOR_CAN_RX_DEADLINE
+};
+unsigned char supervisor_running = FALSE;
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Work out why we reset, and pick up the previous run's record
+ *	- Call early in startup, before anything else reads or clears IFG1
+ */
+void supervisor_init( void )
+{
+	if(( supervisor_now.key == SUPERVISOR_KEY ) && ( supervisor_now.check == (unsigned char)~supervisor_now.stage )){
+		supervisor_last = supervisor_now;
+	}
+	else{
+		supervisor_last.stage = SUPERVISOR_NONE;
+		supervisor_last.age = 0;
+		supervisor_last.spi_timeouts = 0;
+	}
+
+	if( IFG1 & PORIFG ) supervisor_reset = RESET_POWER;
+	else if( IFG1 & RSTIFG ) supervisor_reset = RESET_PIN;
+	else if( IFG1 & WDTIFG ){
+		if( supervisor_last.stage != SUPERVISOR_NONE ) supervisor_reset = RESET_DEADLINE;
+		else supervisor_reset = RESET_WATCHDOG;
+	}
+	else supervisor_reset = RESET_OTHER;
+	IFG1 &= ~( PORIFG | RSTIFG | WDTIFG );
+
+	supervisor_now.stage = SUPERVISOR_NONE;
+	supervisor_now.age = 0;
+	supervisor_now.spi_timeouts = 0;
+	supervisor_now.check = (unsigned char)~SUPERVISOR_NONE;
+	supervisor_now.key = SUPERVISOR_KEY;
+}
+
+/*
+ * Start the watchdog
+ *	- Call at the end of startup, just before the main loop
+ */
+void supervisor_start( void )
+{
+	unsigned char i;
+
+	for( i = 0; i < SUPERVISOR_STAGES; i++ ) supervisor_age[i] = 0;
+	WDTCTL = SUPERVISOR_KICK;
+	supervisor_running = TRUE;
+}
+
+/*
+ * Report that a stage has run
+ */
+void supervisor_checkin( unsigned char stage )
+{
+	supervisor_age[stage] = 0;
+}
+
+/*
+ * Check deadlines and kick the watchdog
+ *	- Call from the tick interrupt
+ */
+void supervisor_tick( void )
+{
+	unsigned char i, late;
+
+	STACK_PROBE(STACK_TIMER_A);
+	if( supervisor_running == FALSE ) return;
+
+	late = SUPERVISOR_NONE;
+	for( i = 0; i < SUPERVISOR_STAGES; i++ ){
+		if( supervisor_age[i] != 0xFF ) supervisor_age[i]++;
+		if(( supervisor_age[i] > supervisor_deadline[i] ) && ( late == SUPERVISOR_NONE )) late = i;
+	}
+	if( usci_timeouts > supervisor_now.spi_timeouts ){
+		supervisor_now.spi_timeouts = ( usci_timeouts > 0xFF ) ? 0xFF : usci_timeouts;
+	}
+
+	if( late == SUPERVISOR_NONE ){
+		WDTCTL = SUPERVISOR_KICK;
+	}
+	else if( supervisor_now.stage == SUPERVISOR_NONE ){
+		supervisor_now.stage = late;
+		supervisor_now.age = supervisor_age[late];
+		supervisor_now.check = (unsigned char)~late;
+	}
+}
+
+/*
+ * Suspend supervision across a known long stall, such as a parameter commit
+ *	- Stops the watchdog, and the deadline checks, so the stall isn't recorded as a late stage
+ *	- Follow with supervisor_resume() as soon as the stall is over
+ */
+void supervisor_hold( void )
+{
+	supervisor_running = FALSE;
+	WDTCTL = WDTPW | WDTHOLD;
+}
+
+/*
+ * Resume supervision after supervisor_hold()
+ *	- Every stage starts its deadline again from now, then the watchdog restarts
+ */
+void supervisor_resume( void )
+{
+	supervisor_start();
+}
+
+/*
+ * Reload the watchdog interval after ACLK changes source
+ *	- Call straight after the clock module moves ACLK, the old interval is wrong for the new clock
+ *	- Leaves a held or not yet started watchdog alone
+ */
+void supervisor_reclock( void )
+{
+	if( supervisor_running == TRUE ) WDTCTL = SUPERVISOR_KICK;
+}
@@ -0,0 +1,83 @@
+/*
+ * Tritium deadline supervisor header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following supervisor functions:
+ *	- supervisor_init
+ *	- supervisor_start
+ *	- supervisor_checkin
+ *	- supervisor_tick
+ *	- supervisor_hold
+ *	- supervisor_resume
+ *	- supervisor_reclock
+ *
+ */
+
+// Public function prototypes
+extern void supervisor_init( void );
+extern void supervisor_start( void );
+extern void supervisor_checkin( unsigned char stage );
+extern void supervisor_tick( void );
+extern void supervisor_hold( void );
+extern void supervisor_resume( void );
+extern void supervisor_reclock( void );
+
+// Post-mortem record, kept in uninitialised RAM so it survives a watchdog reset
+typedef struct _supervisor_record {
+	unsigned int key;							// SUPERVISOR_KEY when the rest is valid
+	unsigned char stage;						// First stage to miss its deadline, SUPERVISOR_NONE if none did
+	unsigned char age;							// Ticks since that stage last checked in
+	unsigned char spi_timeouts;					// SPI transfers abandoned by usci.c, saturating
+	unsigned char check;						// Inverse of stage, catches a half written record
+} supervisor_record;
+
+// Public variables
+// Previous run's record and reset cause, for the DC_STARTUP frame
+extern supervisor_record supervisor_last;
+extern unsigned char supervisor_reset;
+
+// Stages, each checks in every time it runs
+#define SUPERVISOR_ADC				0			// Pedal processing, every ADC event
+#define SUPERVISOR_STATE			1			// Drive state machine, every ADC event
+#define SUPERVISOR_COMMS			2			// Telemetry and command transmission, every comms event
+#define SUPERVISOR_CAN_RX			3			// CAN receive servicing, whenever the MCP2515 IRQ is idle or serviced
+#define SUPERVISOR_STAGES			4
+#define SUPERVISOR_NONE				0xFF
+
+// Deadlines, ticks since last check-in
+#define SUPERVISOR_ADC_DEADLINE		5
+#define SUPERVISOR_STATE_DEADLINE	5
+#define SUPERVISOR_COMMS_DEADLINE	(COMMS_SPEED + 5)
+#define SUPERVISOR_CAN_RX_DEADLINE	5
+
+// Reset causes
+#define RESET_POWER					0			// Power on or brownout (SVS)
+#define RESET_PIN					1			// External reset pin
+#define RESET_DEADLINE				2			// Watchdog, after a stage missed its deadline
+#define RESET_WATCHDOG				3			// Watchdog with every stage on time, or a watchdog / flash key violation
+#define RESET_OTHER					4
+
+// Watchdog, kicked from the tick interrupt only while all stages are on time
+//	- ACLK from the VLO (~12kHz) / 8192 = ~0.7s
+//	- ACLK from the MCP2515 reference (250kHz or 2MHz) / 32768 = 131ms or 16ms
+//	- If the reference stops under it, the WDT+ fails safe to MCLK / 32768 = ~2ms, until clock.c moves ACLK to the VLO
+#define SUPERVISOR_KICK_VLO			(WDTPW | WDTCNTCL | WDTSSEL | WDTIS0)
+#define SUPERVISOR_KICK_REF			(WDTPW | WDTCNTCL | WDTSSEL)
+#define SUPERVISOR_KICK				((clock_source == CLOCK_DCO) ? SUPERVISOR_KICK_VLO : SUPERVISOR_KICK_REF)
+#define SUPERVISOR_KEY				0x5AFE
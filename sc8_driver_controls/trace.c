@@ -0,0 +1,279 @@
+/*
+ * Tritium pedal to bus latency trace
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Follows the first pedal sample that changes the drive command, from the start of its ADC conversion
+ *   to the DC_DRIVE frame carrying it being acknowledged on the bus, timestamping each stage on the way
+ * - A steady pedal isn't traced, there is no change to deliver, so the wait for the comms event shows up
+ *   as it does to the driver: anywhere from nothing to a whole comms period
+ * - Keeps the stage to stage latencies of the last TRACE_SAMPLES frames and reports their percentiles
+ * - Enabled with USE_TRACE in tri86.h, the trace points and the window compile away otherwise
+ * - Results are read, and cleared, over CAN with tools/dctrace, dcreplay prints them for the host simulation
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include <signal.h>
+#include "tri86.h"
+#include "can.h"
+#include "atomic.h"
+#include "pedal.h"
+#include "trace.h"
+
+#ifdef USE_TRACE
+
+// Public variables
+unsigned char trace_count = 0;					// Samples in the window
+unsigned int trace_lost = 0;					// Traced frames that never went out
+
+// Private variables
+unsigned long trace_sample[TRACE_QUEUED];	// Sample being converted and processed
+unsigned long trace_change[TRACE_QUEUED];	// First sample to change the command since the last frame
+unsigned char trace_changed = FALSE;
+float trace_last_current = 0.0;				// Command from the previous sample, before drive_limit()
+float trace_last_rpm = 0.0;
+unsigned long trace_flight[TRACE_STAGES];		// Sample whose frame is on its way out
+can_variables *trace_frame;
+unsigned char trace_state = 0;
+unsigned int trace_window[TRACE_SAMPLES][TRACE_STAGES - 1];
+unsigned char trace_next = 0;
+unsigned char trace_request = 0xFF;
+
+// Trace states
+#define TRACE_IDLE				0
+#define TRACE_WAIT_TXREQ		1
+#define TRACE_WAIT_DONE			2
+
+// Private function prototypes
+unsigned long trace_now( void );
+unsigned long trace_delta( unsigned long from, unsigned long to );
+void trace_record( void );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Clears the window
+ */
+void trace_init( void )
+{
+	trace_count = 0;
+	trace_next = 0;
+	trace_lost = 0;
+}
+
+/*
+ * Timestamps a stage of the sample being processed
+ *	- ADC start and done come round every tick, the command stage keeps that pair if the sample is
+ *	  the first since the last frame whose command differs from the sample before
+ *	- Compares process_pedal() output, so a command held at zero by drive_limit() doesn't count as a change every period
+ *	- Safe to call from the ADC ISR
+ */
+void trace_mark( unsigned char stage )
+{
+	trace_sample[stage] = trace_now();
+	if( stage == TRACE_COMMAND ){
+		if(( trace_changed == FALSE ) && (( command.current != trace_last_current ) || ( command.rpm != trace_last_rpm ))){
+			trace_change[TRACE_ADC_START] = trace_sample[TRACE_ADC_START];
+			trace_change[TRACE_ADC_DONE] = trace_sample[TRACE_ADC_DONE];
+			trace_change[TRACE_COMMAND] = trace_sample[TRACE_COMMAND];
+			trace_changed = TRUE;
+		}
+		trace_last_current = command.current;
+		trace_last_rpm = command.rpm;
+	}
+}
+
+/*
+ * A drive command frame is about to be pushed
+ *	- Call with can_push_ptr, before can_push()
+ *	- Tags it with the change it delivers, unless a traced frame is still on its way out
+ */
+void trace_queued( can_variables *frame )
+{
+	if(( trace_changed == TRUE ) && ( trace_state == TRACE_IDLE )){
+		trace_flight[TRACE_ADC_START] = trace_change[TRACE_ADC_START];
+		trace_flight[TRACE_ADC_DONE] = trace_change[TRACE_ADC_DONE];
+		trace_flight[TRACE_COMMAND] = trace_change[TRACE_COMMAND];
+		trace_flight[TRACE_QUEUED] = trace_now();
+		trace_frame = frame;
+		trace_state = TRACE_WAIT_TXREQ;
+	}
+	// This frame delivers any change, traced or not
+	trace_changed = FALSE;
+}
+
+/*
+ * A queued frame is being loaded into mailbox 0
+ *	- Call from can_transmit() just before the request to send
+ *	- For the traced frame, clears TX0IF first so trace_poll() sees this frame complete, not an earlier one
+ */
+void trace_transmit( can_variables *frame )
+{
+	if(( trace_state != TRACE_WAIT_TXREQ ) || ( frame != trace_frame )) return;
+	can_mod( CANINTF, MCP_IRQ_TXB0, 0x00 );
+	trace_flight[TRACE_TXREQ] = trace_now();
+	trace_state = TRACE_WAIT_DONE;
+}
+
+/*
+ * Follows the traced frame
+ *	- Call every pass of the main loop, only reads the MCP2515 while the frame is on the bus
+ */
+void trace_poll( void )
+{
+	unsigned long now;
+
+	if( trace_state == TRACE_IDLE ) return;
+	if( trace_state == TRACE_WAIT_DONE ){
+		if( can_read_status() & TRACE_STATUS_TX0IF ){
+			trace_flight[TRACE_TX_DONE] = trace_now();
+			trace_record();
+			trace_state = TRACE_IDLE;
+			return;
+		}
+	}
+	// Flushed, bus-off, or never acknowledged
+	now = trace_now();
+	if( trace_delta( trace_flight[TRACE_QUEUED], now ) > TRACE_TIMEOUT_US ){
+		trace_lost++;
+		trace_state = TRACE_IDLE;
+	}
+}
+
+/*
+ * Percentile of an interval over the window, nearest rank, in TRACE_UNIT_US
+ *	- Returns 0 with an empty window
+ */
+unsigned int trace_percentile( unsigned char interval, unsigned char percent )
+{
+	unsigned int sorted[TRACE_SAMPLES];
+	unsigned int value;
+	unsigned long sum;
+	unsigned char i, j, rank;
+
+	if( trace_count == 0 ) return( 0 );
+
+	// Insertion sort the interval's samples, summing the stages for the total
+	for( i = 0; i < trace_count; i++ ){
+		if( interval == TRACE_TOTAL ){
+			sum = 0;
+			for( j = 0; j < TRACE_STAGES - 1; j++ ) sum += trace_window[i][j];
+			value = ( sum > 0xFFFF ) ? 0xFFFF : (unsigned int)sum;
+		}
+		else value = trace_window[i][interval];
+		for( j = i; ( j > 0 ) && ( sorted[j - 1] > value ); j-- ) sorted[j] = sorted[j - 1];
+		sorted[j] = value;
+	}
+	rank = ( (unsigned int)percent * trace_count + 99 ) / 100;
+	if( rank == 0 ) rank = 1;
+	return( sorted[rank - 1] );
+}
+
+/*
+ * Accepts a trace request from the CAN receive dispatch
+ *	- Ignores our own replies
+ */
+void trace_receive( void )
+{
+	if( can.data.data_u8[0] & TRACE_REPLY ) return;
+	trace_request = can.data.data_u8[0];
+}
+
+/*
+ * Handles trace requests
+ *	- Call from the main loop when nothing more urgent is waiting, sorting the window takes a while
+ */
+void trace_service( void )
+{
+	unsigned char i;
+
+	switch( trace_request ){
+		case TRACE_CMD_REPORT:
+			if( can_queue_free() <= TRACE_INTERVALS ) return;	// Try again next time round
+			for( i = 0; i < TRACE_INTERVALS; i++ ){
+				can_push_ptr->address = DC_CAN_BASE + DC_TRACE;
+				can_push_ptr->status = 8;
+				can_push_ptr->data.data_u8[0] = TRACE_REPLY | i;
+				can_push_ptr->data.data_u8[1] = trace_count;
+				can_push_ptr->data.data_u16[1] = trace_percentile( i, 50 );
+				can_push_ptr->data.data_u16[2] = trace_percentile( i, 90 );
+				can_push_ptr->data.data_u16[3] = trace_percentile( i, 99 );
+				can_push();
+			}
+			break;
+		case TRACE_CMD_RESET:
+			trace_init();
+			break;
+	}
+	trace_request = 0xFF;
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Time since Timer A started, us
+ *	- Same reading as startup_time(), at Timer A resolution, and safe inside an ISR
+ */
+unsigned long trace_now( void )
+{
+	unsigned int ticks, count, sr;
+
+	ATOMIC_BEGIN( sr );
+	ticks = tick_count;
+	count = TAR;
+	if(TACCTL0 & CCIFG){						// Tick pending, TAR has already wrapped
+		ticks++;
+		count = TAR;
+	}
+	ATOMIC_END( sr );
+	return( (unsigned long)ticks * (1000000UL / TICK_RATE) + count / (INPUT_CLOCK / 8 / 1000000UL) );
+}
+
+/*
+ * Time between two trace_now() readings, us
+ */
+unsigned long trace_delta( unsigned long from, unsigned long to )
+{
+	if( to >= from ) return( to - from );
+	return( to + TRACE_WRAP_US - from );
+}
+
+/*
+ * Adds the traced frame's stage to stage latencies to the window, replacing the oldest
+ */
+void trace_record( void )
+{
+	unsigned long us;
+	unsigned char i;
+
+	for( i = 0; i < TRACE_STAGES - 1; i++ ){
+		us = trace_delta( trace_flight[i], trace_flight[i + 1] ) / TRACE_UNIT_US;
+		trace_window[trace_next][i] = ( us > 0xFFFF ) ? 0xFFFF : (unsigned int)us;
+	}
+	trace_next++;
+	if( trace_next == TRACE_SAMPLES ) trace_next = 0;
+	if( trace_count < TRACE_SAMPLES ) trace_count++;
+}
+
+#endif
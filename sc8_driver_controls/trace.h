@@ -0,0 +1,88 @@
+/*
+ * Tritium pedal to bus latency trace header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following latency trace functions:
+ *	- trace_init
+ *	- trace_mark
+ *	- trace_queued
+ *	- trace_transmit
+ *	- trace_poll
+ *	- trace_percentile
+ *	- trace_receive
+ *	- trace_service
+ *
+ */
+
+// Public function prototypes
+extern void trace_init( void );
+extern void trace_mark( unsigned char stage );
+extern void trace_queued( can_variables *frame );
+extern void trace_transmit( can_variables *frame );
+extern void trace_poll( void );
+extern unsigned int trace_percentile( unsigned char interval, unsigned char percent );
+extern void trace_receive( void );
+extern void trace_service( void );
+
+// Public variables
+extern unsigned char trace_count;
+extern unsigned int trace_lost;
+
+// Trace points compile away unless USE_TRACE is set in tri86.h
+#ifdef USE_TRACE
+#define TRACE_MARK(stage)		trace_mark(stage)
+#define TRACE_FRAME_QUEUED(frame)	trace_queued(frame)
+#define TRACE_TRANSMIT(frame)	trace_transmit(frame)
+#else
+#define TRACE_MARK(stage)
+#define TRACE_FRAME_QUEUED(frame)
+#define TRACE_TRANSMIT(frame)
+#endif
+
+// Stages of a pedal sample on its way to the bus
+#define TRACE_ADC_START			0				// ADC12SC set in the timer block
+#define TRACE_ADC_DONE			1				// ADC ISR, end of the conversion sequence
+#define TRACE_COMMAND			2				// process_pedal() has computed the command
+#define TRACE_QUEUED			3				// DC_DRIVE carrying it pushed on canq, first motor controller only
+#define TRACE_TXREQ				4				// can_transmit() loaded mailbox 0 and requested to send
+#define TRACE_TX_DONE			5				// MCP2515 TX0IF seen, the frame has been acknowledged on the bus
+#define TRACE_STAGES			6
+
+// Reported intervals: each stage from the one before, then the whole path
+//	0 = ADC conversion, 1 = pedal processing, 2 = wait for the comms event, 3 = CAN queue, 4 = on the bus, 5 = total
+#define TRACE_INTERVALS			(TRACE_STAGES)
+#define TRACE_TOTAL				(TRACE_STAGES - 1)
+
+// The last TRACE_SAMPLES traced frames are kept, at most one per comms event
+#define TRACE_SAMPLES			64
+#define TRACE_UNIT_US			2				// Stored and reported in 2us units, saturating at 131ms
+#define TRACE_TIMEOUT_US		200000UL		// Give up on a frame that hasn't gone out by now, counts as lost
+#define TRACE_WRAP_US			(65536UL * (1000000UL / TICK_RATE))	// Timestamps wrap with tick_count
+
+// MCP2515 READ STATUS bit for TXB0CNTRL.TXREQ's completion flag
+#define TRACE_STATUS_TX0IF		0x08
+
+// CAN protocol, requests and replies on DC_CAN_BASE + DC_TRACE
+//	Request: byte 0 = command
+//	Reply, one per interval: byte 0 = interval, byte 1 = samples in the window,
+//		bytes 2-3 = 50th, bytes 4-5 = 90th, bytes 6-7 = 99th percentile, in TRACE_UNIT_US
+//	Percentiles are nearest rank, so with fewer than 100 samples the 99th is the window maximum
+#define TRACE_CMD_REPORT		0x00
+#define TRACE_CMD_RESET			0x01
+#define TRACE_REPLY				0x80			// Set in byte 0 of replies, so they can't be mistaken for requests
@@ -28,26 +28,54 @@
 #include "usci.h"
 #include "pedal.h"
 #include "gauge.h"
+#include "param.h"
+#include "logger.h"
+#include "protect.h"
+#include "bootload.h"
+#include "supervisor.h"
+#include "clock.h"
+#include "profile.h"
+#include "vehicle.h"
+#include "drive.h"
+#include "atomic.h"
+#include "egear.h"
+#include "power.h"
+#include "comms.h"
+#include "stack.h"
+#include "uart.h"
+#include "trace.h"
 
 // Function prototypes
-void clock_init( void );
 void io_init( void );
 void timerA_init( void );
 void timerB_init( void );
 void adc_init( void );
 static void __inline__ brief_pause(register unsigned int n);
 void update_switches( unsigned int *state, unsigned int *difference);
+void supply_wait( void );
+unsigned int startup_time( void );
+void send_startup( void );
+static unsigned char __inline__ parked( void );
+void send_boot_refused( void );
+void send_telemetry( unsigned int switches );
 
 // Global variables
 // Status and event flags
 volatile unsigned int events = 0x0000;
 
-// Data from motor controller
-float motor_rpm = 0;
-float motor_temp = 0;
-float controller_temp = 0;
-float battery_voltage = 0;
-float battery_current = 0;
+// Startup timing, ms from the clock switch
+volatile unsigned int tick_count = 0;
+unsigned char startup_state = STARTUP_SUPPLY;
+unsigned int startup_supply_ms = 0;				// Pedal supply in range
+unsigned int startup_drive_ms = 0;				// First DC_DRIVE with live pedal inputs queued
+
+// Main loop passes this tick, the fewest in any tick since the last DC_STATUS is loop_min (comms.c)
+unsigned char loop_passes = 0;
+
+// Switch debouncing: debounced port state and 2-bit vertical counters, one bit per port pin
+unsigned int switch_debounced = 0x0000;
+unsigned int switch_count0 = 0x0000;
+unsigned int switch_count1 = 0x0000;
 
 // Main routine
 int main( void )
@@ -57,37 +85,53 @@ int main( void )
 	unsigned int switches = 0x0000;
 	unsigned int switches_diff = 0x0000;
 	unsigned char next_state = MODE_OFF;
-	unsigned char current_egear = EG_STATE_NEUTRAL;
-	// Comms
-	unsigned int comms_event_count = 0;
-	// LED flashing
-	unsigned char charge_flash_count = CHARGE_FLASH_SPEED;
-	// Debug
-	unsigned int i;
 	
-	// Stop watchdog timer
+	// Stop watchdog timer, the supervisor restarts it once initialisation is done
 	WDTCTL = WDTPW + WDTHOLD;
 
+	// Find out why we reset, before anything else touches the reset flags
+	supervisor_init();
+
+	// Fill free RAM for stack high water mark checks
+	stack_paint();
+
 	// Initialise I/O ports
 	io_init();
 
-	// Wait a bit for clocks etc to stabilise, and power to come up for external devices
-	// MSP430 starts at 1.8V, CAN controller need 3.3V
-	for(i = 0; i < 10000; i++) brief_pause(10);
+	// Wait for the supply to come up, then go straight to full speed
+	// MSP430 starts at 1.8V, 16MHz operation and the CAN controller need 3.3V
+	supply_wait();
 
-	// Initialise clock module - internal osciallator
+	// Initialise clock module - internal osciallator, until the MCP2515 clock output is up
 	clock_init();
 
+	// Initialise Timer A (10ms timing ticks) and let it run, so startup is timed from here
+	// Interrupts are on from here: the tick ISR counts ticks and posts timer and comms events, which queue up
+	// until the main loop, and leaves the watchdog alone until supervisor_start()
+	// Timer B, the ADC and the expansion UART ISRs join in as each is initialised below
+	timerA_init();
+	eint();
+
+	// Power the pedal supply and CAN bus now, so they come up while everything else initialises
+	protect_init();
+	protect_output(PROTECT_SUPPLY, TRUE);
+	protect_output(PROTECT_CAN_PWR, TRUE);
+
+	// Load tuning parameters from INFO flash into RAM
+	param_init();
+
 	// Initialise SPI port for CAN controller (running with SMCLK)
 	usci_init(0);
 	
 	// Reset CAN controller and initialise
-	// This also changes the clock output from the MCP2515, but we're not using it in this software
+	// This also sets the clock output from the MCP2515, then switch to (or start trimming against) it
+#ifdef USE_CAN_AUTOBAUD
+	can_init( can_autobaud( CAN_BITRATE_500 ) );
+#else
 	can_init( CAN_BITRATE_500 );
-	events |= EVENT_CONNECTED;
-
-	// Initialise Timer A (10ms timing ticks)
-	timerA_init();
+#endif
+	clock_reference();
+	event_post( EVENT_CONNECTED );
 
 	// Initialise Timer B (gauge outputs PWM / pulses)
 	timerB_init();
@@ -95,190 +139,132 @@ int main( void )
 	// Initialise A/D converter for potentiometer and current sense inputs
 	adc_init();
 
-	// Initialise switch & encoder positions
+	// Initialise switch & encoder positions, starting the debouncer from the current inputs
+	switch_debounced = (P1IN | (P2IN << 8)) ^ SWITCH_ACTIVE_LOW;
 	update_switches(&switches, &switches_diff);
 	
 	// Initialise command state
 	command.rpm = 0.0;
 	command.current = 0.0;
-	command.bus_current = 1.0;
+	drive_init();
+	power_init();
 	command.flags = 0x00;
 	command.state = MODE_OFF;
 	
 	// Init gauges
 	gauge_init();
 
-	// Enable interrupts
-	eint();
+	// Start the telemetry logger
+	logger_init();
+
+#ifdef USE_PROFILE
+	profile_init();
+#endif
+#ifdef USE_TRACE
+	trace_init();
+#endif
+
+#ifdef USE_UART_TELEMETRY
+	// Start the expansion UART, now the clock is final
+	uart_init();
+#endif
+
+	// Start deadline supervision
+	supervisor_start();
 
 	// Check switch inputs and generate command packets to motor controller
 	while(TRUE){
 		// Process CAN transmit queue
 		can_transmit();
+#ifdef USE_TRACE
+		trace_poll();
+#endif
+		if(loop_passes != 0xFF) loop_passes++;
 
 		// Monitor switch positions & analog inputs
-		if( events & EVENT_TIMER ){
-			events &= ~EVENT_TIMER;			
+		if( event_consume( EVENT_TIMER ) ){
+			if(loop_passes < loop_min) loop_min = loop_passes;
+			loop_passes = 0;
+			TRACE_MARK(TRACE_ADC_START);
 			ADC12CTL0 |= ADC12SC;               	// Start A/D conversions
+			// Service CAN error back-off and bus-off recovery
+			can_tick();
+			// Check the clock reference and trim the DCO
+			clock_service();
+			// Age motor controller data, and freeze the log if the link drops
+			if(vehicle_tick()) logger_trigger(LOG_CAUSE_MC_LOST);
+			// Follow pack and temperature limits
+			power_tick();
+			// Send any periodic frames due at this point in the comms period
+			comms_schedule(switches);
+#ifdef USE_EGEAR
+			// Repeat unanswered eGear commands, and give up on stuck changeovers
+			egear_tick();
+#endif
 		}
 
-		if( events & EVENT_ADC ){
-			events &= ~EVENT_ADC;
-			// Check for 5V pedal supply errors
-			// TODO
-			// Check for overcurrent errors on 12V outputs
-			// TODO
+		if( event_consume( EVENT_ADC ) ){
+			// 5V pedal supply and 12V output overcurrent checks run in the ADC ISR, service their retries here
+			protect_tick();
+			// Hold off reading the pedals until their 5V supply is in range, then send a drive command straight away
+			if(startup_state == STARTUP_SUPPLY){
+				if((ADC12MEM3 >= PROTECT_SUPPLY_LOW) && (ADC12MEM3 < PROTECT_SUPPLY_HIGH)){
+					startup_supply_ms = startup_time();
+					startup_state = STARTUP_READY;
+					event_post( EVENT_COMMS );
+				}
+			}
 			// Update motor commands based on pedal and slider positions
+			if(startup_state != STARTUP_SUPPLY){
+				PROFILE_START(PROFILE_PEDAL);
 #ifdef REGEN_ON_BRAKE
-			process_pedal( ADC12MEM0, ADC12MEM1, ADC12MEM2, (switches & SW_BRAKE) );	// Request regen on brake switch
+				process_pedal( ADC12MEM0, ADC12MEM1, ADC12MEM2, (switches & SW_BRAKE) );	// Request regen on brake switch
 #else
-			process_pedal( ADC12MEM0, ADC12MEM1, ADC12MEM2, FALSE );					// No regen
+				process_pedal( ADC12MEM0, ADC12MEM1, ADC12MEM2, FALSE );					// No regen
 #endif
+				PROFILE_STOP(PROFILE_PEDAL);
+				TRACE_MARK(TRACE_COMMAND);
+				if(command.flags != 0x00) logger_trigger(LOG_CAUSE_PEDAL);
+			}
+			supervisor_checkin(SUPERVISOR_ADC);
 			
 			// Update current state of the switch inputs
 			update_switches(&switches, &switches_diff);
 			
+			// Flag supply and output faults, and CAN bus faults while error passive or bus-off
+			switches = (switches & ~(SW_ACCEL_FAULT | SW_CAN_FAULT | SW_BRAKE_FAULT | SW_REV_FAULT)) | protect_faults;
+			if(can_state >= CAN_STATE_PASSIVE) switches |= SW_CAN_FAULT;
+			if(vehicle_link == FALSE) switches |= SW_MC_LOST;
+			
 			// Track current operating state
-			switch(command.state){
-				case MODE_OFF:
-					if(switches & SW_IGN_ON) next_state = MODE_N;
-					else next_state = MODE_OFF;
-					P5OUT &= ~(LED_GEAR_ALL);
-					break;
-				case MODE_N:
-#ifndef USE_EGEAR
-					if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_R;
-					else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BL;
-					else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DL;
-#else
-					if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_CO_R;
-					else if ( (switches & SW_MODE_B) && ( (events & EVENT_SLOW) || (!(events & EVENT_OVER_VEL_LTOH) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_BL;
-					else if ( (switches & SW_MODE_B) && ( ((events & EVENT_OVER_VEL_HTOL) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_BH;
-					else if ( (switches & SW_MODE_D) && ( (events & EVENT_SLOW) || (!(events & EVENT_OVER_VEL_LTOH) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_DL;
-					else if ( (switches & SW_MODE_D) && ( ((events & EVENT_OVER_VEL_HTOL) && (events & EVENT_FORWARD)) ) ) next_state = MODE_CO_DH;
-#endif
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else if (switches & SW_FUEL) next_state = MODE_CHARGE;
-					else next_state = MODE_N;
-					P5OUT &= ~(LED_GEAR_ALL);
-					P5OUT |= LED_GEAR_3;
-					break;
-				case MODE_CO_R:
-				case MODE_CO_BL:
-				case MODE_CO_BH:
-				case MODE_CO_DL:
-				case MODE_CO_DH:
-					if(switches & SW_MODE_N) next_state = MODE_N;
-					else if((command.state == MODE_CO_R) && (current_egear == EG_STATE_LOW)) next_state = MODE_R;
-					else if((command.state == MODE_CO_BL) && (current_egear == EG_STATE_LOW)) next_state = MODE_BL;
-					else if((command.state == MODE_CO_BH) && (current_egear == EG_STATE_HIGH)) next_state = MODE_BH;
-					else if((command.state == MODE_CO_DL) && (current_egear == EG_STATE_LOW)) next_state = MODE_DL;
-					else if((command.state == MODE_CO_DH) && (current_egear == EG_STATE_HIGH)) next_state = MODE_DH;
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else if (switches & SW_FUEL) next_state = MODE_CHARGE;
-					else next_state = command.state;
-					break;
-				case MODE_R:
-					if(switches & SW_MODE_N) next_state = MODE_N;
-					else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BL;	// Assume already in low egear
-					else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DL;	// Assume already in low egear
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else if (switches & SW_FUEL) next_state = MODE_CHARGE;
-					else next_state = MODE_R;
-					P5OUT &= ~(LED_GEAR_ALL);
-					P5OUT |= LED_GEAR_4;
-					break;
-				case MODE_BL:
-					if(switches & SW_MODE_N) next_state = MODE_N;
-					else if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_R;		// Assume already in low egear
-					else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DL;	// Assume already in low egear
-#ifdef USE_EGEAR
-					else if(events & EVENT_OVER_VEL_LTOH) next_state = MODE_CO_BH;
-#endif
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else if (switches & SW_FUEL) next_state = MODE_CHARGE;
-					else next_state = MODE_BL;
-					P5OUT &= ~(LED_GEAR_ALL);
-					P5OUT |= LED_GEAR_2;
-					break;
-				case MODE_BH:
-					if(switches & SW_MODE_N) next_state = MODE_N;
-					else if((switches & SW_MODE_D) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_DH;
-#ifdef USE_EGEAR
-					else if(!(events & EVENT_OVER_VEL_HTOL)) next_state = MODE_CO_BL;
-#endif
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else if (switches & SW_FUEL) next_state = MODE_CHARGE;
-					else next_state = MODE_BH;
-					P5OUT &= ~(LED_GEAR_ALL);
-					P5OUT |= LED_GEAR_2;
-					break;
-				case MODE_DL:
-					if(switches & SW_MODE_N) next_state = MODE_N;
-					else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BL;	// Assume already in low egear
-					else if((switches & SW_MODE_R) && ((events & EVENT_SLOW) || (events & EVENT_REVERSE))) next_state = MODE_R;		// Assume already in low egear
+			PROFILE_START(PROFILE_STATE);
+			next_state = drive_state(switches);
+			if((next_state == MODE_OFF) && (command.state != MODE_OFF) && !(events & EVENT_SLOW)) logger_trigger(LOG_CAUSE_OFF_MOVING);
 #ifdef USE_EGEAR
-					else if(events & EVENT_OVER_VEL_LTOH) next_state = MODE_CO_DH;
+			// Start or cancel eGear changeovers on the state change, not at the next comms event
+			if(next_state != command.state) egear_state(next_state);
 #endif
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else if (switches & SW_FUEL) next_state = MODE_CHARGE;
-					else next_state = MODE_DL;
-					P5OUT &= ~(LED_GEAR_ALL);
-					P5OUT |= LED_GEAR_1;
-					break;
-				case MODE_DH:
-					if(switches & SW_MODE_N) next_state = MODE_N;
-					else if((switches & SW_MODE_B) && ((events & EVENT_SLOW) || (events & EVENT_FORWARD))) next_state = MODE_BH;
-#ifdef USE_EGEAR
-					else if(!(events & EVENT_OVER_VEL_HTOL)) next_state = MODE_CO_DL;
-#endif
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else if (switches & SW_FUEL) next_state = MODE_CHARGE;
-					else next_state = MODE_DH;
-					P5OUT &= ~(LED_GEAR_ALL);
-					P5OUT |= LED_GEAR_1;
-					break;
-				case MODE_CHARGE:
-					if(!(switches & SW_FUEL)) next_state = MODE_N;
-					else if (!(switches & SW_IGN_ON)) next_state = MODE_OFF;
-					else next_state = MODE_CHARGE;
-					// Flash N LED in charge mode
-					charge_flash_count--;
-					P5OUT &= ~(LED_GEAR_4 | LED_GEAR_2 | LED_GEAR_1);
-					if(charge_flash_count == 0){
-						charge_flash_count = (CHARGE_FLASH_SPEED * 2);
-						P5OUT |= LED_GEAR_3;
-					}
-					else if(charge_flash_count == CHARGE_FLASH_SPEED){
-						P5OUT &= ~LED_GEAR_3;
-					}
-					break;
-				default:
-					next_state = MODE_OFF;
-					break;
-			}
 			command.state = next_state;
+			supervisor_checkin(SUPERVISOR_STATE);
 			
 			// Control brake lights
-			if((switches & SW_BRAKE) || (events & EVENT_REGEN)) P1OUT |= BRAKE_OUT;
-			else P1OUT &= ~BRAKE_OUT;
+			protect_output(PROTECT_BRAKE, (switches & SW_BRAKE) || (events & EVENT_REGEN));
 			
 			// Control reversing lights
-			if(command.state == MODE_R) P1OUT |= REVERSE_OUT;
-			else P1OUT &= ~REVERSE_OUT;
+			protect_output(PROTECT_REVERSE, command.state == MODE_R);
 			
 			// Control CAN bus and pedal sense power
 			if((switches & SW_IGN_ACC) || (switches & SW_IGN_ON)){ // THIS NEEDS TO BE CHANGED BACK TO NON_INVERTED SIGNALS (1/16/25 Shannon)
 																	// changed (1/16/25 Shannon)
 																	// CHANGED BACK (1/16/25 Shannon)
 																	// changed 
-				P1OUT |= CAN_PWR_OUT;
-				P6OUT |= ANLG_V_ENABLE;
+				protect_output(PROTECT_CAN_PWR, TRUE);
+				protect_output(PROTECT_SUPPLY, TRUE);
 			}
 			else{
-				P1OUT &= ~CAN_PWR_OUT;
-				P6OUT &= ~ANLG_V_ENABLE;
-				events &= ~EVENT_CONNECTED;
+				protect_output(PROTECT_CAN_PWR, FALSE);
+				protect_output(PROTECT_SUPPLY, FALSE);
+				event_clear( EVENT_CONNECTED );
 			}
 
 			// Control gear switch backlighting
@@ -288,219 +274,91 @@ int main( void )
 			// Control front panel fault indicator
 			if(switches & (SW_ACCEL_FAULT | SW_CAN_FAULT | SW_BRAKE_FAULT | SW_REV_FAULT)) P3OUT &= ~LED_REDn;
 			else P3OUT |= LED_REDn;
+			PROFILE_STOP(PROFILE_STATE);
 			
+			// Report switch changes straight away rather than waiting for the next comms event
+#ifdef USE_COMPACT_TELEMETRY
+			if(switches_diff && (events & EVENT_CONNECTED)) send_status(switches);
+#else
+			if(switches_diff && (events & EVENT_CONNECTED)) send_switches(switches);
+#endif
+
+			// Record this cycle for the telemetry logger
+			logger_record( ADC12MEM0, ADC12MEM2, switches, motor_rpm );
+#ifdef USE_UART_TELEMETRY
+			// And stream it off board, without touching the CAN bus
+			send_telemetry(switches);
+#endif
 		}
 
 		// Handle outgoing communications events
-		if(events & EVENT_COMMS){
-			events &= ~EVENT_COMMS;		
+		if(event_consume(EVENT_COMMS)){
 			// SHANNON 1/16/25: Removed Blinking LED when nothing was actually being transmitted
 
 			// Update command state and override pedal commands if necessary
-			if(switches & SW_IGN_ON){
-				switch(command.state){
-					case MODE_R:
-					case MODE_DL:
-					case MODE_DH:
-					case MODE_BL:
-					case MODE_BH:
-#ifndef REGEN_ON_BRAKE
-#ifdef CUTOUT_ON_BRAKE
-						if(switches & SW_BRAKE){
-							command.current = 0.0;	
-							command.rpm = 0.0;
-						}
-#endif
-#endif
-						break;
-					case MODE_CHARGE:
-					case MODE_N:
-					case MODE_START:
-					case MODE_OFF:
-					case MODE_ON:
-					case MODE_CO_R:
-					case MODE_CO_DL:
-					case MODE_CO_DH:
-					case MODE_CO_BL:
-					case MODE_CO_BH:
-					default:
-						command.current = 0.0;
-						command.rpm = 0.0;
-						break;
-				}
-			}
-			else{
-				command.current = 0.0;
-				command.rpm = 0.0;
-			}
+			drive_limit(switches);
 
 			// Transmit commands and telemetry
 			if(events & EVENT_CONNECTED){
 				// SHANNON 1/16/25: Activity moved here instead
 				// Blink CAN activity LED
-				events |= EVENT_CAN_ACTIVITY;	
-
-				// Transmit drive command frame
-				can_push_ptr->address = DC_CAN_BASE + DC_DRIVE;
-				can_push_ptr->status = 8;
-				can_push_ptr->data.data_fp[1] = command.current;
-				can_push_ptr->data.data_fp[0] = command.rpm;
-				can_push();		
-	
-				// Transmit bus command frame
-				can_push_ptr->address = DC_CAN_BASE + DC_POWER;
-				can_push_ptr->status = 8;
-				can_push_ptr->data.data_fp[1] = command.bus_current;
-				can_push_ptr->data.data_fp[0] = 0.0;
-				can_push();
-				
-				// Transmit switch position/activity frame and clear switch differences variables
-				can_push_ptr->address = DC_CAN_BASE + DC_SWITCH;
-				can_push_ptr->status = 8;
-				can_push_ptr->data.data_u8[7] = command.state;
-				can_push_ptr->data.data_u8[6] = command.flags;
-				can_push_ptr->data.data_u16[2] = 0;
-				can_push_ptr->data.data_u16[1] = 0;
-				can_push_ptr->data.data_u16[0] = switches;
-				can_push();
-
-				// Transmit egear control packet if needed
-#ifdef USE_EGEAR
-				if(		(command.state == MODE_CO_R && next_state == MODE_CO_R)
-					||	(command.state == MODE_CO_BL && next_state == MODE_CO_BL)
-					||	(command.state == MODE_CO_BH && next_state == MODE_CO_BH)
-					||	(command.state == MODE_CO_DL && next_state == MODE_CO_DL)
-					||	(command.state == MODE_CO_DH && next_state == MODE_CO_DH))
-				{
-					if( current_egear == EG_STATE_NEUTRAL)
-					{
-						can_push_ptr->address = EG_CAN_BASE + EG_COMMAND;
-						can_push_ptr->status = 8;
-						can_push_ptr->data.data_u32[0] = 0;
-						can_push_ptr->data.data_u32[1] = 0;
-						if(command.state == MODE_CO_R) can_push_ptr->data.data_u8[0] = EG_CMD_LOW;
-						else if( command.state == MODE_CO_BL) can_push_ptr->data.data_u8[0] = EG_CMD_LOW;
-						else if( command.state == MODE_CO_DL) can_push_ptr->data.data_u8[0] = EG_CMD_LOW;
-						else if( command.state == MODE_CO_BH) can_push_ptr->data.data_u8[0] = EG_CMD_HIGH;
-						else if( command.state == MODE_CO_DH) can_push_ptr->data.data_u8[0] = EG_CMD_HIGH;
-						can_push();
-					}
-					else if(events & EVENT_MC_NEUTRAL)
-					{
-						can_push_ptr->address = EG_CAN_BASE + EG_COMMAND;
-						can_push_ptr->status = 8;
-						can_push_ptr->data.data_u32[0] = 0;
-						can_push_ptr->data.data_u32[1] = 0;
-						can_push_ptr->data.data_u8[0] = EG_CMD_NEUTRAL;
-						can_push();
-					}
-				}
-				else if(command.state == MODE_N)
-				{
-					can_push_ptr->address = EG_CAN_BASE + EG_COMMAND;
-					can_push_ptr->status = 8;
-					can_push_ptr->data.data_u32[0] = 0;
-					can_push_ptr->data.data_u32[1] = 0;
-					can_push_ptr->data.data_u8[0] = EG_CMD_NEUTRAL;
-					can_push();
-				}
-				else if((command.state == MODE_BL) || (command.state == MODE_DL) || (command.state == MODE_R))
-				{
-					can_push_ptr->address = EG_CAN_BASE + EG_COMMAND;
-					can_push_ptr->status = 8;
-					can_push_ptr->data.data_u32[0] = 0;
-					can_push_ptr->data.data_u32[1] = 0;
-					can_push_ptr->data.data_u8[0] = EG_CMD_LOW;
-					can_push();
-				}
-				else if((command.state == MODE_BH) || (command.state == MODE_DH))
-				{
-					can_push_ptr->address = EG_CAN_BASE + EG_COMMAND;
-					can_push_ptr->status = 8;
-					can_push_ptr->data.data_u32[0] = 0;
-					can_push_ptr->data.data_u32[1] = 0;
-					can_push_ptr->data.data_u8[0] = EG_CMD_HIGH;
-					can_push();
-				}
-#endif
+				event_post(EVENT_CAN_ACTIVITY);
+
+				// Transmit drive command frames
+				drive_send();
 				
-				// Transmit our ID frame at a slower rate (every 10 events = 1/second)
-				comms_event_count++;
-				if(comms_event_count == 10){
-					comms_event_count = 0;
-					can_push_ptr->address = DC_CAN_BASE;
-					can_push_ptr->status = 8;
-					can_push_ptr->data.data_u8[7] = 'T';
-					can_push_ptr->data.data_u8[6] = '0';
-					can_push_ptr->data.data_u8[5] = '8';
-					can_push_ptr->data.data_u8[4] = '6';
-					can_push_ptr->data.data_u32[0] = DEVICE_ID;
-					can_push();		
+				// Record and report how long the first live drive command took
+				if(startup_state == STARTUP_READY){
+					startup_drive_ms = startup_time();
+					startup_state = STARTUP_DONE;
+					send_startup();
 				}
+				// The rest of the periodic frames follow in comms_schedule()
 			}
+			supervisor_checkin(SUPERVISOR_COMMS);
 		}
 
-		// Check for CAN packet reception
+		// Check for CAN packet reception, the MCP2515 IRQ line must not stay asserted across ticks
+		if(P2IN & CAN_INTn) supervisor_checkin(SUPERVISOR_CAN_RX);
 		if((P2IN & CAN_INTn) == 0x00){
 			// IRQ flag is set, so run the receive routine to either get the message, or the error
+			PROFILE_START(PROFILE_CAN_RX);
 			can_receive();
 			// Check the status
 			if(can.status == CAN_OK){
 				// We've received a packet, so must be connected to something
-				events |= EVENT_CONNECTED;
-				// Process the packet
-				switch(can.address){
-					case MC_CAN_BASE + MC_VELOCITY:
-						// Update speed threshold event flags
-						if(can.data.data_fp[0] > ENGAGE_VEL_F) events |= EVENT_FORWARD;
-						else events &= ~EVENT_FORWARD;
-						if(can.data.data_fp[0] < ENGAGE_VEL_R) events |= EVENT_REVERSE;
-						else events &= ~EVENT_REVERSE;
-						if((can.data.data_fp[0] >= ENGAGE_VEL_R) && (can.data.data_fp[0] <= ENGAGE_VEL_F)) events |= EVENT_SLOW;
-						else events &= ~EVENT_SLOW;
-						if(can.data.data_fp[0] >= CHANGE_VEL_LTOH) events |= EVENT_OVER_VEL_LTOH;
-						else events &= ~EVENT_OVER_VEL_LTOH;
-						if(can.data.data_fp[0] >= CHANGE_VEL_HTOL) events |= EVENT_OVER_VEL_HTOL;
-						else events &= ~EVENT_OVER_VEL_HTOL;
-						motor_rpm = can.data.data_fp[0];
-						gauge_tach_update( motor_rpm );
+				event_post(EVENT_CONNECTED);
+				// Process the packet, motor and eGear controller data first
+				if(vehicle_receive() == FALSE) switch(can.address){
+					case DC_CAN_BASE + DC_LOG:
+						// Telemetry logger request, serviced when the main loop is idle
+						logger_receive();
 						break;
-					case MC_CAN_BASE + MC_I_VECTOR:
-						// Update regen status flags
-						if(can.data.data_fp[0] < REGEN_THRESHOLD) events |= EVENT_REGEN;
-						else events &= ~EVENT_REGEN;
+					case DC_CAN_BASE + DC_PARAM:
+						// Parameter protocol request, serviced when the main loop is idle
+						param_receive();
 						break;
-					case MC_CAN_BASE + MC_TEMP1:
-						// Update data for temp gauge
-						controller_temp = can.data.data_fp[1];
-						motor_temp = can.data.data_fp[0];
-						gauge_temp_update( motor_temp, controller_temp );
+#ifdef USE_PROFILE
+					case DC_CAN_BASE + DC_PROFILE:
+						// Profiler request, serviced when the main loop is idle
+						profile_receive();
 						break;
-					case MC_CAN_BASE + MC_LIMITS:
-						// Update neutral state of motor controller
-						if(can.data.data_u8[0] == 0) events |= EVENT_MC_NEUTRAL;
-						else events &= ~EVENT_MC_NEUTRAL;
-						break;
-					case MC_CAN_BASE + MC_BUS:
-						// Update battery voltage and current for fuel and power gauges
-						battery_voltage = can.data.data_fp[0];
-						battery_current = can.data.data_fp[1];
-						gauge_power_update( battery_voltage, battery_current );
-						gauge_fuel_update( battery_voltage );
+#endif
+#ifdef USE_TRACE
+					case DC_CAN_BASE + DC_TRACE:
+						// Latency trace request, serviced when the main loop is idle
+						trace_receive();
 						break;
+#endif
 					case DC_CAN_BASE + DC_BOOTLOAD:
-						// Switch to bootloader
+						// Switch to bootloader, which sends no drive commands for up to BOOT_TIMEOUT, so only when stopped in neutral or off
 						if (		can.data.data_u8[0] == 'B' && can.data.data_u8[1] == 'O' && can.data.data_u8[2] == 'O' && can.data.data_u8[3] == 'T'
 								&&	can.data.data_u8[4] == 'L' && can.data.data_u8[5] == 'O' && can.data.data_u8[6] == 'A' && can.data.data_u8[7] == 'D' )
 						{
-							WDTCTL = 0x00;	// Force watchdog reset
+							if(parked()) boot_request();	// Leave a handoff for the bootloader and force watchdog reset
+							else send_boot_refused();
 						}
 						break;				
-					case EG_CAN_BASE + EG_STATUS:
-						if ( can.data.data_u8[0] == EG_STATE_NEUTRAL ) current_egear = EG_STATE_NEUTRAL;
-						else if ( can.data.data_u8[0] == EG_STATE_LOW ) current_egear = EG_STATE_LOW;
-						else if ( can.data.data_u8[0] == EG_STATE_HIGH ) current_egear = EG_STATE_HIGH;
-						break;
 				}
 			}
 			if(can.status == CAN_RTR){
@@ -517,33 +375,46 @@ int main( void )
 						can_push();
 						break;
 					case DC_CAN_BASE + DC_DRIVE:
-						can_push_ptr->address = can.address;
-						can_push_ptr->status = 8;
-						can_push_ptr->data.data_fp[1] = command.current;
-						can_push_ptr->data.data_fp[0] = command.rpm;
-						can_push();
+						drive_send();
 						break;
 					case DC_CAN_BASE + DC_POWER:
-						can_push_ptr->address = can.address;
-						can_push_ptr->status = 8;
-						can_push_ptr->data.data_fp[1] = command.bus_current;
-						can_push_ptr->data.data_fp[0] = 0.0;
-						can_push();
+						power_send();
 						break;
 					case DC_CAN_BASE + DC_SWITCH:
-						can_push_ptr->address = can.address;
-						can_push_ptr->status = 8;
-						can_push_ptr->data.data_u8[7] = command.state;
-						can_push_ptr->data.data_u8[6] = command.flags;
-						can_push_ptr->data.data_u16[2] = 0;
-						can_push_ptr->data.data_u16[1] = 0;
-						can_push_ptr->data.data_u16[0] = switches;
-						can_push();
+						send_switches(switches);
+						break;
+					case DC_CAN_BASE + DC_STARTUP:
+						send_startup();
+						break;
+					case DC_CAN_BASE + DC_STACK:
+						stack_send();
+						break;
+					case DC_CAN_BASE + DC_STATUS:
+						send_status(switches);
 						break;
 				}
 			}
 			if(can.status == CAN_ERROR){
+				// Stop queueing telemetry while off the bus, reception will reconnect after recovery
+				if(can_state == CAN_STATE_BUSOFF) event_clear(EVENT_CONNECTED);
+				// Freeze the telemetry log on controller errors (not wake or spurious IRQs)
+				if(can.address == 0x0000) logger_trigger(LOG_CAUSE_CAN);
 			}
+			PROFILE_STOP(PROFILE_CAN_RX);
+		}
+
+		// Lowest priority: service parameter and logger requests once nothing else is waiting
+		if(!(events & (EVENT_TIMER | EVENT_ADC | EVENT_COMMS)) && (P2IN & CAN_INTn)){
+			// Commits hold interrupts and the drive command off, so only when stopped in neutral or off
+			param_service( parked() );
+			logger_service();
+			stack_service();
+#ifdef USE_PROFILE
+			profile_service();
+#endif
+#ifdef USE_TRACE
+			trace_service();
+#endif
 		}
 	}
 	
@@ -564,23 +435,6 @@ static void __inline__ brief_pause(register unsigned int n)
         : [n] "+r"(n));
 }
 
-/*
- * Initialise clock module
- *	- Setup MCLK, ACLK, SMCLK dividers and clock sources
- *	- ACLK  = 0
- *	- MCLK  = 16 MHz internal oscillator
- *	- SMCLK = 16 MHz internal oscillator
- *
- * Note: We can also use the 2, 4, 8 or 16MHz crystal clock output from the MCP2515 CAN controller, which
- *       is a more accurate source than the internal oscillator.  However, using the internal
- *       source makes using sleep modes for both the MSP430 and the MCP2515 much simpler.
- */
-void clock_init( void )
-{
-	BCSCTL1 = CALBC1_16MHZ;
-	DCOCTL = CALDCO_16MHZ;
-}
-
 /*
  * Initialise I/O port directions and states
  *	- Drive unused pins as outputs to avoid floating inputs
@@ -615,7 +469,7 @@ void io_init( void )
 void timerA_init( void )
 {
 	TACTL = TASSEL_2 | ID_3 | TACLR;			// MCLK/8, clear TAR
-	TACCR0 = (INPUT_CLOCK/8/TICK_RATE);			// Set timer to count to this value = TICK_RATE overflow
+	TACCR0 = clock_tick_period;					// Set timer to count to this value = TICK_RATE overflow
 	TACCTL0 = CCIE;								// Enable CCR0 interrrupt
 	TACTL |= MC_1;								// Set timer to 'up' count mode
 }
@@ -661,7 +515,8 @@ void adc_init( void )
 	ADC12MCTL5 = INCH_6 | SREF_1;			// Reverse light current
 	ADC12MCTL6 = INCH_7 | SREF_1 | EOS;		// CAN Bus current / End of sequence
 	// Enable interrupts on final conversion in sequence
-	ADC12IE = BIT6;	
+	// Interrupt on each sense channel for output protection, and on channel 6 (end of sequence)
+	ADC12IE = BIT3 | BIT4 | BIT5 | BIT6;
 	// Enable conversions
 	ADC12CTL0 |= ENC;											
 }
@@ -669,18 +524,22 @@ void adc_init( void )
 /*
  * Timer B CCR0 Interrupt Service Routine
  *	- Interrupts on Timer B CCR0 match at GAUGE_FREQUENCY (10kHz)
+ *	- Works from its own copy of the gauge settings, latched from the pending settings when the main loop posts an update
  */
 interrupt(TIMERB0_VECTOR) timer_b0(void)
 {
 	static unsigned int gauge_count;
 	static unsigned int gauge1_on, gauge1_off;
 	static unsigned int gauge2_on, gauge2_off;
+	static unsigned int gauge1_period, gauge2_period;
 	
+	STACK_PROBE(STACK_TIMER_B);
+
 	// Toggle gauge 1 & 2 pulse frequency outputs
 	if(gauge_count == gauge1_on){
 		P4OUT |= GAUGE_1_OUT;
-		gauge1_on = gauge_count + gauge.g1_count;
-		gauge1_off = gauge_count + (gauge.g1_count >> 2);
+		gauge1_on = gauge_count + gauge1_period;
+		gauge1_off = gauge_count + (gauge1_period >> 2);
 	}
 	if(gauge_count == gauge1_off){
 		P4OUT &= ~GAUGE_1_OUT;
@@ -688,8 +547,8 @@ interrupt(TIMERB0_VECTOR) timer_b0(void)
 
 	if(gauge_count == gauge2_on){
 		P4OUT |= GAUGE_2_OUT;
-		gauge2_on = gauge_count + gauge.g2_count;
-		gauge2_off = gauge_count + (gauge.g2_count >> 2);
+		gauge2_on = gauge_count + gauge2_period;
+		gauge2_off = gauge_count + (gauge2_period >> 2);
 	}
 	if(gauge_count == gauge2_off){
 		P4OUT &= ~GAUGE_2_OUT;
@@ -701,9 +560,11 @@ interrupt(TIMERB0_VECTOR) timer_b0(void)
 	// Update outputs if necessary
 	if(events & EVENT_GAUGE1){
 		events &= ~EVENT_GAUGE1;
+		gauge1_period = gauge.g1_count;
 	}
 	if(events & EVENT_GAUGE2){
 		events &= ~EVENT_GAUGE2;
+		gauge2_period = gauge.g2_count;
 	}
 	if(events & EVENT_GAUGE3){
 		events &= ~EVENT_GAUGE3;
@@ -724,9 +585,14 @@ interrupt(TIMERA0_VECTOR) timer_a0(void)
 {
 	static unsigned char comms_count = COMMS_SPEED;
 	static unsigned char activity_count = 0;
-	
+
 	// Trigger timer based events
 	events |= EVENT_TIMER;	
+	tick_count++;
+	TACCR0 = clock_tick_period;					// Follows the measured clock, safe to change just after the match
+
+	// Check main loop deadlines and kick the watchdog
+	supervisor_tick();
 	
 	// Trigger comms events (command packet transmission)
 	comms_count--;
@@ -734,6 +600,7 @@ interrupt(TIMERA0_VECTOR) timer_a0(void)
 		comms_count = COMMS_SPEED;
 		events |= EVENT_COMMS;
 	}
+	comms_phase = COMMS_SPEED - comms_count;
 
 	// Check for CAN activity events and blink LED
 	if(events & EVENT_CAN_ACTIVITY){
@@ -751,59 +618,169 @@ interrupt(TIMERA0_VECTOR) timer_a0(void)
 
 /*
  * Collect switch inputs from hardware and fill out current state, and state changes
- *	- Inverts active low switches so that all bits in register are active high
+ *	- Samples ports 1 & 2 together as one 16-bit word and inverts active low switches, so all bits are active high
+ *	- Debounces every pin in parallel with 2-bit vertical counters: a pin must read the same for 4 calls
+ *	  (30 - 40ms at the ADC event rate) before its debounced state changes
+ *	- Maps debounced port bits onto the CAN switch layout a nibble at a time through lookup tables
+ *	- Leaves fault bits in the state untouched
  */
 void update_switches( unsigned int *state, unsigned int *difference)
 {
+	static const unsigned int map_p1_low[16] = SWITCH_MAP_TABLE( SW_FUEL, SW_BRAKE, SW_IGN_START, SW_IGN_ON );
+	static const unsigned int map_p1_high[16] = SWITCH_MAP_TABLE( SW_IGN_ACC, 0, 0, 0 );
+	static const unsigned int map_p2_low[16] = SWITCH_MAP_TABLE( SW_MODE_D, SW_MODE_B, SW_MODE_N, SW_MODE_R );
+	unsigned int sample, delta, mapped;
 	unsigned int old_switches;
 	
 	// Save state for difference tracking
 	old_switches = *state;
 
-	// Import switches into register
-	if(P2IN & IN_GEAR_4) *state |= SW_MODE_R;
-	else *state &= ~SW_MODE_R;
+	// Sample and debounce all inputs at once
+	sample = (P1IN | (P2IN << 8)) ^ SWITCH_ACTIVE_LOW;
+	delta = sample ^ switch_debounced;
+	switch_count1 = (switch_count1 ^ switch_count0) & delta;
+	switch_count0 = ~switch_count0 & delta;
+	switch_debounced ^= delta & ~(switch_count0 | switch_count1);
 
-	if(P2IN & IN_GEAR_3) *state |= SW_MODE_N;
-	else *state &= ~SW_MODE_N;
+	// Map port bits to switch bits
+	mapped = map_p1_low[switch_debounced & 0x0F]
+		   | map_p1_high[(switch_debounced >> 4) & 0x0F]
+		   | map_p2_low[(switch_debounced >> 8) & 0x0F];
 
-	if(P2IN & IN_GEAR_2) *state |= SW_MODE_B;
-	else *state &= ~SW_MODE_B;
+	// Ignition inputs are not wired, treat as always on
+	mapped |= SWITCH_FORCED_ON;
 
-	if(P2IN & IN_GEAR_1) *state |= SW_MODE_D;
-	else *state &= ~SW_MODE_D;
-	
-	//if(P1IN & IN_IGN_ACCn) *state &= ~SW_IGN_ACC;
-	//else 
-	*state |= SW_IGN_ACC;
-	
-	//if(P1IN & IN_IGN_ONn) *state &= ~SW_IGN_ON;
-	//else 
-	*state |= SW_IGN_ON;
+	*state = (*state & ~SWITCH_INPUTS) | mapped;
+
+	// Update changed switches
+	*difference = *state ^ old_switches;	
+}
 
-	if(P1IN & IN_IGN_STARTn) *state &= ~SW_IGN_START;
-	else *state |= SW_IGN_START;
+/*
+ * Whether the vehicle is stopped (EVENT_SLOW) in neutral or off, so the drive command can be held up
+ */
+static unsigned char __inline__ parked( void )
+{
+	return(((events & EVENT_SLOW) && ((command.state == MODE_N) || (command.state == MODE_OFF))) ? TRUE : FALSE);
+}
 
-	if(P1IN & IN_BRAKEn) *state &= ~SW_BRAKE;
-	else *state |= SW_BRAKE;
+/*
+ * Queue the reply to a bootload request that isn't safe to act on now
+ *	- Answered like the bootloader's PING, so the host tool sees the refusal where it waits for the bootloader
+ */
+void send_boot_refused( void )
+{
+	can_push_ptr->address = DC_CAN_BASE + DC_BOOT_REPLY;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u8[0] = BOOT_CMD_PING;
+	can_push_ptr->data.data_u8[1] = BOOT_ERROR_BUSY;
+	can_push_ptr->data.data_u16[1] = 0;
+	can_push_ptr->data.data_u32[1] = 0;
+	can_push();
+}
 
-	if(P1IN & IN_FUEL) *state |= SW_FUEL;
-	else *state &= ~SW_FUEL;
+/*
+ * Queue a telemetry record on the expansion UART
+ *	- The commands are the latest computed, DC_DRIVE only sends them on the comms event
+ */
+void send_telemetry( unsigned int switches )
+{
+	uart_telemetry record;
+
+	record.tick = tick_count;
+	record.pedal_a = ADC12MEM0;
+	record.pedal_b = ADC12MEM1;
+	record.slider_c = ADC12MEM2;
+	record.switches = switches;
+	record.state = command.state;
+	record.flags = command.flags;
+	record.current = command.current;
+	record.rpm = command.rpm;
+	record.bus_current = command.bus_current;
+	record.motor_rpm = motor_rpm;
+	record.battery_voltage = battery_voltage;
+	record.battery_current = battery_current;
+	record.can_state = can_state;
+	record.can_free = can_queue_free();
+	record.link = vehicle_link;
+	record.drops = uart_drops;
+	uart_send( UART_TELEMETRY, (unsigned char *)&record, sizeof(record) );
+}
 
-	// Update changed switches
-	*difference = *state ^ old_switches;	
+/*
+ * Wait for the supply rail to come up
+ *	- Uses the SVS to compare VCC against SUPPLY_SVS_LEVEL instead of waiting a fixed time
+ *	- Then arms the SVS to reset on a brownout, so a sagging supply always restarts through here
+ */
+void supply_wait( void )
+{
+	SVSCTL = SUPPLY_SVS_LEVEL;					// Start the SVS, no reset yet
+	while(!(SVSCTL & SVSON));					// SVS settling
+	while(SVSCTL & SVSOP);						// VCC below level
+	SVSCTL &= ~SVSFG;							// Clear the flag left from power up
+	SVSCTL |= PORON;							// Brownout now causes a POR
+}
+
+/*
+ * Time since Timer A started, ms
+ */
+unsigned int startup_time( void )
+{
+	unsigned int ticks, count;
+
+	dint();
+	ticks = tick_count;
+	count = TAR;
+	if(TACCTL0 & CCIFG){						// Tick pending, TAR has already wrapped
+		ticks++;
+		count = TAR;
+	}
+	eint();
+	return(ticks * (1000 / TICK_RATE) + count / (INPUT_CLOCK / 8 / 1000));
+}
+
+/*
+ * Queue a startup timing frame
+ *	- Also carries the reset cause and, after a watchdog reset, the stage that missed its deadline
+ */
+void send_startup( void )
+{
+	can_push_ptr->address = DC_CAN_BASE + DC_STARTUP;
+	can_push_ptr->status = 8;
+	can_push_ptr->data.data_u16[0] = startup_drive_ms;
+	can_push_ptr->data.data_u16[1] = startup_supply_ms;
+	can_push_ptr->data.data_u8[4] = supervisor_reset;
+	can_push_ptr->data.data_u8[5] = supervisor_last.stage;
+	can_push_ptr->data.data_u8[6] = supervisor_last.age;
+	can_push_ptr->data.data_u8[7] = supervisor_last.spi_timeouts;
+	can_push();
 }
 
 /*
  * ADC12 Interrupt Service Routine
- *	- Interrupts on channel 6 conversion (end of sequence)
+ *	- Interrupts on each sense channel conversion (3 - 6) for output protection
+ *	- Channel 6 is also the end of sequence
+ *	- Reading ADC12MEMx clears its interrupt flag
  */
 interrupt(ADC12_VECTOR) adc_isr(void)
 {
-	// Clear ISR flag
-	ADC12IFG &= ~BIT6;
-	// Trigger ADC event in main loop
-	events |= EVENT_ADC;
+	switch(ADC12IV){
+		case ADC12IV_MEM(3):
+			protect_sample(PROTECT_SUPPLY, ADC12MEM3);
+			break;
+		case ADC12IV_MEM(4):
+			protect_sample(PROTECT_BRAKE, ADC12MEM4);
+			break;
+		case ADC12IV_MEM(5):
+			protect_sample(PROTECT_REVERSE, ADC12MEM5);
+			break;
+		case ADC12IV_MEM(6):
+			protect_sample(PROTECT_CAN_PWR, ADC12MEM6);
+			TRACE_MARK(TRACE_ADC_DONE);
+			// Trigger ADC event in main loop
+			events |= EVENT_ADC;
+			break;
+	}
 }
 
 
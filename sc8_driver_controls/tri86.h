@@ -75,9 +75,44 @@
 // #define USE_EGEAR			// Use series/parallel contactor changeover controller
 #define REGEN_ON_BRAKE		// Use brake pedal to trigger regen, with amount set by Analog C input
 // #define CUTOUT_ON_BRAKE		// Cut throttle on brake pedal active (solarcar preference to avoid dragging brakes)
+// #define USE_CAN_AUTOBAUD	// Detect CAN bitrate from bus traffic at startup, falls back to CAN_BITRATE_500
+#define CLOCK_SOURCE		CLOCK_TRIM	// CLOCK_DCO, CLOCK_TRIM or CLOCK_CRYSTAL, see clock.h
+// #define USE_PROFILE			// Time the main loop hot paths against cycle budgets, read with tools/dcprof
+#define MC_COUNT			1			// Motor controllers on the bus, bases in can.h
+#define MC_SPLIT			{ 1.0, 1.0 }	// Torque split: each motor controller's share, relative to the largest, see below
+// #define USE_COMPACT_TELEMETRY	// Send packed DC_STATUS in place of DC_SWITCH and the periodic ID frame, see can.h
+// #define USE_TRACE			// Trace pedal samples through to their DC_DRIVE frame on the bus, read with tools/dctrace
+// #define USE_UART_TELEMETRY	// Stream binary records on the expansion UART every ADC event, see uart.h, read with tools/dcuart
+
+// Torque split, one share per motor controller, in the order of the bases in can.h
+//	- DC_DRIVE current is a percentage of each controller's own current limit, so a share scales that controller's
+//	  torque, not its part of a total: drive_init() divides the first MC_COUNT shares by the largest, so the controller
+//	  with the largest share gets the whole pedal command and an even split gives every controller all of it
+//	- DC_POWER bus current follows the same rule, as a percentage of each controller's own bus current limit: configure
+//	  those limits in the controllers as their part of the pack's current, so together they stay within it
+
+// Supply supervision: VCC must be above this SVS level (VLD = 1010, 3.05V) before switching to 16MHz
+#define SUPPLY_SVS_LEVEL	0xA0
 
 // Device serial number
-#define DEVICE_ID		0x1002
+#define DEVICE_ID_DEFAULT	0x1002
+#define DEVICE_ID			(param_value[PARAM_DEVICE_ID].data_u16[0])
+
+// Switch input handling
+// Ports 1 & 2 are sampled together as one word, port 1 in the low byte
+#define SWITCH_ACTIVE_LOW	(IN_BRAKEn | IN_IGN_STARTn | IN_IGN_ONn | IN_IGN_ACCn)
+#define SWITCH_INPUTS		(SW_MODE_R | SW_MODE_N | SW_MODE_B | SW_MODE_D | SW_IGN_ACC | SW_IGN_ON | SW_IGN_START | SW_BRAKE | SW_FUEL)
+#define SWITCH_FORCED_ON	(SW_IGN_ACC | SW_IGN_ON)
+// Builds a 16 entry table mapping a nibble of port bits to switch bits
+#define SWITCH_MAP(n, a, b, c, d)	((((n) & 0x01) ? (a) : 0) | (((n) & 0x02) ? (b) : 0) | (((n) & 0x04) ? (c) : 0) | (((n) & 0x08) ? (d) : 0))
+#define SWITCH_MAP_TABLE(a, b, c, d)	{ \
+	SWITCH_MAP( 0, a, b, c, d), SWITCH_MAP( 1, a, b, c, d), SWITCH_MAP( 2, a, b, c, d), SWITCH_MAP( 3, a, b, c, d), \
+	SWITCH_MAP( 4, a, b, c, d), SWITCH_MAP( 5, a, b, c, d), SWITCH_MAP( 6, a, b, c, d), SWITCH_MAP( 7, a, b, c, d), \
+	SWITCH_MAP( 8, a, b, c, d), SWITCH_MAP( 9, a, b, c, d), SWITCH_MAP(10, a, b, c, d), SWITCH_MAP(11, a, b, c, d), \
+	SWITCH_MAP(12, a, b, c, d), SWITCH_MAP(13, a, b, c, d), SWITCH_MAP(14, a, b, c, d), SWITCH_MAP(15, a, b, c, d) }
+
+// ADC12IV value for a conversion complete in ADC12MEMn
+#define ADC12IV_MEM(n)		(0x06 + ((n) << 1))
 
 // Constant Definitions
 #define	TRUE				1
@@ -105,12 +140,25 @@
 #define MODE_CO_DH			14
 
 // Event timing
-#define INPUT_CLOCK			16000000			// Hz
+#define INPUT_CLOCK			16000000			// Hz, nominal, clock_hz has the measured value
 #define TICK_RATE			100					// Hz
 #define COMMS_SPEED			10					// Number of ticks per event: 10 ticks = 100ms = 10 Hz
+
+// Comms schedule: DC_DRIVE goes out on the comms event, the other periodic frames at a fixed tick offset after it,
+// so they are spread over the period instead of queued in one burst
+#define SCHED_POWER			2					// DC_POWER
+#define SCHED_SWITCH		4					// DC_SWITCH
+#define SCHED_EGEAR			6					// EG_COMMAND
+#define SCHED_ID			8					// DC_CAN_BASE ID frame, every SCHED_ID_PERIODS periods = 1/second
+#define SCHED_ID_PERIODS	10
 #define CHARGE_FLASH_SPEED	20					// LED flash rate in charge mode: 20 ticks = 200ms = 5 Hz
 #define ACTIVITY_SPEED		2					// LED flash period for CAN activity: 2 ticks = 20ms
 
+// Startup sequence
+#define STARTUP_SUPPLY		0					// Waiting for the 5V pedal supply to come into range
+#define STARTUP_READY		1					// Pedal inputs live, first drive command not yet sent
+#define STARTUP_DONE		2
+
 // Event definitions
 #define EVENT_TIMER			0x0001				// Timer went off
 #define EVENT_COMMS			0x0002				// Time to transmit telemetry
@@ -130,14 +178,21 @@
 #define EVENT_GAUGE4		0x8000				// Signal that gauge 4 has been recalculated and requires update
 
 // Control parameters
-#define ENGAGE_VEL_F		50					// Don't allow drive direction change above this speed, rpm
-#define ENGAGE_VEL_R		-50					// Don't allow drive direction change above this speed, rpm
-#define REGEN_THRESHOLD		-5					// Brake lights come on above this motor current, A
-#define CHANGE_VEL_LTOH		1800				// Shift up (if using egear) above this speed, rpm
-#define CHANGE_VEL_HTOL		1600				// Shift down (if using egear) below this speed, rpm
+// Defaults only, tunable values are read from the parameter store RAM copy (see param.h)
+#define ENGAGE_VEL_F_DEFAULT	50				// Don't allow drive direction change above this speed, rpm
+#define ENGAGE_VEL_R_DEFAULT	-50				// Don't allow drive direction change above this speed, rpm
+#define REGEN_THRESHOLD_DEFAULT	-5				// Brake lights come on above this motor current, A
+#define CHANGE_VEL_LTOH_DEFAULT	1800			// Shift up (if using egear) above this speed, rpm
+#define CHANGE_VEL_HTOL_DEFAULT	1600			// Shift down (if using egear) below this speed, rpm
+#define ENGAGE_VEL_F		(param_value[PARAM_ENGAGE_VEL_F].data_16[0])
+#define ENGAGE_VEL_R		(param_value[PARAM_ENGAGE_VEL_R].data_16[0])
+#define REGEN_THRESHOLD		(param_value[PARAM_REGEN_THRESHOLD].data_16[0])
+#define CHANGE_VEL_LTOH		(param_value[PARAM_CHANGE_VEL_LTOH].data_16[0])
+#define CHANGE_VEL_HTOL		(param_value[PARAM_CHANGE_VEL_HTOL].data_16[0])
 
 // Public variables
 volatile unsigned int events;
+extern volatile unsigned int tick_count;		// Timer A ticks since startup, wraps
 
 // Typedefs for quickly joining multiple bytes/ints/etc into larger values
 // These rely on byte ordering in CPU & memory - i.e. they're not portable across architectures
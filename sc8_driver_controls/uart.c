@@ -0,0 +1,157 @@
+/*
+ * Tritium expansion UART telemetry
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Streams framed, CRC checked binary records out of the expansion connector TXD pin on USCI_A0
+ * - Records are copied into a transmit ring and sent a byte at a time from the TX interrupt, so
+ *   queueing one costs the main loop a copy and a CRC, never a wait on the line
+ * - A record that won't fit in the ring is dropped whole and counted, the stream never carries a partial frame
+ * - Only built with USE_UART_TELEMETRY in tri86.h, so the ring and the USCI vector cost nothing otherwise
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include <signal.h>
+#include "tri86.h"
+#include "clock.h"
+#include "stack.h"
+#include "uart.h"
+
+#ifdef USE_UART_TELEMETRY
+
+// Public variables
+unsigned char uart_drops = 0;
+
+// Private variables
+unsigned char uart_ring[UART_RING_LEN];
+volatile unsigned char uart_head = 0;			// Next free byte, only moved by the main loop
+volatile unsigned char uart_tail = 0;			// Next byte to send, only moved by the ISR
+unsigned char uart_sequence = 0;
+
+// Private function prototypes
+unsigned int uart_crc( unsigned int crc, unsigned char data );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Initialise USCI_A0 as a UART on the expansion connector
+ *	- Call once the clock has settled, the divider comes from clock_hz
+ *	- Low frequency baud generation: BR = SMCLK / UART_BAUD, with the remainder in eighths in UCBRSx
+ */
+void uart_init( void )
+{
+	unsigned long divider;
+
+	divider = ( clock_hz * 8 + UART_BAUD / 2 ) / UART_BAUD;
+	UCA0CTL1 = UCSSEL_2 | UCSWRST;						// BRCLK = SMCLK, hold in reset
+	UCA0CTL0 = 0x00;									// 8N1, LSB first, UART mode
+	UCA0BR0 = (unsigned char)( divider >> 3 );
+	UCA0BR1 = (unsigned char)( divider >> 11 );
+	UCA0MCTL = (unsigned char)(( divider & 0x07 ) << 1 );	// UCBRSx
+	P3SEL |= EXPANSION_TXD | EXPANSION_RXD;				// Pins to the USCI, not GPIO
+	UCA0CTL1 &= ~UCSWRST;								// Initialize USCI state machine
+}
+
+/*
+ * Queue a record
+ *	- Frames it with sync, length, type, sequence and CRC, see uart.h
+ *	- Returns FALSE, and counts a drop, if the whole frame doesn't fit in the ring
+ */
+char uart_send( unsigned char type, unsigned char *data, unsigned char length )
+{
+	unsigned char head, space, i;
+	unsigned int crc;
+
+	head = uart_head;
+	space = ( uart_tail - head - 1 ) & UART_RING_MASK;
+	if( (unsigned int)length + UART_OVERHEAD > space ){
+		if( uart_drops != 0xFF ) uart_drops++;
+		return( FALSE );
+	}
+
+	uart_ring[head] = UART_SYNC_1;
+	head = ( head + 1 ) & UART_RING_MASK;
+	uart_ring[head] = UART_SYNC_2;
+	head = ( head + 1 ) & UART_RING_MASK;
+	crc = uart_crc( 0xFFFF, length );
+	uart_ring[head] = length;
+	head = ( head + 1 ) & UART_RING_MASK;
+	crc = uart_crc( crc, type );
+	uart_ring[head] = type;
+	head = ( head + 1 ) & UART_RING_MASK;
+	crc = uart_crc( crc, uart_sequence );
+	uart_ring[head] = uart_sequence;
+	head = ( head + 1 ) & UART_RING_MASK;
+	for( i = 0; i < length; i++ ){
+		crc = uart_crc( crc, data[i] );
+		uart_ring[head] = data[i];
+		head = ( head + 1 ) & UART_RING_MASK;
+	}
+	uart_ring[head] = (unsigned char)crc;
+	head = ( head + 1 ) & UART_RING_MASK;
+	uart_ring[head] = (unsigned char)( crc >> 8 );
+	head = ( head + 1 ) & UART_RING_MASK;
+	uart_sequence++;
+
+	// Publish the frame, then make sure the transmitter is running
+	// The ISR only turns itself off with the ring empty, and it can't be empty after this store
+	uart_head = head;
+	IE2 |= UCA0TXIE;
+	return( TRUE );
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * CRC-16 CCITT, one byte on from crc
+ *	- Same polynomial as the bootloader, which can't be called from here
+ */
+unsigned int uart_crc( unsigned int crc, unsigned char data )
+{
+	unsigned char bit;
+
+	crc ^= ((unsigned int)data << 8);
+	for( bit = 0; bit < 8; bit++ ){
+		if( crc & 0x8000 ) crc = ( crc << 1 ) ^ 0x1021;
+		else crc = crc << 1;
+	}
+	return( crc );
+}
+
+/*
+ * USCI transmit interrupt
+ *	- Shared with USCI_B0, whose SPI transfers to the CAN controller are polled with its interrupts off
+ *	- Sends the next byte in the ring, and turns itself off once it is empty
+ */
+interrupt(USCIAB0TX_VECTOR) uart_tx_isr(void)
+{
+	STACK_PROBE(STACK_UART);
+	if( uart_tail != uart_head ){
+		UCA0TXBUF = uart_ring[uart_tail];
+		uart_tail = ( uart_tail + 1 ) & UART_RING_MASK;
+	}
+	else IE2 &= ~UCA0TXIE;
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Tritium expansion UART telemetry header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following expansion UART functions:
+ *	- uart_init
+ *	- uart_send
+ *
+ */
+
+// Public function prototypes
+extern void uart_init( void );
+extern char uart_send( unsigned char type, unsigned char *data, unsigned char length );
+
+// Public variables
+extern unsigned char uart_drops;
+
+// Line settings: 8N1 on USCI_A0, from SMCLK, any rate the USB serial adapter or radio supports
+#define UART_BAUD				230400
+#define UART_RING_LEN			128				// Transmit ring bytes, power of two
+#define UART_RING_MASK			(UART_RING_LEN - 1)
+
+// Framing, bytes
+//	0xA5 0x5A, length, type, sequence, payload[length], CRC low, CRC high
+//	CRC-16 CCITT (0x1021, initial 0xFFFF) over length, type, sequence and payload
+//	There's no byte stuffing: a receiver hunts for the sync pair and keeps the frame if the CRC checks
+#define UART_SYNC_1				0xA5
+#define UART_SYNC_2				0x5A
+#define UART_OVERHEAD			7
+
+// Record types
+#define UART_TELEMETRY			0x01			// uart_telemetry, every ADC event (100Hz)
+
+// Telemetry record, little endian, no padding, decoded by tools/dcuart
+typedef struct _uart_telemetry {
+	unsigned int tick;							// tick_count
+	unsigned int pedal_a;						// Raw ADC
+	unsigned int pedal_b;
+	unsigned int slider_c;
+	unsigned int switches;						// As in DC_SWITCH
+	unsigned char state;						// command.state
+	unsigned char flags;						// command.flags
+	float current;								// Commands as sent in DC_DRIVE and DC_POWER
+	float rpm;
+	float bus_current;
+	float motor_rpm;							// From the motor controllers
+	float battery_voltage;
+	float battery_current;
+	unsigned char can_state;					// CAN_STATE_xxx
+	unsigned char can_free;						// Free transmit queue entries
+	unsigned char link;							// vehicle_link
+	unsigned char drops;						// Records dropped on a full ring, saturates at 255
+} uart_telemetry;
@@ -30,6 +30,12 @@
 #include "tri86.h"
 #include "usci.h"
 
+// Public variables
+unsigned int usci_timeouts = 0;
+
+// Private function prototypes
+void usci_recover( void );
+
 /*
  * Initialise SPI port
  * 	- Master, 8 bits, mode 0:0, max speed, 3 wire
@@ -50,7 +56,7 @@ void usci_init( unsigned char clock )
 
 /*
  * Transmits data on SPI connection
- *	- Busy waits until entire shift is complete
+ *	- Busy waits until entire shift is complete, or USCI_TIMEOUT
  *	- On devices with hardware SPI support, this function is identical to spi_exchange,
  *	  with the execption of not returning a value
  *	- On devices with software (bit-bashed) SPI support, this function can run faster
@@ -58,19 +64,42 @@ void usci_init( unsigned char clock )
  */
 void usci_transmit( unsigned char data )
 {
+	unsigned int i;
+
 	UCB0TXBUF = data;
-	while(( IFG2 & UCB0RXIFG ) == 0x00 );			// Wait for Rx completion (implies Tx is also complete)
-	UCB0RXBUF;
+	for( i = 0; i < USCI_TIMEOUT; i++ ){			// Wait for Rx completion (implies Tx is also complete)
+		if( IFG2 & UCB0RXIFG ){
+			UCB0RXBUF;
+			return;
+		}
+	}
+	usci_recover();
 }
 
 /*
  * Exchanges data on SPI connection
- *	- Busy waits until entire shift is complete
+ *	- Busy waits until entire shift is complete, or USCI_TIMEOUT (returns 0xFF)
  *	- This function is safe to use to control hardware lines that rely on shifting being finalised
  */
 unsigned char usci_exchange( unsigned char data )
 {
+	unsigned int i;
+
 	UCB0TXBUF = data;
-	while(( IFG2 & UCB0RXIFG ) == 0x00 );			// Wait for Rx completion (implies Tx is also complete)
-	return( UCB0RXBUF );
+	for( i = 0; i < USCI_TIMEOUT; i++ ){			// Wait for Rx completion (implies Tx is also complete)
+		if( IFG2 & UCB0RXIFG ) return( UCB0RXBUF );
+	}
+	usci_recover();
+	return( 0xFF );
+}
+
+/*
+ * Abandons a stuck transfer
+ *	- Counts it, and resets the USCI state machine so the next transfer starts clean
+ */
+void usci_recover( void )
+{
+	usci_timeouts++;
+	UCB0CTL1 |= UCSWRST;
+	UCB0CTL1 &= ~UCSWRST;
 }
@@ -11,4 +11,10 @@ extern 	void 			usci_init( unsigned char clock );
 extern 	void			usci_transmit( unsigned char data );
 extern 	unsigned char 	usci_exchange( unsigned char data );
 
+// Public variables
+extern	unsigned int	usci_timeouts;
+
+// Give up on a transfer after this many status polls, approx 30us against 1us per byte at SMCLK/2
+#define USCI_TIMEOUT	100
+
 // Private Function prototypes
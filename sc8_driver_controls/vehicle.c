@@ -0,0 +1,278 @@
+/*
+ * Tritium vehicle data
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Decodes motor controller and eGear controller frames from the CAN receive dispatch
+ * - Keeps the speed threshold and regen event flags, and the gauge outputs, up to date
+ * - Caches the latest payload of each message with its arrival tick, and drops anything derived from
+ *   a message once it goes stale, so the state machine and gauges never act on old data
+ * - Handles MC_COUNT motor controllers, each at its own base, and combines their data
+ * - Losing the velocity message from any motor controller counts as losing the link
+ *
+ */
+
+// Include files
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "param.h"
+#include "gauge.h"
+#include "atomic.h"
+#include "egear.h"
+#include "profile.h"
+#include "vehicle.h"
+
+// Public variables
+float motor_rpm = 0;
+float motor_temp = 0;
+float controller_temp = 0;
+float battery_voltage = 0;
+float battery_current = 0;
+unsigned char current_egear = EG_STATE_NEUTRAL;
+vehicle_entry vehicle_cache[VEHICLE_SLOTS];
+unsigned char vehicle_link = FALSE;
+const unsigned int vehicle_base[MC_MAX] = MC_CAN_BASES;
+
+// Private variables
+const unsigned char vehicle_offset[VEHICLE_MC_MESSAGES] = {
+	MC_VELOCITY, MC_I_VECTOR, MC_TEMP1, MC_LIMITS, MC_BUS
+};
+const unsigned int vehicle_timeout[VEHICLE_MC_MESSAGES + 1] = {
+	VEHICLE_VELOCITY_TIMEOUT, VEHICLE_I_VECTOR_TIMEOUT, VEHICLE_TEMP1_TIMEOUT,
+	VEHICLE_LIMITS_TIMEOUT, VEHICLE_BUS_TIMEOUT, VEHICLE_EG_STATUS_TIMEOUT
+};
+// Per controller: regen and neutral flags, one bit each
+unsigned char vehicle_regen = 0x00;
+unsigned char vehicle_neutral = 0x00;
+
+// Private function prototypes
+void vehicle_combine( unsigned char message );
+char vehicle_fresh( unsigned char mc, unsigned char message );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Processes a received frame
+ *	- Returns TRUE if the frame was from a motor or eGear controller, FALSE to leave it for the caller
+ */
+char vehicle_receive( void )
+{
+	unsigned char mc, message, slot;
+
+	// Find the sender and message
+	for( mc = 0; mc < MC_COUNT; mc++ ){
+		if(( can.address >= vehicle_base[mc] ) && ( can.address < vehicle_base[mc] + 0x20 )) break;
+	}
+	if( mc < MC_COUNT ){
+		for( message = 0; message < VEHICLE_MC_MESSAGES; message++ ){
+			if( can.address == vehicle_base[mc] + vehicle_offset[message] ) break;
+		}
+		if( message == VEHICLE_MC_MESSAGES ) return( FALSE );
+		slot = VEHICLE_SLOT( mc, message );
+	}
+	else if( can.address == EG_CAN_BASE + EG_STATUS ){
+		message = VEHICLE_EG_STATUS;
+		slot = VEHICLE_EG_SLOT;
+	}
+	else return( FALSE );
+
+	// Cache the payload with its arrival time
+	vehicle_cache[slot].data = can.data;
+	vehicle_cache[slot].stamp = tick_count;
+	vehicle_cache[slot].fresh = TRUE;
+
+	switch( message ){
+		case VEHICLE_I_VECTOR:
+			// Update regen status flags
+			if(can.data.data_fp[0] < REGEN_THRESHOLD) vehicle_regen |= (1 << mc);
+			else vehicle_regen &= ~(1 << mc);
+			break;
+		case VEHICLE_LIMITS:
+			// Update neutral state of motor controller
+			if(can.data.data_u8[0] == 0) vehicle_neutral |= (1 << mc);
+			else vehicle_neutral &= ~(1 << mc);
+			break;
+		case VEHICLE_EG_STATUS:
+			if ( can.data.data_u8[0] == EG_STATE_NEUTRAL ) current_egear = EG_STATE_NEUTRAL;
+			else if ( can.data.data_u8[0] == EG_STATE_LOW ) current_egear = EG_STATE_LOW;
+			else if ( can.data.data_u8[0] == EG_STATE_HIGH ) current_egear = EG_STATE_HIGH;
+			break;
+	}
+	vehicle_combine( message );
+#ifdef USE_EGEAR
+	// Changeover steps wait on these, take them straight away
+	if(( message == VEHICLE_LIMITS ) || ( message == VEHICLE_EG_STATUS )) egear_update();
+#endif
+	return( TRUE );
+}
+
+/*
+ * Ages the cache
+ *	- Call every tick
+ *	- Returns TRUE on the tick the motor controller link is lost
+ */
+char vehicle_tick( void )
+{
+	unsigned char slot, message, link;
+
+	link = vehicle_link;
+	for( slot = 0; slot < VEHICLE_SLOTS; slot++ ){
+		if( slot == VEHICLE_EG_SLOT ) message = VEHICLE_EG_STATUS;
+		else message = slot % VEHICLE_MC_MESSAGES;
+		if(( vehicle_cache[slot].fresh == TRUE ) && (( tick_count - vehicle_cache[slot].stamp ) > vehicle_timeout[message] )){
+			vehicle_cache[slot].fresh = FALSE;
+			vehicle_combine( message );
+		}
+	}
+	return(( link == TRUE ) && ( vehicle_link == FALSE ));
+}
+
+/*
+ * Ticks since a message was last received
+ *	- From whichever motor controller sent it most recently
+ *	- Returns VEHICLE_AGE_UNKNOWN if it never was, or has gone stale everywhere
+ */
+unsigned int vehicle_age( unsigned char message )
+{
+	unsigned int age, youngest;
+	unsigned char mc;
+
+	if( message == VEHICLE_EG_STATUS ){
+		if( vehicle_cache[VEHICLE_EG_SLOT].fresh == FALSE ) return( VEHICLE_AGE_UNKNOWN );
+		return( tick_count - vehicle_cache[VEHICLE_EG_SLOT].stamp );
+	}
+	youngest = VEHICLE_AGE_UNKNOWN;
+	for( mc = 0; mc < MC_COUNT; mc++ ){
+		if( vehicle_fresh( mc, message ) == FALSE ) continue;
+		age = tick_count - vehicle_cache[VEHICLE_SLOT( mc, message )].stamp;
+		if( age < youngest ) youngest = age;
+	}
+	return( youngest );
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Works out the combined data, event flags and gauges from every motor controller whose data isn't stale
+ *	- Call after a message arrives or goes stale
+ *	- With no velocity, no speed band is asserted, so the state machine won't engage or change direction
+ */
+void vehicle_combine( unsigned char message )
+{
+	unsigned char mc, count, all;
+	float rpm, voltage, current;
+	group_64 *data;
+
+	count = 0;
+	all = TRUE;
+	rpm = 0;
+	voltage = 0;
+	current = 0;
+	switch( message ){
+		case VEHICLE_VELOCITY:
+			for( mc = 0; mc < MC_COUNT; mc++ ){
+				if( vehicle_fresh( mc, message ) == FALSE ) all = FALSE;
+				else{
+					rpm += vehicle_cache[VEHICLE_SLOT( mc, message )].data.data_fp[0];
+					count++;
+				}
+			}
+			if( count == 0 ){
+				event_clear( EVENT_FORWARD | EVENT_REVERSE | EVENT_SLOW | EVENT_OVER_VEL_LTOH | EVENT_OVER_VEL_HTOL );
+				motor_rpm = 0;
+			}
+			else{
+				// Update speed threshold event flags from the average speed
+				motor_rpm = rpm / count;
+				if(motor_rpm > ENGAGE_VEL_F) event_post(EVENT_FORWARD);
+				else event_clear(EVENT_FORWARD);
+				if(motor_rpm < ENGAGE_VEL_R) event_post(EVENT_REVERSE);
+				else event_clear(EVENT_REVERSE);
+				if((motor_rpm >= ENGAGE_VEL_R) && (motor_rpm <= ENGAGE_VEL_F)) event_post(EVENT_SLOW);
+				else event_clear(EVENT_SLOW);
+				if(motor_rpm >= CHANGE_VEL_LTOH) event_post(EVENT_OVER_VEL_LTOH);
+				else event_clear(EVENT_OVER_VEL_LTOH);
+				if(motor_rpm >= CHANGE_VEL_HTOL) event_post(EVENT_OVER_VEL_HTOL);
+				else event_clear(EVENT_OVER_VEL_HTOL);
+			}
+			vehicle_link = all;
+			PROFILE_START(PROFILE_GAUGE);
+			gauge_tach_update( motor_rpm );
+			PROFILE_STOP(PROFILE_GAUGE);
+			break;
+		case VEHICLE_I_VECTOR:
+			// Brake lights if any controller is regenning
+			for( mc = 0; mc < MC_COUNT; mc++ ){
+				if(( vehicle_fresh( mc, message ) == TRUE ) && ( vehicle_regen & (1 << mc))) count++;
+			}
+			if( count != 0 ) event_post( EVENT_REGEN );
+			else event_clear( EVENT_REGEN );
+			break;
+		case VEHICLE_TEMP1:
+			// Update data for temp gauge, hottest of each
+			motor_temp = 0;
+			controller_temp = 0;
+			for( mc = 0; mc < MC_COUNT; mc++ ){
+				if( vehicle_fresh( mc, message ) == FALSE ) continue;
+				data = &vehicle_cache[VEHICLE_SLOT( mc, message )].data;
+				if( data->data_fp[1] > controller_temp ) controller_temp = data->data_fp[1];
+				if( data->data_fp[0] > motor_temp ) motor_temp = data->data_fp[0];
+			}
+			gauge_temp_update( motor_temp, controller_temp );
+			break;
+		case VEHICLE_LIMITS:
+			// Only neutral once every controller is
+			for( mc = 0; mc < MC_COUNT; mc++ ){
+				if(( vehicle_fresh( mc, message ) == FALSE ) || !( vehicle_neutral & (1 << mc))) all = FALSE;
+			}
+			if( all == TRUE ) event_post( EVENT_MC_NEUTRAL );
+			else event_clear( EVENT_MC_NEUTRAL );
+			break;
+		case VEHICLE_BUS:
+			// Update battery voltage and current for fuel and power gauges, one pack shared by all controllers
+			for( mc = 0; mc < MC_COUNT; mc++ ){
+				if( vehicle_fresh( mc, message ) == FALSE ) continue;
+				data = &vehicle_cache[VEHICLE_SLOT( mc, message )].data;
+				voltage += data->data_fp[0];
+				current += data->data_fp[1];
+				count++;
+			}
+			if( count != 0 ) voltage = voltage / count;
+			battery_voltage = voltage;
+			battery_current = current;
+			gauge_power_update( battery_voltage, battery_current );
+			gauge_fuel_update( battery_voltage );
+			break;
+		case VEHICLE_EG_STATUS:
+			if( vehicle_cache[VEHICLE_EG_SLOT].fresh == FALSE ) current_egear = EG_STATE_NEUTRAL;
+			break;
+	}
+}
+
+/*
+ * Whether a motor controller's message is in the cache and not stale
+ */
+char vehicle_fresh( unsigned char mc, unsigned char message )
+{
+	return( vehicle_cache[VEHICLE_SLOT( mc, message )].fresh );
+}
@@ -0,0 +1,77 @@
+/*
+ * Tritium vehicle data header
+ * Copyright (c) 2010, Tritium Pty Ltd.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *	- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *	  in the documentation and/or other materials provided with the distribution.
+ *	- Neither the name of Tritium Pty Ltd nor the names of its contributors may be used to endorse or promote products
+ *	  derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * - Implements the following vehicle data functions:
+ *	- vehicle_receive
+ *	- vehicle_tick
+ *	- vehicle_age
+ *
+ */
+
+// Public function prototypes
+extern char vehicle_receive( void );
+extern char vehicle_tick( void );
+extern unsigned int vehicle_age( unsigned char message );
+
+// Telemetry cache entry, latest payload of one message ID and the tick it arrived
+typedef struct _vehicle_entry {
+	group_64 data;
+	unsigned int stamp;							// tick_count on arrival
+	unsigned char fresh;						// FALSE until received, and again once older than its timeout
+} vehicle_entry;
+
+// Public variables
+// Data from motor controllers, combined from those not stale: average speed, highest temperatures,
+// average bus voltage and total bus current
+extern float motor_rpm;
+extern float motor_temp;
+extern float controller_temp;
+extern float battery_voltage;
+extern float battery_current;
+// Data from eGear controller
+extern unsigned char current_egear;
+// Telemetry cache, and the motor controller link state (every controller's velocity fresh)
+extern vehicle_entry vehicle_cache[];
+extern unsigned char vehicle_link;
+extern const unsigned int vehicle_base[];
+
+// Cached messages
+#define VEHICLE_VELOCITY			0			// MC_VELOCITY
+#define VEHICLE_I_VECTOR			1			// MC_I_VECTOR
+#define VEHICLE_TEMP1				2			// MC_TEMP1
+#define VEHICLE_LIMITS				3			// MC_LIMITS
+#define VEHICLE_BUS					4			// MC_BUS
+#define VEHICLE_MC_MESSAGES			5			// Per motor controller
+#define VEHICLE_EG_STATUS			5			// EG_STATUS
+
+// Cache slots, one per message per motor controller, then EG_STATUS
+#define VEHICLE_SLOT(mc, message)	((mc) * VEHICLE_MC_MESSAGES + (message))
+#define VEHICLE_EG_SLOT				(MC_COUNT * VEHICLE_MC_MESSAGES)
+#define VEHICLE_SLOTS				(VEHICLE_EG_SLOT + 1)
+
+// Staleness timeouts, ticks since the last frame: the motor controller broadcasts every 200ms, temperatures every 1s
+#define VEHICLE_VELOCITY_TIMEOUT	50
+#define VEHICLE_I_VECTOR_TIMEOUT	50
+#define VEHICLE_TEMP1_TIMEOUT		300
+#define VEHICLE_LIMITS_TIMEOUT		50
+#define VEHICLE_BUS_TIMEOUT			50
+#define VEHICLE_EG_STATUS_TIMEOUT	50
+// vehicle_age() of a message that is stale or was never received
+#define VEHICLE_AGE_UNKNOWN			0xFFFF
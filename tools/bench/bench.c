@@ -0,0 +1,282 @@
+/*
+ * Driver controls hot path benchmark, MSP430 side
+ *
+ * Runs the firmware's own process_pedal() (pedal.c), drive_state() (drive.c), can_receive() decode
+ * (can.c) with the vehicle_receive() dispatch (vehicle.c), and gauge_tach_update() (gauge.c), built
+ * for the MSP430F247 with the firmware's compiler options, through a fixed set of input scenarios.
+ * It runs under the mspdebug instruction set simulator, driven by tools/dcbench, which stops on
+ * bench_mark() either side of each call and reads the simulator's MCLK count.
+ *
+ * Peripherals are stubbed: the MCP2515 is a byte script fed to can.c through usci_exchange(), other
+ * register writes land in simulator memory, and parameters are the compiled-in defaults from param.c.
+ *
+ * Build, from the repository root, with the options in sc8_driver_controls/Release:
+ *		msp430-gcc -mmcu=msp430x247 -O3 -Wall -Isc8_driver_controls -o bench.elf tools/bench/bench.c \
+ *			sc8_driver_controls/pedal.c sc8_driver_controls/drive.c sc8_driver_controls/can.c \
+ *			sc8_driver_controls/vehicle.c sc8_driver_controls/gauge.c sc8_driver_controls/atomic.c \
+ *			sc8_driver_controls/param.c
+ *
+ * Scenarios are numbered in the order of the tables below, tools/dcbench names them in the same order.
+ *
+ */
+
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "usci.h"
+#include "param.h"
+#include "pedal.h"
+#include "gauge.h"
+#include "vehicle.h"
+#include "drive.h"
+#include "profile.h"
+#include "supervisor.h"
+#include "clock.h"
+
+// Run ids, hot path (PROFILE_ slot) in the high byte and scenario in the low byte, as read by tools/dcbench
+#define BENCH_ID(slot, scenario)	(((slot) << 8) | (scenario))
+#define BENCH_OVERHEAD				0xFE			// Empty run, the cost of the marks themselves
+#define BENCH_DONE					0xFFFF
+
+// Firmware state normally defined by modules the benchmark leaves out
+volatile unsigned int events = 0x0000;
+volatile unsigned int tick_count = 0;
+unsigned long clock_hz = INPUT_CLOCK;
+unsigned int usci_timeouts;
+
+// Read by tools/dcbench at each mark
+volatile unsigned int bench_id;
+volatile unsigned int bench_count;
+
+// MCP2515 replies for can_receive(), one byte per usci_exchange()
+unsigned char spi_script[16];
+unsigned char spi_next;
+
+typedef struct {
+	unsigned char state;
+	unsigned int pedal;
+	unsigned int slider;
+	unsigned char regen;
+	float voltage;
+	float current;
+} pedal_scenario;
+
+// process_pedal(): mode, pedal A (and B), slider, brake regen request, pack voltage and current
+const pedal_scenario pedal_scenarios[] = {
+	{ MODE_OFF,		245,	200,	FALSE,	0.0,	0.0 },		// Parked
+	{ MODE_DL,		245,	200,	FALSE,	140.0,	0.0 },		// Drive, pedal released
+	{ MODE_DL,		1720,	200,	FALSE,	140.0,	20.0 },		// Drive, half pedal
+	{ MODE_DL,		3500,	200,	FALSE,	140.0,	80.0 },		// Drive, past full travel
+	{ MODE_R,		1720,	2048,	FALSE,	140.0,	20.0 },		// Reverse, half pedal
+	{ MODE_R,		245,	2048,	TRUE,	140.0,	-10.0 },	// Reverse, braking
+	{ MODE_BL,		245,	2048,	FALSE,	140.0,	-10.0 },	// B, regen on the slider
+	{ MODE_BL,		245,	3896,	FALSE,	158.0,	-60.0 },	// B, full regen derated for voltage and charge current
+	{ MODE_BL,		1720,	2048,	FALSE,	140.0,	20.0 },		// B, half pedal
+	{ MODE_BH,		245,	3896,	FALSE,	0.0,	0.0 },		// B, regen with no bus readings
+};
+#define PEDAL_SCENARIOS		(sizeof(pedal_scenarios) / sizeof(pedal_scenarios[0]))
+
+typedef struct {
+	unsigned char state;
+	unsigned int switches;
+	unsigned int events;
+} state_scenario;
+
+// drive_state(): current mode, switches, speed events
+const state_scenario state_scenarios[] = {
+	{ MODE_OFF,		0x0000,						0x0000 },			// Off, staying off
+	{ MODE_OFF,		SW_IGN_ON | SW_MODE_N,		EVENT_SLOW },		// Ignition on
+	{ MODE_N,		SW_IGN_ON | SW_MODE_D,		EVENT_SLOW },		// Neutral to drive
+	{ MODE_N,		SW_IGN_ON | SW_MODE_R,		EVENT_FORWARD },	// Reverse refused while rolling forwards
+	{ MODE_DL,		SW_IGN_ON | SW_MODE_D,		EVENT_FORWARD },	// Driving
+	{ MODE_DL,		SW_IGN_ON | SW_MODE_B,		EVENT_FORWARD },	// Drive to B on the move
+	{ MODE_R,		SW_IGN_ON | SW_MODE_N,		EVENT_REVERSE },	// Reverse to neutral
+	{ MODE_CHARGE,	SW_IGN_ON | SW_FUEL,		EVENT_SLOW },		// Charging
+};
+#define STATE_SCENARIOS		(sizeof(state_scenarios) / sizeof(state_scenarios[0]))
+
+typedef struct {
+	unsigned char flags;			// CANINTF
+	unsigned long id;
+	float low;
+	float high;
+} can_scenario;
+
+// can_receive() and vehicle_receive(): interrupt flags, identifier and payload
+const can_scenario can_scenarios[] = {
+	{ MCP_IRQ_RXB1,	MC_CAN_BASE + MC_VELOCITY,	3000.0,	10.5 },		// Velocity, updates the tacho
+	{ MCP_IRQ_RXB1,	MC_CAN_BASE + MC_I_VECTOR,	-20.0,	0.0 },		// Current vector, regen
+	{ MCP_IRQ_RXB1,	MC_CAN_BASE + MC_BUS,		150.0,	-12.0 },	// Bus, updates power and fuel gauges
+	{ MCP_IRQ_RXB1,	MC_CAN_BASE + MC_TEMP1,		45.0,	38.0 },		// Temperatures
+	{ MCP_IRQ_RXB1,	EG_CAN_BASE + EG_STATUS,	0.0,	0.0 },		// eGear status
+	{ MCP_IRQ_RXB0,	DC_CAN_BASE + DC_SWITCH,	0.0,	0.0 },		// Our own base, left for the main loop
+	{ MCP_IRQ_RXB1,	CAN_EXT( 0x18FF0001 ),		0.0,	0.0 },		// Extended identifier, not ours
+	{ MCP_IRQ_ERR,	0,							0.0,	0.0 },		// Error interrupt
+};
+#define CAN_SCENARIOS		(sizeof(can_scenarios) / sizeof(can_scenarios[0]))
+
+// gauge_tach_update(): motor rpm
+const float gauge_scenarios[] = {
+	0.0,			// Stopped, below GAUGE1_MIN
+	850.0,			// Idle speed
+	3000.0,			// Cruising
+	-1200.0,		// Reversing
+	9000.0,			// Over GAUGE1_MAX
+};
+#define GAUGE_SCENARIOS		(sizeof(gauge_scenarios) / sizeof(gauge_scenarios[0]))
+
+// Private function prototypes
+void bench_mark( void ) __attribute__ ((noinline));
+void bench_start( unsigned int id );
+void bench_frame( const can_scenario *scenario );
+
+/**************************************************************************************************
+ * PUBLIC FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Runs every scenario once, between a pair of marks, then parks on BENCH_DONE
+ */
+int main( void )
+{
+	unsigned char i, state;
+
+	WDTCTL = WDTPW | WDTHOLD;
+	param_defaults();
+	drive_init();
+	gauge_init();
+	command.rpm = 0.0;
+	command.current = 0.0;
+	command.bus_current = 1.0;
+	command.flags = 0x00;
+	command.state = MODE_OFF;
+
+	bench_start( BENCH_ID( BENCH_OVERHEAD, 0 ));
+	bench_mark();
+
+	for( i = 0; i < PEDAL_SCENARIOS; i++ ){
+		command.state = pedal_scenarios[i].state;
+		command.flags = 0x00;
+		battery_voltage = pedal_scenarios[i].voltage;
+		battery_current = pedal_scenarios[i].current;
+		vehicle_cache[VEHICLE_SLOT( 0, VEHICLE_BUS )].fresh = ( pedal_scenarios[i].voltage != 0.0 );
+		bench_start( BENCH_ID( PROFILE_PEDAL, i ));
+		process_pedal( pedal_scenarios[i].pedal, pedal_scenarios[i].pedal, pedal_scenarios[i].slider, pedal_scenarios[i].regen );
+		bench_mark();
+	}
+
+	for( i = 0; i < STATE_SCENARIOS; i++ ){
+		command.state = state_scenarios[i].state;
+		events = state_scenarios[i].events;
+		bench_start( BENCH_ID( PROFILE_STATE, i ));
+		state = drive_state( state_scenarios[i].switches );
+		bench_mark();
+		command.state = state;
+	}
+
+	for( i = 0; i < CAN_SCENARIOS; i++ ){
+		bench_frame( &can_scenarios[i] );
+		bench_start( BENCH_ID( PROFILE_CAN_RX, i ));
+		can_receive();
+		if( can.status == CAN_OK ) vehicle_receive();
+		bench_mark();
+	}
+
+	for( i = 0; i < GAUGE_SCENARIOS; i++ ){
+		bench_start( BENCH_ID( PROFILE_GAUGE, i ));
+		gauge_tach_update( gauge_scenarios[i] );
+		bench_mark();
+	}
+
+	bench_id = BENCH_DONE;
+	while( TRUE ) bench_mark();
+}
+
+/*
+ * MCP2515 SPI stand-ins
+ *	- Transmitted bytes are dropped, received bytes come from the scenario's script
+ */
+void usci_transmit( unsigned char data )
+{
+}
+
+unsigned char usci_exchange( unsigned char data )
+{
+	return( spi_script[spi_next++ & 0x0F] );
+}
+
+/*
+ * Clock and supervisor stand-ins, for can_reset() and param_service(), neither of which is measured
+ */
+void clock_can_stop( void )
+{
+}
+
+void clock_can_reset( void )
+{
+}
+
+void supervisor_hold( void )
+{
+}
+
+void supervisor_resume( void )
+{
+}
+
+/**************************************************************************************************
+ * PRIVATE FUNCTIONS
+ *************************************************************************************************/
+
+/*
+ * Breakpoint for the simulator, either side of each measured call
+ *	- Not inlined, so there is always an instruction to stop on
+ */
+void bench_mark( void )
+{
+	bench_count++;
+}
+
+/*
+ * Names the run that follows, and marks its start
+ */
+void bench_start( unsigned int id )
+{
+	bench_id = id;
+	bench_mark();
+}
+
+/*
+ * Loads the SPI script with what the MCP2515 returns for a scenario
+ *	- CANINTF, then either the 13 byte receive buffer (SIDH, SIDL, EID8, EID0, DLC, data) or EFLG, TEC and REC
+ */
+void bench_frame( const can_scenario *scenario )
+{
+	group_64 data;
+	unsigned char i;
+
+	spi_next = 0;
+	spi_script[0] = scenario->flags;
+	if( scenario->flags & MCP_IRQ_ERR ){
+		spi_script[1] = MCP_EFLG_EWARN;
+		spi_script[2] = 96;
+		spi_script[3] = 0;
+		return;
+	}
+	if( scenario->id & CAN_EXTENDED ){
+		spi_script[1] = (unsigned char)( scenario->id >> 21 );
+		spi_script[2] = ((unsigned char)( scenario->id >> 13 ) & 0xE0 ) | MCP_SIDL_EXIDE | ((unsigned char)( scenario->id >> 16 ) & 0x03 );
+		spi_script[3] = (unsigned char)( scenario->id >> 8 );
+		spi_script[4] = (unsigned char)scenario->id;
+	}
+	else{
+		spi_script[1] = (unsigned char)( scenario->id >> 3 );
+		spi_script[2] = (unsigned char)( scenario->id << 5 );
+		spi_script[3] = 0x00;
+		spi_script[4] = 0x00;
+	}
+	spi_script[5] = 8;
+	data.data_fp[0] = scenario->low;
+	data.data_fp[1] = scenario->high;
+	for( i = 0; i < 8; i++ ) spi_script[6 + i] = data.data_u8[i];
+}
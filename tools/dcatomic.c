@@ -0,0 +1,204 @@
+/*
+ * Driver controls event flag stress test
+ *
+ * Runs the firmware's atomic.c on Linux against a stand-in interrupt: a fast interval timer signal
+ * whose handler posts event flags the way the Timer A, ADC and CAN ISRs do, while the main loop
+ * consumes them with event_consume() and posts and clears its own flags with event_post() and
+ * event_clear().  Built with HOST_INTERRUPTS, dint() and eint() mask and unmask the signal and
+ * READ_SR reports GIE from the signal mask, so the helpers' critical sections are honoured and
+ * the handler can land between any two main loop instructions everywhere else.
+ *
+ * The handler only posts a flag that is clear, and counts its posts, so every post is one event.
+ * The test fails if the main loop consumes a flag more times than it was posted (a duplicate), if
+ * the main loop's own flags change under it, or if, once the timer is stopped, consumed plus still
+ * pending falls short of posted (a lost event).
+ *
+ * Build, from the repository root:
+ *		gcc -Wall -O2 -fcommon -DHOST_INTERRUPTS -Itools/host -Isc8_driver_controls -o dcatomic tools/dcatomic.c \
+ *			sc8_driver_controls/atomic.c
+ *
+ * Usage:
+ *		dcatomic [-t seconds] [-u]
+ *			-t	run time, default 2
+ *			-u	consume with a plain load, modify and store rather than event_consume(), to show that
+ *				the test sees the lost flags the helpers prevent (expect it to fail)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "atomic.h"
+
+// Flags the stand-in interrupt posts, and flags only the main loop changes
+#define ISR_FLAGS			4
+static const unsigned int isr_flag[ISR_FLAGS] = { EVENT_TIMER, EVENT_ADC, EVENT_COMMS, EVENT_CAN_ACTIVITY };
+static const char *isr_name[ISR_FLAGS] = { "EVENT_TIMER", "EVENT_ADC", "EVENT_COMMS", "EVENT_CAN_ACTIVITY" };
+#define MAIN_FLAGS			(EVENT_SLOW | EVENT_FORWARD | EVENT_REVERSE | EVENT_CONNECTED)
+
+static volatile unsigned long posted[ISR_FLAGS];
+static volatile unsigned long interrupts;
+static unsigned int isr_seed = 1;			// Only the handler uses it
+static unsigned long consumed[ISR_FLAGS];
+static sigset_t irq_set;
+
+static void usage( void )
+{
+	fprintf( stderr, "usage: dcatomic [-t seconds] [-u]\n" );
+	exit( 2 );
+}
+
+// Interrupt control for atomic.c, see tools/host
+void host_dint( void )
+{
+	sigprocmask( SIG_BLOCK, &irq_set, NULL );
+}
+
+void host_eint( void )
+{
+	sigprocmask( SIG_UNBLOCK, &irq_set, NULL );
+}
+
+unsigned int host_read_sr( void )
+{
+	sigset_t current;
+
+	sigprocmask( SIG_BLOCK, NULL, &current );
+	return( sigismember( &current, SIGALRM ) ? 0 : GIE );
+}
+
+// The stand-in ISR: posts one flag, directly or through the helper, as ISR code may do either
+static void isr( int sig )
+{
+	unsigned int i;
+
+	(void)sig;
+	interrupts++;
+	isr_seed = isr_seed * 1103515245 + 12345;
+	i = (isr_seed >> 16) % ISR_FLAGS;
+	if( events & isr_flag[i] ) return;		// Still pending, a second post would merge with it
+	posted[i]++;
+	if( isr_seed & 0x80000000 ) events |= isr_flag[i];
+	else event_post( isr_flag[i] );
+}
+
+// What event_consume() replaced: a separate load and store, so a flag posted in between is lost
+static unsigned int plain_consume( unsigned int mask )
+{
+	unsigned int set, value;
+
+	set = events & mask;
+	value = events;
+	value &= ~set;
+	events = value;
+	return set;
+}
+
+static double now( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main( int argc, char **argv )
+{
+	struct sigaction action;
+	struct itimerval timer;
+	unsigned int seed = 1, mask, set, expect = 0x0000, flag, pending, i;
+	unsigned long loops = 0, lost, failed = 0;
+	double seconds = 2.0, end;
+	int opt, unsafe = 0;
+
+	while( (opt = getopt( argc, argv, "t:u" )) != -1 ){
+		switch( opt ){
+			case 't': seconds = atof( optarg ); break;
+			case 'u': unsafe = 1; break;
+			default: usage();
+		}
+	}
+	if( optind != argc ) usage();
+
+	sigemptyset( &irq_set );
+	sigaddset( &irq_set, SIGALRM );
+	memset( &action, 0, sizeof(action) );
+	action.sa_handler = isr;
+	sigemptyset( &action.sa_mask );
+	sigaction( SIGALRM, &action, NULL );
+
+	// Every 20us, much faster and the handler leaves the main loop no time to run
+	events = 0x0000;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 20;
+	timer.it_value = timer.it_interval;
+	setitimer( ITIMER_REAL, &timer, NULL );
+
+	end = now() + seconds;
+	while( now() < end ){
+		seed = seed * 1103515245 + 12345;
+		switch( (seed >> 16) % 4 ){
+			case 0:
+			case 1:
+				// Consume one interrupt flag, or all of them
+				mask = ((seed >> 16) & 4) ? isr_flag[(seed >> 24) % ISR_FLAGS] : (EVENT_TIMER | EVENT_ADC | EVENT_COMMS | EVENT_CAN_ACTIVITY);
+				set = unsafe ? plain_consume( mask ) : event_consume( mask );
+				for( i = 0; i < ISR_FLAGS; i++ ){
+					if( !(set & isr_flag[i]) ) continue;
+					consumed[i]++;
+					if( consumed[i] > posted[i] ){
+						fprintf( stderr, "%s consumed %lu times, posted %lu\n", isr_name[i], consumed[i], posted[i] );
+						failed++;
+					}
+				}
+				break;
+			case 2:
+				flag = EVENT_SLOW << ((seed >> 24) & 3);
+				event_post( flag );
+				expect |= flag;
+				break;
+			case 3:
+				flag = EVENT_SLOW << ((seed >> 24) & 3);
+				event_clear( flag );
+				expect &= ~flag;
+				break;
+		}
+		if( (events & MAIN_FLAGS) != expect ){
+			fprintf( stderr, "main loop flags %04X, expected %04X\n", events & MAIN_FLAGS, expect );
+			failed++;
+			expect = events & MAIN_FLAGS;
+		}
+		loops++;
+		if( failed > 20 ) break;
+	}
+
+	// Stop the interrupt, then everything posted is either consumed or still pending
+	host_dint();
+	memset( &timer, 0, sizeof(timer) );
+	setitimer( ITIMER_REAL, &timer, NULL );
+
+	printf( "%lu main loop passes, %lu interrupts%s\n", loops, interrupts, unsafe ? ", plain consume" : "" );
+	printf( "%-20s %10s %10s %8s %8s\n", "flag", "posted", "consumed", "pending", "lost" );
+	for( i = 0; i < ISR_FLAGS; i++ ){
+		pending = (events & isr_flag[i]) ? 1 : 0;
+		lost = (consumed[i] + pending < posted[i]) ? posted[i] - consumed[i] - pending : 0;
+		printf( "%-20s %10lu %10lu %8u %8lu\n", isr_name[i], posted[i], consumed[i], pending, lost );
+		if( lost ) failed++;
+	}
+	if( interrupts == 0 ){
+		fprintf( stderr, "no interrupts were delivered\n" );
+		failed++;
+	}
+	if( failed ){
+		fprintf( stderr, "FAILED\n" );
+		return 1;
+	}
+	return 0;
+}
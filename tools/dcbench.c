@@ -0,0 +1,238 @@
+/*
+ * Driver controls hot path cycle benchmark
+ *
+ * Runs tools/bench/bench.c, built for the MSP430F247, under the mspdebug instruction set simulator,
+ * and reports the exact MCLK cycles taken by each hot path in each of its input scenarios.  The
+ * simulator stops on bench_mark() either side of every call, and its tracer's MCLK count is read
+ * at each stop.  The cost of an empty run between two marks is subtracted from every result.
+ *
+ * Exits with status 1 if any hot path's worst scenario is over its budget from profile.h, so it
+ * can gate a change.  The simulator has no interrupts or bus waits, so these are the uninterrupted
+ * costs; on the target, tools/dcprof reports the worst case including interrupts.
+ *
+ * Build:
+ *		gcc -Wall -O2 -o dcbench dcbench.c
+ *
+ * Usage:
+ *		dcbench [-m mspdebug] [-v] <bench.elf>
+ *			-m	mspdebug binary, default mspdebug on the PATH
+ *			-v	echo the simulator's output
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Must match tools/bench/bench.c
+#define BENCH_OVERHEAD		0xFE
+#define BENCH_DONE			0xFFFF
+#define RAM_START			0x1100
+#define RAM_END				0x2100
+
+// Hot paths by slot, with budgets in MCLK cycles, as listed in profile.h
+static const char *slot_names[] = {
+	"process_pedal",
+	"state_machine",
+	"can_receive",
+	"gauge_tach_update",
+};
+static const unsigned long slot_budgets[] = { 8000, 1500, 2500, 3000 };
+#define PROFILE_SLOTS		(sizeof(slot_names) / sizeof(slot_names[0]))
+
+// Scenarios by slot, in the order of the tables in tools/bench/bench.c
+static const char *pedal_scenarios[] = {
+	"parked",
+	"drive, pedal released",
+	"drive, half pedal",
+	"drive, past full travel",
+	"reverse, half pedal",
+	"reverse, braking",
+	"B, regen on the slider",
+	"B, full regen derated",
+	"B, half pedal",
+	"B, regen with no bus readings",
+};
+static const char *state_scenarios[] = {
+	"off, staying off",
+	"ignition on",
+	"neutral to drive",
+	"reverse while rolling forwards",
+	"driving",
+	"drive to B on the move",
+	"reverse to neutral",
+	"charging",
+};
+static const char *can_scenarios[] = {
+	"MC velocity",
+	"MC current vector",
+	"MC bus",
+	"MC temperatures",
+	"eGear status",
+	"own base",
+	"extended, not ours",
+	"error interrupt",
+};
+static const char *gauge_scenarios[] = {
+	"stopped",
+	"idle",
+	"cruising",
+	"reversing",
+	"over range",
+};
+#define COUNT(table)		(sizeof(table) / sizeof(table[0]))
+#define MAX_SCENARIOS		16
+
+static const char **scenario_names[] = { pedal_scenarios, state_scenarios, can_scenarios, gauge_scenarios };
+static const unsigned int scenario_counts[] = {
+	COUNT(pedal_scenarios), COUNT(state_scenarios), COUNT(can_scenarios), COUNT(gauge_scenarios)
+};
+
+static long cycles[PROFILE_SLOTS][MAX_SCENARIOS];
+static long overhead = -1;
+
+static void usage( void )
+{
+	fprintf( stderr, "usage: dcbench [-m mspdebug] [-v] <bench.elf>\n" );
+	exit( 2 );
+}
+
+// Records one run, from the MCLK counts at its two marks
+static void record( unsigned int id, long long start, long long stop )
+{
+	unsigned int slot, scenario;
+
+	slot = id >> 8;
+	scenario = id & 0xFF;
+	if( slot == BENCH_OVERHEAD ) overhead = stop - start;
+	else if( slot < PROFILE_SLOTS && scenario < scenario_counts[slot] ) cycles[slot][scenario] = stop - start;
+	else fprintf( stderr, "unknown run %04X, bench.elf and dcbench out of step?\n", id );
+}
+
+// Writes the simulator commands: load, trace, then for each mark run to it, read the run id and MCLK, and step off it
+static void write_script( FILE *f, unsigned int marks )
+{
+	unsigned int i;
+
+	for( i = 0; i < marks; i++ ){
+		fprintf( f, "run\n" );
+		fprintf( f, "md bench_id 2\n" );
+		fprintf( f, "simio info t\n" );
+		fprintf( f, "step\n" );
+	}
+}
+
+int main( int argc, char **argv )
+{
+	const char *mspdebug = "mspdebug";
+	char script[] = "/tmp/dcbenchXXXXXX";
+	char command[1024], line[512], *p;
+	unsigned int slot, scenario, marks, address, lo, hi, id = 0, start_id = 0;
+	long long mclk, start_mclk = 0;
+	int opt, fd, verbose = 0, want_id = 1, started = 0, done = 0, failed = 0;
+	long worst;
+	FILE *f;
+
+	while( (opt = getopt( argc, argv, "m:v" )) != -1 ){
+		switch( opt ){
+			case 'm': mspdebug = optarg; break;
+			case 'v': verbose = 1; break;
+			default: usage();
+		}
+	}
+	if( optind != argc - 1 ) usage();
+
+	// Two marks per run, the overhead run included, and the one at BENCH_DONE
+	marks = 3;
+	for( slot = 0; slot < PROFILE_SLOTS; slot++ ) marks += 2 * scenario_counts[slot];
+	for( slot = 0; slot < PROFILE_SLOTS; slot++ ){
+		for( scenario = 0; scenario < MAX_SCENARIOS; scenario++ ) cycles[slot][scenario] = -1;
+	}
+
+	fd = mkstemp( script );
+	if( fd < 0 || (f = fdopen( fd, "w" )) == NULL ){
+		perror( script );
+		return 1;
+	}
+	write_script( f, marks );
+	fclose( f );
+
+	snprintf( command, sizeof(command), "%s -q sim \"prog %s\" \"simio add tracer t\" \"setbreak bench_mark\" \"read %s\" 2>&1",
+		mspdebug, argv[optind], script );
+	f = popen( command, "r" );
+	if( f == NULL ){
+		perror( mspdebug );
+		unlink( script );
+		return 1;
+	}
+
+	// Each mark prints the md dump of bench_id, then the tracer's clock counts
+	while( fgets( line, sizeof(line), f ) != NULL ){
+		if( verbose ) fputs( line, stdout );
+		if( done ) continue;
+		p = line + strspn( line, " \t" );
+		if( want_id ){
+			// The dump is the first line addressed in RAM, disassembly after the stop is all in flash
+			if( sscanf( p, "%x: %x %x", &address, &lo, &hi ) == 3 && address >= RAM_START && address < RAM_END ){
+				id = lo | (hi << 8);
+				want_id = 0;
+			}
+		}
+		else if( strncmp( p, "MCLK:", 5 ) == 0 && sscanf( p + 5, "%lld", &mclk ) == 1 ){
+			want_id = 1;
+			if( id == BENCH_DONE ) done = 1;
+			else if( started && id == start_id ){
+				record( id, start_mclk, mclk );
+				started = 0;
+			}
+			else{
+				start_id = id;
+				start_mclk = mclk;
+				started = 1;
+			}
+		}
+	}
+	pclose( f );
+	unlink( script );
+
+	if( !done || overhead < 0 ){
+		fprintf( stderr, "benchmark did not run to completion under %s\n", mspdebug );
+		return 1;
+	}
+
+	printf( "%-18s %-32s %8s\n", "path", "scenario", "cycles" );
+	for( slot = 0; slot < PROFILE_SLOTS; slot++ ){
+		for( scenario = 0; scenario < scenario_counts[slot]; scenario++ ){
+			if( cycles[slot][scenario] < 0 ) printf( "%-18s %-32s %8s\n", slot_names[slot], scenario_names[slot][scenario], "-" );
+			else printf( "%-18s %-32s %8ld\n", slot_names[slot], scenario_names[slot][scenario], cycles[slot][scenario] - overhead );
+		}
+	}
+
+	printf( "\n%-18s %8s %8s\n", "path", "max", "budget" );
+	for( slot = 0; slot < PROFILE_SLOTS; slot++ ){
+		worst = -1;
+		for( scenario = 0; scenario < scenario_counts[slot]; scenario++ ){
+			if( cycles[slot][scenario] < 0 ){
+				worst = -1;
+				break;
+			}
+			if( cycles[slot][scenario] - overhead > worst ) worst = cycles[slot][scenario] - overhead;
+		}
+		if( worst < 0 ){
+			printf( "%-18s %8s %8lu  MISSING RUNS\n", slot_names[slot], "-", slot_budgets[slot] );
+			failed++;
+			continue;
+		}
+		printf( "%-18s %8ld %8lu%s\n", slot_names[slot], worst, slot_budgets[slot],
+			worst > (long)slot_budgets[slot] ? "  OVER BUDGET" : "" );
+		if( worst > (long)slot_budgets[slot] ) failed++;
+	}
+	printf( "(%ld cycles of mark overhead subtracted)\n", overhead );
+
+	if( failed ){
+		fprintf( stderr, "%d hot path%s over budget\n", failed, failed == 1 ? "" : "s" );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,455 @@
+/*
+ * Driver controls firmware loader for Linux SocketCAN
+ *
+ * Reflashes the driver controls application over CAN using the resident bootloader and the
+ * protocol in sc8_driver_controls/bootload.h.  Takes the Intel HEX image of the application,
+ * sc8_driver_controls.hex as built with msp430x247_app.x; anything outside the application region
+ * (a bootloader image merged in, INFO flash) is skipped.
+ * Works on any SocketCAN interface, including a vcan interface for testing without hardware:
+ *
+ *		sudo modprobe vcan
+ *		sudo ip link add dev vcan0 type vcan
+ *		sudo ip link set up vcan0
+ *
+ * Build:
+ *		gcc -Wall -O2 -o dcboot dcboot.c
+ *
+ * Usage:
+ *		dcboot [-i interface] flash <image.hex>
+ *		dcboot [-i interface] ping
+ *		dcboot [-i interface] run
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+// Must match can.h and bootload.h in the firmware
+#define DC_CAN_BASE			0x500
+#define DC_BOOTLOAD			22
+#define DC_BOOT_DATA		23
+#define DC_BOOT_REPLY		24
+
+#define BOOT_APP_START		0x8000
+#define BOOT_APP_END		0xF800
+#define BOOT_APP_RESET		0xF7FE
+#define BOOT_SEGMENT_SIZE	512
+
+#define BOOT_CMD_PING		0x01
+#define BOOT_CMD_ERASE		0x02
+#define BOOT_CMD_BLOCK		0x03
+#define BOOT_CMD_DONE		0x04
+#define BOOT_CMD_RUN		0x05
+#define BOOT_REPLY_ACK		0x10
+
+#define BOOT_OK				0
+#define BOOT_ERROR_SEQUENCE	-5
+#define BOOT_ERROR_BUSY		-7
+
+#define BOOT_DATA_BYTES		7
+#define BOOT_WINDOW			16
+#define BOOT_CRC_SEED		0xFFFF
+
+#define APP_BYTES			(BOOT_APP_END - BOOT_APP_START)
+#define SEGMENTS			(APP_BYTES / BOOT_SEGMENT_SIZE)
+
+// Timeouts
+#define REPLY_TIMEOUT_MS	500
+#define ERASE_TIMEOUT_MS	3000			// 60 segments at ~12ms each, plus margin
+#define ENTRY_TIMEOUT_MS	3000			// Application reset and bootloader start
+#define BLOCK_RETRIES		3
+
+#define TOOL_ERROR			-128			// Local failure, as opposed to a bootloader result
+
+static const char *result_names[] = { "ok", "bad command", "bad address", "crc mismatch", "flash verify failed", "sequence error", "no valid application",
+	"refused by the application, not stopped in neutral or off" };
+
+typedef struct {
+	uint8_t command;
+	int8_t result;
+	uint16_t sequence;
+	uint16_t value_a;
+	uint16_t value_b;
+} reply_t;
+
+static int sock;
+static uint8_t image[APP_BYTES];
+static int segment_used[SEGMENTS];
+
+static void usage( void )
+{
+	fprintf( stderr,
+		"usage: dcboot [-i interface] flash <image.hex>\n"
+		"       dcboot [-i interface] ping\n"
+		"       dcboot [-i interface] run\n" );
+	exit( 2 );
+}
+
+static const char *result_name( int8_t result )
+{
+	if( result <= 0 && -result < (int)(sizeof(result_names) / sizeof(result_names[0])) ) return result_names[-result];
+	return "unknown error";
+}
+
+static long now_ms( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static int open_can( const char *name )
+{
+	struct sockaddr_can addr;
+	struct ifreq ifr;
+	struct can_filter filter;
+	int s;
+
+	s = socket( PF_CAN, SOCK_RAW, CAN_RAW );
+	if( s < 0 ){
+		perror( "socket" );
+		exit( 1 );
+	}
+	memset( &ifr, 0, sizeof(ifr) );
+	strncpy( ifr.ifr_name, name, IFNAMSIZ - 1 );
+	if( ioctl( s, SIOCGIFINDEX, &ifr ) < 0 ){
+		perror( name );
+		exit( 1 );
+	}
+	// Only listen for replies
+	filter.can_id = DC_CAN_BASE + DC_BOOT_REPLY;
+	filter.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	setsockopt( s, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter) );
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if( bind( s, (struct sockaddr *)&addr, sizeof(addr) ) < 0 ){
+		perror( "bind" );
+		exit( 1 );
+	}
+	return s;
+}
+
+// Sends a frame, waiting for room in the interface queue if it is full
+static int send_frame( uint32_t id, const uint8_t *data, uint8_t bytes )
+{
+	struct can_frame frame;
+	struct pollfd pfd;
+
+	memset( &frame, 0, sizeof(frame) );
+	frame.can_id = id;
+	frame.can_dlc = bytes;
+	memcpy( frame.data, data, bytes );
+	while( write( sock, &frame, sizeof(frame) ) != sizeof(frame) ){
+		if( errno != ENOBUFS && errno != EAGAIN ){
+			perror( "write" );
+			return -1;
+		}
+		pfd.fd = sock;
+		pfd.events = POLLOUT;
+		poll( &pfd, 1, 10 );
+	}
+	return 0;
+}
+
+// Waits for any reply, returns 0 on success, -1 on timeout
+static int wait_reply( int timeout_ms, reply_t *reply )
+{
+	struct can_frame frame;
+	struct pollfd pfd;
+	long end = now_ms() + timeout_ms;
+	int left;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	while( (left = (int)(end - now_ms())) > 0 ){
+		if( poll( &pfd, 1, left ) <= 0 ) break;
+		if( read( sock, &frame, sizeof(frame) ) != sizeof(frame) ) continue;
+		if( frame.can_dlc != 8 ) continue;
+		reply->command = frame.data[0];
+		reply->result = (int8_t)frame.data[1];
+		reply->sequence = frame.data[2] | (frame.data[3] << 8);
+		reply->value_a = frame.data[4] | (frame.data[5] << 8);
+		reply->value_b = frame.data[6] | (frame.data[7] << 8);
+		return 0;
+	}
+	return -1;
+}
+
+// Sends a command and waits for its reply, skipping stray window acknowledgements
+static int transact( const uint8_t *data, int timeout_ms, reply_t *reply )
+{
+	long end;
+
+	if( send_frame( DC_CAN_BASE + DC_BOOTLOAD, data, 8 ) ) return -1;
+	end = now_ms() + timeout_ms;
+	while( now_ms() < end ){
+		if( wait_reply( (int)(end - now_ms()), reply ) ) break;
+		if( reply->command == data[0] ) return 0;
+	}
+	return -1;
+}
+
+static int command( uint8_t cmd, uint16_t value, int timeout_ms, reply_t *reply )
+{
+	uint8_t data[8];
+
+	memset( data, 0, sizeof(data) );
+	data[0] = cmd;
+	data[4] = value;
+	data[5] = value >> 8;
+	if( transact( data, timeout_ms, reply ) ){
+		fprintf( stderr, "no reply from bootloader\n" );
+		return -1;
+	}
+	return 0;
+}
+
+// CRC-16 CCITT, as boot_crc() in the firmware
+static uint16_t crc16( uint16_t crc, const uint8_t *ptr, unsigned int bytes )
+{
+	int bit;
+
+	while( bytes-- ){
+		crc ^= (uint16_t)(*ptr++ << 8);
+		for( bit = 0; bit < 8; bit++ ){
+			if( crc & 0x8000 ) crc = (crc << 1) ^ 0x1021;
+			else crc = crc << 1;
+		}
+	}
+	return crc;
+}
+
+static int hex_byte( const char *p )
+{
+	unsigned int value;
+
+	if( sscanf( p, "%2x", &value ) != 1 ) return -1;
+	return (int)value;
+}
+
+// Loads an Intel HEX file into the application image, returns the number of application bytes
+static int load_hex( const char *path )
+{
+	FILE *f;
+	char line[600];
+	uint32_t base = 0, address;
+	int count, type, i, value, sum, used = 0, skipped = 0, lineno = 0;
+
+	f = fopen( path, "r" );
+	if( f == NULL ){
+		perror( path );
+		exit( 1 );
+	}
+	memset( image, 0xFF, sizeof(image) );
+	while( fgets( line, sizeof(line), f ) != NULL ){
+		lineno++;
+		if( line[0] != ':' ) continue;
+		count = hex_byte( &line[1] );
+		if( count < 0 || strlen( line ) < (size_t)(11 + count * 2) ) goto bad;
+		sum = 0;
+		for( i = 0; i < count + 5; i++ ){
+			value = hex_byte( &line[1 + i * 2] );
+			if( value < 0 ) goto bad;
+			sum += value;
+		}
+		if( (sum & 0xFF) != 0 ) goto bad;
+		address = (hex_byte( &line[3] ) << 8) | hex_byte( &line[5] );
+		type = hex_byte( &line[7] );
+		if( type == 0x01 ) break;
+		if( type == 0x02 ) base = ((hex_byte( &line[9] ) << 8) | hex_byte( &line[11] )) << 4;
+		if( type == 0x04 ) base = ((hex_byte( &line[9] ) << 8) | hex_byte( &line[11] )) << 16;
+		if( type != 0x00 ) continue;
+		for( i = 0; i < count; i++ ){
+			uint32_t a = base + address + i;
+			if( a >= BOOT_APP_START && a < BOOT_APP_END ){
+				image[a - BOOT_APP_START] = hex_byte( &line[9 + i * 2] );
+				segment_used[(a - BOOT_APP_START) / BOOT_SEGMENT_SIZE] = 1;
+				used++;
+			}
+			else skipped++;
+		}
+	}
+	fclose( f );
+	if( skipped ) printf( "skipping %d bytes outside the application region (bootloader, INFO flash)\n", skipped );
+	return used;
+
+bad:
+	fprintf( stderr, "%s:%d: bad Intel HEX record\n", path, lineno );
+	exit( 1 );
+}
+
+// Sends one block with windowed acknowledgements, returns the bootloader's result or TOOL_ERROR
+static int send_block( int segment )
+{
+	uint16_t address = BOOT_APP_START + segment * BOOT_SEGMENT_SIZE;
+	const uint8_t *data = &image[segment * BOOT_SEGMENT_SIZE];
+	uint8_t frame[8];
+	uint16_t crc;
+	reply_t reply;
+	int frames = (BOOT_SEGMENT_SIZE + BOOT_DATA_BYTES - 1) / BOOT_DATA_BYTES;
+	int next = 0, acked = 0, timeouts = 0, offset, bytes;
+
+	frame[0] = BOOT_CMD_BLOCK;
+	frame[1] = 0;
+	frame[2] = address;
+	frame[3] = address >> 8;
+	frame[4] = BOOT_SEGMENT_SIZE & 0xFF;
+	frame[5] = BOOT_SEGMENT_SIZE >> 8;
+	crc = crc16( BOOT_CRC_SEED, data, BOOT_SEGMENT_SIZE );
+	frame[6] = crc;
+	frame[7] = crc >> 8;
+	if( send_frame( DC_CAN_BASE + DC_BOOTLOAD, frame, 8 ) ) return TOOL_ERROR;
+
+	while( 1 ){
+		// Keep up to two windows in flight
+		while( next < frames && next < acked + 2 * BOOT_WINDOW ){
+			offset = next * BOOT_DATA_BYTES;
+			bytes = BOOT_SEGMENT_SIZE - offset;
+			if( bytes > BOOT_DATA_BYTES ) bytes = BOOT_DATA_BYTES;
+			frame[0] = next;
+			memcpy( &frame[1], &data[offset], bytes );
+			if( send_frame( DC_CAN_BASE + DC_BOOT_DATA, frame, bytes + 1 ) ) return TOOL_ERROR;
+			next++;
+		}
+		if( wait_reply( REPLY_TIMEOUT_MS, &reply ) ){
+			// Lost frames or acknowledgements, go back to the last acknowledged point
+			if( ++timeouts > BLOCK_RETRIES ){
+				fprintf( stderr, "block 0x%04X: no reply from bootloader\n", address );
+				return TOOL_ERROR;
+			}
+			next = acked;
+			continue;
+		}
+		timeouts = 0;
+		if( reply.command == BOOT_CMD_BLOCK ) return reply.result;
+		if( reply.command != BOOT_REPLY_ACK ) continue;
+		acked = reply.sequence;
+		if( reply.result == BOOT_ERROR_SEQUENCE ) next = acked;
+	}
+}
+
+static int enter_bootloader( reply_t *reply )
+{
+	static const uint8_t bootload[8] = { 'B', 'O', 'O', 'T', 'L', 'O', 'A', 'D' };
+	long end = now_ms() + ENTRY_TIMEOUT_MS;
+
+	// The application resets into the bootloader, which announces itself with a PING reply;
+	// a bootloader that is already running answers the same frame directly
+	if( send_frame( DC_CAN_BASE + DC_BOOTLOAD, bootload, 8 ) ) return -1;
+	while( now_ms() < end ){
+		if( wait_reply( (int)(end - now_ms()), reply ) ) break;
+		if( reply->command == BOOT_CMD_PING && reply->result == BOOT_ERROR_BUSY ){
+			fprintf( stderr, "bootload %s\n", result_name( reply->result ) );
+			return -1;
+		}
+		if( reply->command == BOOT_CMD_PING ) return 0;
+	}
+	fprintf( stderr, "bootloader did not answer\n" );
+	return -1;
+}
+
+static int flash( const char *path )
+{
+	reply_t reply;
+	uint16_t crc;
+	long start;
+	int used, segment, blocks = 0, result, tries;
+
+	used = load_hex( path );
+	if( used == 0 ){
+		fprintf( stderr, "%s: no data in the application region\n", path );
+		return 1;
+	}
+	if( image[BOOT_APP_RESET - BOOT_APP_START] == 0xFF && image[BOOT_APP_RESET - BOOT_APP_START + 1] == 0xFF ){
+		fprintf( stderr, "%s: no application reset vector at 0x%04X, was it linked for the bootloader layout?\n", path, BOOT_APP_RESET );
+		return 1;
+	}
+	start = now_ms();
+
+	if( enter_bootloader( &reply ) ) return 1;
+	printf( "bootloader: application region 0x%04X - 0x%04X\n", reply.value_a, reply.value_b - 1 );
+	if( reply.value_a != BOOT_APP_START || reply.value_b != BOOT_APP_END ){
+		fprintf( stderr, "application region does not match this tool\n" );
+		return 1;
+	}
+
+	if( command( BOOT_CMD_ERASE, 0, ERASE_TIMEOUT_MS, &reply ) ) return 1;
+	if( reply.result != BOOT_OK ){
+		fprintf( stderr, "erase failed: %s\n", result_name( reply.result ) );
+		return 1;
+	}
+
+	// The bootloader holds back the reset vector (in the last segment) until DONE checks the whole image
+	for( segment = 0; segment < SEGMENTS; segment++ ){
+		if( !segment_used[segment] ) continue;
+		for( tries = 0; tries < BLOCK_RETRIES; tries++ ){
+			result = send_block( segment );
+			if( result == BOOT_OK || result == TOOL_ERROR ) break;
+			fprintf( stderr, "block 0x%04X: %s, retrying\n", BOOT_APP_START + segment * BOOT_SEGMENT_SIZE, result_name( result ) );
+		}
+		if( result != BOOT_OK ){
+			fprintf( stderr, "block 0x%04X failed\n", BOOT_APP_START + segment * BOOT_SEGMENT_SIZE );
+			return 1;
+		}
+		blocks++;
+		printf( "\r%d blocks", blocks );
+		fflush( stdout );
+	}
+	printf( "\n" );
+
+	crc = crc16( BOOT_CRC_SEED, image, APP_BYTES );
+	if( command( BOOT_CMD_DONE, crc, REPLY_TIMEOUT_MS, &reply ) ) return 1;
+	if( reply.result != BOOT_OK ){
+		fprintf( stderr, "image check failed: %s\n", result_name( reply.result ) );
+		return 1;
+	}
+	if( command( BOOT_CMD_RUN, 0, REPLY_TIMEOUT_MS, &reply ) ) return 1;
+	printf( "%d bytes in %d blocks, %.1f s\n", used, blocks, (now_ms() - start) / 1000.0 );
+	return 0;
+}
+
+int main( int argc, char **argv )
+{
+	const char *interface = "can0";
+	reply_t reply;
+	int opt, result = 0;
+
+	while( (opt = getopt( argc, argv, "i:" )) != -1 ){
+		if( opt == 'i' ) interface = optarg;
+		else usage();
+	}
+	if( optind >= argc ) usage();
+	sock = open_can( interface );
+
+	if( strcmp( argv[optind], "flash" ) == 0 && argc - optind == 2 ){
+		result = flash( argv[optind + 1] );
+	}
+	else if( strcmp( argv[optind], "ping" ) == 0 ){
+		if( enter_bootloader( &reply ) ) return 1;
+		printf( "bootloader: application region 0x%04X - 0x%04X\n", reply.value_a, reply.value_b - 1 );
+	}
+	else if( strcmp( argv[optind], "run" ) == 0 ){
+		if( command( BOOT_CMD_RUN, 0, REPLY_TIMEOUT_MS, &reply ) ) return 1;
+		printf( "run: %s\n", result_name( reply.result ) );
+		result = reply.result != BOOT_OK;
+	}
+	else{
+		usage();
+	}
+	close( sock );
+	return result;
+}
@@ -0,0 +1,289 @@
+/*
+ * Driver controls parameter tool for Linux SocketCAN
+ *
+ * Reads, writes and commits driver controls tuning parameters using the protocol in
+ * sc8_driver_controls/param.h.  Works on any SocketCAN interface, including a vcan
+ * interface for testing without hardware:
+ *
+ *		sudo modprobe vcan
+ *		sudo ip link add dev vcan0 type vcan
+ *		sudo ip link set up vcan0
+ *
+ * Build:
+ *		gcc -Wall -O2 -o dcparam dcparam.c
+ *
+ * Usage:
+ *		dcparam [-i interface] list
+ *		dcparam [-i interface] get <index|name>
+ *		dcparam [-i interface] set <index|name> <value>
+ *		dcparam [-i interface] commit
+ *		dcparam [-i interface] defaults
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+// Must match can.h and param.h in the firmware
+#define DC_CAN_BASE			0x500
+#define DC_PARAM			20
+#define DC_PARAM_REPLY		21
+
+#define PARAM_CMD_INFO		0x00
+#define PARAM_CMD_READ		0x01
+#define PARAM_CMD_WRITE		0x02
+#define PARAM_CMD_COMMIT	0x03
+#define PARAM_CMD_DEFAULTS	0x04
+
+#define PARAM_TYPE_FLOAT	1
+
+#define REPLY_TIMEOUT_MS	500
+
+// Names by index, as listed in param.h
+static const char *param_names[] = {
+	"pedal_travel_min",
+	"pedal_travel_max",
+	"regen_travel_min",
+	"regen_travel_max",
+	"regen_brake",
+	"rpm_fwd_max",
+	"rpm_rev_max",
+	"engage_vel_f",
+	"engage_vel_r",
+	"change_vel_ltoh",
+	"change_vel_htol",
+	"regen_threshold",
+	"gauge1_scale",
+	"gauge2_scale",
+	"device_id",
+	"regen_volt_max",
+	"power_volt_min",
+	"power_current_max",
+};
+#define PARAM_NAMES		(sizeof(param_names) / sizeof(param_names[0]))
+
+static const char *result_names[] = { "ok", "bad index", "flash error", "bad command", "busy (not stopped in neutral or off, or no speed from the motor controller)", "out of range", "full (too many parameters away from their defaults)" };
+
+typedef struct {
+	uint8_t command;
+	uint8_t index;
+	int8_t result;
+	uint8_t type;
+	uint8_t value[4];
+} reply_t;
+
+static int sock;
+
+static void usage( void )
+{
+	fprintf( stderr,
+		"usage: dcparam [-i interface] list\n"
+		"       dcparam [-i interface] get <index|name>\n"
+		"       dcparam [-i interface] set <index|name> <value>\n"
+		"       dcparam [-i interface] commit\n"
+		"       dcparam [-i interface] defaults\n" );
+	exit( 2 );
+}
+
+static int open_can( const char *name )
+{
+	struct sockaddr_can addr;
+	struct ifreq ifr;
+	struct can_filter filter;
+	int s;
+
+	s = socket( PF_CAN, SOCK_RAW, CAN_RAW );
+	if( s < 0 ){
+		perror( "socket" );
+		exit( 1 );
+	}
+	memset( &ifr, 0, sizeof(ifr) );
+	strncpy( ifr.ifr_name, name, IFNAMSIZ - 1 );
+	if( ioctl( s, SIOCGIFINDEX, &ifr ) < 0 ){
+		perror( name );
+		exit( 1 );
+	}
+	// Only listen for replies
+	filter.can_id = DC_CAN_BASE + DC_PARAM_REPLY;
+	filter.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	setsockopt( s, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter) );
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if( bind( s, (struct sockaddr *)&addr, sizeof(addr) ) < 0 ){
+		perror( "bind" );
+		exit( 1 );
+	}
+	return s;
+}
+
+static long long now_ms( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Sends a request and waits up to REPLY_TIMEOUT_MS in all for the matching reply, returns 0 on success
+static int transact( uint8_t command, uint8_t index, const uint8_t *value, reply_t *reply )
+{
+	struct can_frame frame;
+	struct pollfd pfd;
+	long long deadline, remaining;
+
+	memset( &frame, 0, sizeof(frame) );
+	frame.can_id = DC_CAN_BASE + DC_PARAM;
+	frame.can_dlc = 8;
+	frame.data[0] = command;
+	frame.data[1] = index;
+	if( value != NULL ) memcpy( &frame.data[4], value, 4 );
+	if( write( sock, &frame, sizeof(frame) ) != sizeof(frame) ){
+		perror( "write" );
+		return -1;
+	}
+
+	// Other traffic on the ID mustn't keep extending the wait
+	deadline = now_ms() + REPLY_TIMEOUT_MS;
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	while( (remaining = deadline - now_ms()) > 0 && poll( &pfd, 1, remaining ) > 0 ){
+		if( read( sock, &frame, sizeof(frame) ) != sizeof(frame) ) continue;
+		if( frame.can_dlc != 8 || frame.data[0] != command || frame.data[1] != index ) continue;
+		reply->command = frame.data[0];
+		reply->index = frame.data[1];
+		reply->result = (int8_t)frame.data[2];
+		reply->type = frame.data[3];
+		memcpy( reply->value, &frame.data[4], 4 );
+		return 0;
+	}
+	fprintf( stderr, "no reply from driver controls\n" );
+	return -1;
+}
+
+static const char *result_name( int8_t result )
+{
+	if( result <= 0 && -result < (int)(sizeof(result_names) / sizeof(result_names[0])) ) return result_names[-result];
+	return "unknown error";
+}
+
+// Value bytes are little endian, as stored by the MSP430
+static void print_value( const reply_t *reply )
+{
+	uint32_t raw;
+	float fp;
+
+	raw = reply->value[0] | (reply->value[1] << 8) | (reply->value[2] << 16) | ((uint32_t)reply->value[3] << 24);
+	printf( "%3u  %-18s ", reply->index, reply->index < PARAM_NAMES ? param_names[reply->index] : "?" );
+	if( reply->type == PARAM_TYPE_FLOAT ){
+		memcpy( &fp, &raw, 4 );
+		printf( "%g\n", fp );
+	}
+	else{
+		printf( "%d\n", (int16_t)(raw & 0xFFFF) );
+	}
+}
+
+static int parse_index( const char *arg )
+{
+	unsigned int i;
+	char *end;
+	long n;
+
+	for( i = 0; i < PARAM_NAMES; i++ ){
+		if( strcmp( arg, param_names[i] ) == 0 ) return i;
+	}
+	n = strtol( arg, &end, 0 );
+	if( *end != '\0' || n < 0 || n > 255 ){
+		fprintf( stderr, "unknown parameter '%s'\n", arg );
+		exit( 2 );
+	}
+	return (int)n;
+}
+
+int main( int argc, char **argv )
+{
+	const char *interface = "can0";
+	reply_t reply;
+	uint8_t value[4];
+	uint32_t raw;
+	float fp;
+	int opt, index, count, i;
+
+	while( (opt = getopt( argc, argv, "i:" )) != -1 ){
+		if( opt == 'i' ) interface = optarg;
+		else usage();
+	}
+	if( optind >= argc ) usage();
+	sock = open_can( interface );
+
+	if( strcmp( argv[optind], "list" ) == 0 ){
+		if( transact( PARAM_CMD_INFO, 0, NULL, &reply ) ) return 1;
+		count = reply.value[0];
+		printf( "%d parameters, layout version %d\n", count, reply.value[1] );
+		for( i = 0; i < count; i++ ){
+			if( transact( PARAM_CMD_READ, i, NULL, &reply ) ) return 1;
+			print_value( &reply );
+		}
+	}
+	else if( strcmp( argv[optind], "get" ) == 0 && argc - optind == 2 ){
+		index = parse_index( argv[optind + 1] );
+		if( transact( PARAM_CMD_READ, index, NULL, &reply ) ) return 1;
+		if( reply.result != 0 ){
+			fprintf( stderr, "read failed: %s\n", result_name( reply.result ) );
+			return 1;
+		}
+		print_value( &reply );
+	}
+	else if( strcmp( argv[optind], "set" ) == 0 && argc - optind == 3 ){
+		index = parse_index( argv[optind + 1] );
+		// Read first to learn the parameter type
+		if( transact( PARAM_CMD_READ, index, NULL, &reply ) ) return 1;
+		if( reply.result != 0 ){
+			fprintf( stderr, "read failed: %s\n", result_name( reply.result ) );
+			return 1;
+		}
+		if( reply.type == PARAM_TYPE_FLOAT ){
+			fp = strtof( argv[optind + 2], NULL );
+			memcpy( &raw, &fp, 4 );
+		}
+		else{
+			raw = (uint32_t)strtol( argv[optind + 2], NULL, 0 );
+		}
+		value[0] = raw;
+		value[1] = raw >> 8;
+		value[2] = raw >> 16;
+		value[3] = raw >> 24;
+		if( transact( PARAM_CMD_WRITE, index, value, &reply ) ) return 1;
+		if( reply.result != 0 ){
+			fprintf( stderr, "write failed: %s\n", result_name( reply.result ) );
+			return 1;
+		}
+		print_value( &reply );
+	}
+	else if( strcmp( argv[optind], "commit" ) == 0 ){
+		if( transact( PARAM_CMD_COMMIT, 0, NULL, &reply ) ) return 1;
+		printf( "commit: %s\n", result_name( reply.result ) );
+		return reply.result != 0;
+	}
+	else if( strcmp( argv[optind], "defaults" ) == 0 ){
+		if( transact( PARAM_CMD_DEFAULTS, 0, NULL, &reply ) ) return 1;
+		printf( "defaults restored in RAM, use 'commit' to keep them\n" );
+	}
+	else{
+		usage();
+	}
+	close( sock );
+	return 0;
+}
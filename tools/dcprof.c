@@ -0,0 +1,173 @@
+/*
+ * Driver controls hot path profiler tool for Linux SocketCAN
+ *
+ * Reads the cycle counts measured on the target by a firmware built with USE_PROFILE, using the
+ * protocol in sc8_driver_controls/profile.h, and checks them against the firmware's budgets.
+ * Exits with status 1 if any hot path's worst case (maximum) cost is over its budget, so it can
+ * gate a bench run: reset, drive the inputs through the scenario, then report.  The maximum takes
+ * in any interrupts serviced during the run, as the main loop sees them; the minimum is shown for
+ * comparison.  For exact per-scenario counts without a target, see tools/dcbench.
+ *
+ * Build:
+ *		gcc -Wall -O2 -o dcprof dcprof.c
+ *
+ * Usage:
+ *		dcprof [-i interface] report
+ *		dcprof [-i interface] reset
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+// Must match can.h and profile.h in the firmware
+#define DC_CAN_BASE			0x500
+#define DC_PROFILE			26
+
+#define PROFILE_CMD_REPORT	0x00
+#define PROFILE_CMD_RESET	0x01
+#define PROFILE_REPLY		0x80
+
+#define REPLY_TIMEOUT_MS	500
+
+// Names by slot, as listed in profile.h
+static const char *slot_names[] = {
+	"process_pedal",
+	"state_machine",
+	"can_receive",
+	"gauge_tach_update",
+};
+#define PROFILE_SLOTS		(sizeof(slot_names) / sizeof(slot_names[0]))
+
+static int sock;
+
+static void usage( void )
+{
+	fprintf( stderr,
+		"usage: dcprof [-i interface] report\n"
+		"       dcprof [-i interface] reset\n" );
+	exit( 2 );
+}
+
+static int open_can( const char *name )
+{
+	struct sockaddr_can addr;
+	struct ifreq ifr;
+	struct can_filter filter;
+	int s;
+
+	s = socket( PF_CAN, SOCK_RAW, CAN_RAW );
+	if( s < 0 ){
+		perror( "socket" );
+		exit( 1 );
+	}
+	memset( &ifr, 0, sizeof(ifr) );
+	strncpy( ifr.ifr_name, name, IFNAMSIZ - 1 );
+	if( ioctl( s, SIOCGIFINDEX, &ifr ) < 0 ){
+		perror( name );
+		exit( 1 );
+	}
+	filter.can_id = DC_CAN_BASE + DC_PROFILE;
+	filter.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	setsockopt( s, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter) );
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if( bind( s, (struct sockaddr *)&addr, sizeof(addr) ) < 0 ){
+		perror( "bind" );
+		exit( 1 );
+	}
+	return s;
+}
+
+static int send_command( uint8_t command )
+{
+	struct can_frame frame;
+
+	memset( &frame, 0, sizeof(frame) );
+	frame.can_id = DC_CAN_BASE + DC_PROFILE;
+	frame.can_dlc = 8;
+	frame.data[0] = command;
+	if( write( sock, &frame, sizeof(frame) ) != sizeof(frame) ){
+		perror( "write" );
+		return -1;
+	}
+	return 0;
+}
+
+// Collects one reply per slot, prints them, returns the number of slots over budget or -1
+static int report( void )
+{
+	struct can_frame frame;
+	struct pollfd pfd;
+	unsigned int seen, slot, min, max, budget, over;
+	int failed;
+
+	if( send_command( PROFILE_CMD_REPORT ) ) return -1;
+
+	printf( "%-18s %8s %8s %8s %6s\n", "path", "min", "max", "budget", "over" );
+	seen = 0;
+	failed = 0;
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	while( seen != (1u << PROFILE_SLOTS) - 1 && poll( &pfd, 1, REPLY_TIMEOUT_MS ) > 0 ){
+		if( read( sock, &frame, sizeof(frame) ) != sizeof(frame) ) continue;
+		if( frame.can_dlc != 8 || !(frame.data[0] & PROFILE_REPLY) ) continue;
+		slot = frame.data[0] & ~PROFILE_REPLY;
+		if( slot >= PROFILE_SLOTS ) continue;
+		// Little endian, as stored by the MSP430
+		over = frame.data[1];
+		min = frame.data[2] | (frame.data[3] << 8);
+		max = frame.data[4] | (frame.data[5] << 8);
+		budget = frame.data[6] | (frame.data[7] << 8);
+		printf( "%-18s %8u %8u %8u %6u%s\n", slot_names[slot], min, max, budget, over,
+			max > budget ? "  OVER BUDGET" : (max == 0 ? "  (not run)" : "") );
+		if( max > budget ) failed++;
+		seen |= 1u << slot;
+	}
+	if( seen != (1u << PROFILE_SLOTS) - 1 ){
+		fprintf( stderr, "no reply from driver controls (firmware built without USE_PROFILE?)\n" );
+		return -1;
+	}
+	return failed;
+}
+
+int main( int argc, char **argv )
+{
+	const char *interface = "can0";
+	int opt, failed;
+
+	while( (opt = getopt( argc, argv, "i:" )) != -1 ){
+		if( opt == 'i' ) interface = optarg;
+		else usage();
+	}
+	if( optind >= argc ) usage();
+	sock = open_can( interface );
+
+	if( strcmp( argv[optind], "report" ) == 0 ){
+		failed = report();
+		if( failed < 0 ) return 1;
+		if( failed > 0 ){
+			fprintf( stderr, "%d hot path%s over budget\n", failed, failed == 1 ? "" : "s" );
+			return 1;
+		}
+	}
+	else if( strcmp( argv[optind], "reset" ) == 0 ){
+		if( send_command( PROFILE_CMD_RESET ) ) return 1;
+	}
+	else{
+		usage();
+	}
+	close( sock );
+	return 0;
+}
@@ -0,0 +1,365 @@
+/*
+ * Driver controls CAN log replay harness
+ *
+ * Feeds a candump log through the firmware's own receive dispatch (vehicle.c), drive state
+ * machine (drive.c), pedal processing (pedal.c), gauge updates (gauge.c), bus current limit
+ * (power.c) and comms schedule (comms.c), compiled for the host, and prints the frames the driver
+ * controls would have sent, in candump log format so they can be diffed against the recording:
+ * DC_DRIVE on the comms event, DC_POWER, DC_SWITCH and the ID frame at their schedule slots, and
+ * DC_SWITCH again on every switch change.  With MC_COUNT above one, there is a DC_DRIVE and a
+ * DC_POWER frame per motor controller, at its own base.
+ *
+ * Built with -DUSE_TRACE, the pedal to bus latency trace (trace.c) follows the drive frames too, and
+ * its percentiles are printed at the end.  Timer A isn't simulated, so stages are at tick resolution,
+ * and the bus is ideal: frames go out, and are acknowledged, as soon as they are queued.  What it shows
+ * is the scheduling latency from a pedal sample to the comms event that sends it.
+ *
+ * Switch positions come from the recorded DC_SWITCH frames.  Pedal and regen slider positions
+ * aren't on the bus, so they are held at the -a and -c ADC values.  Parameters are the
+ * compiled-in defaults, from param.c.  Time is taken from the log: each 10ms tick runs the Timer A
+ * tick, then the ADC event, and the comms event every COMMS_SPEED ticks, in the main loop's order.
+ *
+ * Build, from the repository root:
+ *		gcc -Wall -Wno-int-to-pointer-cast -O2 -fcommon -Itools/host -Isc8_driver_controls -o dcreplay tools/dcreplay.c \
+ *			sc8_driver_controls/vehicle.c sc8_driver_controls/drive.c sc8_driver_controls/pedal.c sc8_driver_controls/gauge.c \
+ *			sc8_driver_controls/atomic.c sc8_driver_controls/trace.c sc8_driver_controls/comms.c \
+ *			sc8_driver_controls/power.c sc8_driver_controls/param.c
+ *
+ * Usage:
+ *		dcreplay [-r] [-q] [-n passes] [-a pedal] [-c slider] <candump.log>
+ *			-r	replay in real time rather than as fast as possible
+ *			-q	no frame output, just the throughput summary (for benchmarking)
+ *			-n	replay the log this many times back to back
+ *
+ * Record a log with:
+ *		candump -l can0
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <msp430x24x.h>
+#include "tri86.h"
+#include "can.h"
+#include "param.h"
+#include "pedal.h"
+#include "gauge.h"
+#include "clock.h"
+#include "vehicle.h"
+#include "drive.h"
+#include "power.h"
+#include "comms.h"
+#include "supervisor.h"
+#include "atomic.h"
+#include "trace.h"
+
+// Firmware state normally defined by modules the harness leaves out
+volatile unsigned char P5OUT;
+can_variables can;
+unsigned long clock_hz = INPUT_CLOCK;
+volatile unsigned int tick_count;
+volatile unsigned int TAR;
+volatile unsigned int TACCTL0;
+volatile unsigned int ADC12MEM0;
+volatile unsigned int ADC12MEM2;
+volatile unsigned int FCTL1;
+volatile unsigned int FCTL2;
+volatile unsigned int FCTL3;
+can_variables can_frame_out;
+can_variables *can_push_ptr = &can_frame_out;
+
+#define TICK_US				(1000000 / TICK_RATE)
+
+typedef struct {
+	int64_t time_us;
+	unsigned long id;
+	uint8_t dlc;
+	uint8_t rtr;
+	uint8_t data[8];
+} frame_t;
+
+static frame_t *frames;
+static size_t frame_count;
+
+static unsigned int switches;
+static unsigned int switches_sent;
+static unsigned int pedal_a;
+static unsigned int slider_c;
+static unsigned int comms_count = COMMS_SPEED;
+static int quiet;
+static unsigned long outputs;
+static int64_t tick_time_us;
+
+static void usage( void )
+{
+	fprintf( stderr, "usage: dcreplay [-r] [-q] [-n passes] [-a pedal] [-c slider] <candump.log>\n" );
+	exit( 2 );
+}
+
+static int hex_nibble( char c )
+{
+	if( c >= '0' && c <= '9' ) return c - '0';
+	if( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+	if( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+	return -1;
+}
+
+// Parses one candump -l line: (seconds.micros) interface id#data, returns 0 on success
+static int parse_line( const char *line, frame_t *frame )
+{
+	long long sec, usec;
+	char interface[32], body[64];
+	const char *p;
+	char *end;
+	int hi, lo;
+
+	if( sscanf( line, " (%lld.%lld) %31s %63s", &sec, &usec, interface, body ) != 4 ) return -1;
+	memset( frame, 0, sizeof(*frame) );
+	frame->time_us = sec * 1000000 + usec;
+	frame->id = strtoul( body, &end, 16 );
+	if( *end != '#' || end[1] == '#' ) return -1;		// CAN FD frames aren't on our bus
+	if( end - body > 3 ) frame->id |= CAN_EXTENDED;		// 8 digit IDs are 29-bit, as in the firmware
+	p = end + 1;
+	if( *p == 'R' ){
+		frame->rtr = 1;
+		return 0;
+	}
+	while( frame->dlc < 8 && (hi = hex_nibble( p[0] )) >= 0 && (lo = hex_nibble( p[1] )) >= 0 ){
+		frame->data[frame->dlc++] = (hi << 4) | lo;
+		p += 2;
+	}
+	return 0;
+}
+
+static void load_log( const char *path )
+{
+	char line[256];
+	size_t capacity = 0;
+	FILE *f;
+
+	f = fopen( path, "r" );
+	if( f == NULL ){
+		perror( path );
+		exit( 1 );
+	}
+	while( fgets( line, sizeof(line), f ) != NULL ){
+		if( frame_count == capacity ){
+			capacity = capacity ? capacity * 2 : 4096;
+			frames = realloc( frames, capacity * sizeof(frame_t) );
+			if( frames == NULL ){
+				perror( "realloc" );
+				exit( 1 );
+			}
+		}
+		if( parse_line( line, &frames[frame_count] ) == 0 ) frame_count++;
+	}
+	fclose( f );
+	if( frame_count == 0 ){
+		fprintf( stderr, "%s: no CAN frames\n", path );
+		exit( 1 );
+	}
+}
+
+static void print_frame( int64_t time_us, unsigned long id, const group_64 *data )
+{
+	int i;
+
+	outputs++;
+	if( quiet ) return;
+	printf( "(%lld.%06lld) replay %03lX#", (long long)(time_us / 1000000), (long long)(time_us % 1000000), id );
+	for( i = 0; i < 8; i++ ) printf( "%02X", data->data_u8[i] );
+	printf( "\n" );
+}
+
+// Frames the firmware queues for transmit (drive_send) are printed at the current tick's time, and go straight out
+void can_push( void )
+{
+	TRACE_TRANSMIT( can_push_ptr );
+	print_frame( tick_time_us, can_push_ptr->address, &can_push_ptr->data );
+	memset( can_push_ptr, 0, sizeof(*can_push_ptr) );
+}
+
+// MCP2515 access from the trace: every transmission has completed by the time it's polled
+void can_mod( unsigned char address, unsigned char mask, unsigned char data )
+{
+}
+
+unsigned char can_read_status( void )
+{
+	return( TRACE_STATUS_TX0IF );
+}
+
+unsigned char can_queue_free( void )
+{
+	return( CAN_BUF_LEN - 1 );
+}
+
+// Parameter commits never run, nothing to supervise
+void supervisor_hold( void )
+{
+}
+
+void supervisor_resume( void )
+{
+}
+
+#ifdef USE_TRACE
+static void print_trace( void )
+{
+	static const char *names[TRACE_INTERVALS] = { "adc_convert", "pedal", "comms_wait", "can_queue", "can_bus", "total" };
+	int i;
+
+	fprintf( stderr, "%-12s %8s %8s %8s   us, %u samples, %u lost\n", "interval", "p50", "p90", "p99", trace_count, trace_lost );
+	for( i = 0; i < TRACE_INTERVALS; i++ ){
+		fprintf( stderr, "%-12s %8u %8u %8u\n", names[i], trace_percentile( i, 50 ) * TRACE_UNIT_US,
+			trace_percentile( i, 90 ) * TRACE_UNIT_US, trace_percentile( i, 99 ) * TRACE_UNIT_US );
+	}
+}
+#endif
+
+// One 10ms tick: Timer A, then the main loop's timer, ADC and (every COMMS_SPEED ticks) comms events
+static void tick( int64_t time_us )
+{
+	unsigned char comms;
+
+	tick_time_us = time_us;
+
+	// Timer A ISR
+	tick_count++;
+	comms = FALSE;
+	comms_count--;
+	if( comms_count == 0 ){
+		comms_count = COMMS_SPEED;
+		comms = TRUE;
+	}
+	comms_phase = COMMS_SPEED - comms_count;
+
+	// Timer event
+	vehicle_tick();
+	power_tick();
+	comms_schedule( switches );
+
+	// ADC event
+	TRACE_MARK( TRACE_ADC_START );
+	TRACE_MARK( TRACE_ADC_DONE );
+	ADC12MEM0 = pedal_a;
+	ADC12MEM2 = slider_c;
+#ifdef REGEN_ON_BRAKE
+	process_pedal( pedal_a, pedal_a, slider_c, (switches & SW_BRAKE) );
+#else
+	process_pedal( pedal_a, pedal_a, slider_c, FALSE );
+#endif
+	TRACE_MARK( TRACE_COMMAND );
+	command.state = drive_state( switches );
+	if( !(switches & (SW_IGN_ACC | SW_IGN_ON)) ) event_clear( EVENT_CONNECTED );
+	if(( switches != switches_sent ) && ( events & EVENT_CONNECTED )){
+#ifdef USE_COMPACT_TELEMETRY
+		send_status( switches );
+#else
+		send_switches( switches );
+#endif
+	}
+	switches_sent = switches;
+
+	// Comms event
+	if( comms ){
+		drive_limit( switches );
+		if( events & EVENT_CONNECTED ) drive_send();
+#ifdef USE_TRACE
+		trace_poll();
+#endif
+	}
+}
+
+static void dispatch( const frame_t *frame )
+{
+	// The recorded driver controls' switch report is our input
+	if( frame->id == DC_CAN_BASE + DC_SWITCH && !frame->rtr && frame->dlc >= 2 ){
+		switches = (frame->data[0] | (frame->data[1] << 8)) & SWITCH_INPUTS;
+		return;
+	}
+	if( frame->rtr ) return;
+	event_post( EVENT_CONNECTED );
+	can.address = frame->id;
+	can.status = CAN_OK;
+	memset( &can.data, 0, sizeof(can.data) );
+	memcpy( can.data.data_u8, frame->data, frame->dlc );
+	vehicle_receive();
+}
+
+static int64_t wall_us( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int main( int argc, char **argv )
+{
+	int64_t next_tick, offset, log_span, start, elapsed, now;
+	unsigned long dispatched = 0;
+	int opt, realtime = 0, passes = 1, pass;
+	size_t i;
+
+	while( (opt = getopt( argc, argv, "rqn:a:c:" )) != -1 ){
+		switch( opt ){
+			case 'r': realtime = 1; break;
+			case 'q': quiet = 1; break;
+			case 'n': passes = atoi( optarg ); break;
+			case 'a': pedal_a = strtoul( optarg, NULL, 0 ); break;
+			case 'c': slider_c = strtoul( optarg, NULL, 0 ); break;
+			default: usage();
+		}
+	}
+	if( optind != argc - 1 || passes < 1 ) usage();
+	load_log( argv[optind] );
+
+	param_defaults();
+	command.rpm = 0.0;
+	command.current = 0.0;
+	drive_init();
+	power_init();
+	command.flags = 0x00;
+	command.state = MODE_OFF;
+	gauge_init();
+	event_post( EVENT_CONNECTED );
+#ifdef USE_TRACE
+	trace_init();
+#endif
+
+	// Later passes carry on in log time where the last one ended
+	log_span = frames[frame_count - 1].time_us - frames[0].time_us + TICK_US;
+	next_tick = frames[0].time_us + TICK_US;
+	start = wall_us();
+	for( pass = 0; pass < passes; pass++ ){
+		offset = pass * log_span;
+		for( i = 0; i < frame_count; i++ ){
+			if( realtime ){
+				now = wall_us() - start;
+				if( frames[i].time_us + offset - frames[0].time_us > now ) usleep( frames[i].time_us + offset - frames[0].time_us - now );
+			}
+			while( frames[i].time_us + offset >= next_tick ){
+				tick( next_tick );
+				next_tick += TICK_US;
+			}
+			dispatch( &frames[i] );
+			dispatched++;
+		}
+	}
+	elapsed = wall_us() - start;
+	if( elapsed < 1 ) elapsed = 1;
+
+	fprintf( stderr, "%lu frames in %.3f s, %.0f frames/s, %lu frames out\n",
+		dispatched, elapsed / 1e6, dispatched * 1e6 / elapsed, outputs );
+#ifdef USE_TRACE
+	print_trace();
+#endif
+	free( frames );
+	return 0;
+}
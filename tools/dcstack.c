@@ -0,0 +1,153 @@
+/*
+ * Driver controls RAM budget tool for Linux SocketCAN
+ *
+ * Asks the driver controls for their RAM usage, using the protocol in sc8_driver_controls/stack.h,
+ * and prints the budget: static sections, stack high water mark, and never used RAM, plus how deep
+ * the stack was on entry to each interrupt.  The high water mark is rescanned once a second, so run
+ * the scenario of interest first.  Exits with status 1 if less than the -m margin was never used.
+ *
+ * Build:
+ *		gcc -Wall -O2 -o dcstack dcstack.c
+ *
+ * Usage:
+ *		dcstack [-i interface] [-m margin]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+// Must match can.h and stack.h in the firmware
+#define DC_CAN_BASE			0x500
+#define DC_STACK			28
+#define DC_STACK_ISR		29
+
+#define REPLY_TIMEOUT_MS	500
+#define MARGIN_DEFAULT		256			// Bytes
+
+// Probed ISRs, as listed in stack.h
+static const char *isr_names[] = {
+	"timer_a0",
+	"timer_b0",
+	"adc_isr",
+	"uart_tx_isr",
+};
+
+static int sock;
+
+static void usage( void )
+{
+	fprintf( stderr, "usage: dcstack [-i interface] [-m margin]\n" );
+	exit( 2 );
+}
+
+static int open_can( const char *name )
+{
+	struct sockaddr_can addr;
+	struct ifreq ifr;
+	struct can_filter filter[2];
+	int s;
+
+	s = socket( PF_CAN, SOCK_RAW, CAN_RAW );
+	if( s < 0 ){
+		perror( "socket" );
+		exit( 1 );
+	}
+	memset( &ifr, 0, sizeof(ifr) );
+	strncpy( ifr.ifr_name, name, IFNAMSIZ - 1 );
+	if( ioctl( s, SIOCGIFINDEX, &ifr ) < 0 ){
+		perror( name );
+		exit( 1 );
+	}
+	filter[0].can_id = DC_CAN_BASE + DC_STACK;
+	filter[0].can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	filter[1].can_id = DC_CAN_BASE + DC_STACK_ISR;
+	filter[1].can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	setsockopt( s, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter) );
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if( bind( s, (struct sockaddr *)&addr, sizeof(addr) ) < 0 ){
+		perror( "bind" );
+		exit( 1 );
+	}
+	return s;
+}
+
+static unsigned int u16( const struct can_frame *frame, int word )
+{
+	// Little endian, as stored by the MSP430
+	return frame->data[word * 2] | (frame->data[word * 2 + 1] << 8);
+}
+
+int main( int argc, char **argv )
+{
+	const char *interface = "can0";
+	struct can_frame frame, budget, isr;
+	struct pollfd pfd;
+	unsigned int margin = MARGIN_DEFAULT, i;
+	int opt, seen = 0;
+
+	while( (opt = getopt( argc, argv, "i:m:" )) != -1 ){
+		if( opt == 'i' ) interface = optarg;
+		else if( opt == 'm' ) margin = strtoul( optarg, NULL, 0 );
+		else usage();
+	}
+	if( optind != argc ) usage();
+	sock = open_can( interface );
+
+	memset( &budget, 0, sizeof(budget) );
+	memset( &isr, 0, sizeof(isr) );
+	memset( &frame, 0, sizeof(frame) );
+	frame.can_id = (DC_CAN_BASE + DC_STACK) | CAN_RTR_FLAG;
+	frame.can_dlc = 8;
+	if( write( sock, &frame, sizeof(frame) ) != sizeof(frame) ){
+		perror( "write" );
+		return 1;
+	}
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	while( seen != 3 && poll( &pfd, 1, REPLY_TIMEOUT_MS ) > 0 ){
+		if( read( sock, &frame, sizeof(frame) ) != sizeof(frame) ) continue;
+		if( (frame.can_id & CAN_RTR_FLAG) || frame.can_dlc != 8 ) continue;
+		if( frame.can_id == DC_CAN_BASE + DC_STACK ){
+			budget = frame;
+			seen |= 1;
+		}
+		else if( frame.can_id == DC_CAN_BASE + DC_STACK_ISR ){
+			isr = frame;
+			seen |= 2;
+		}
+	}
+	close( sock );
+	if( seen != 3 ){
+		fprintf( stderr, "no reply from driver controls\n" );
+		return 1;
+	}
+
+	printf( "%-18s %6s %6s\n", "", "bytes", "%" );
+	printf( "%-18s %6u %5.1f%%\n", "static sections", u16( &budget, 0 ), 100.0 * u16( &budget, 0 ) / u16( &budget, 3 ) );
+	printf( "%-18s %6u %5.1f%%\n", "peak stack", u16( &budget, 1 ), 100.0 * u16( &budget, 1 ) / u16( &budget, 3 ) );
+	printf( "%-18s %6u %5.1f%%\n", "never used", u16( &budget, 2 ), 100.0 * u16( &budget, 2 ) / u16( &budget, 3 ) );
+	printf( "%-18s %6u\n", "total RAM", u16( &budget, 3 ) );
+	printf( "\nstack depth on ISR entry\n" );
+	for( i = 0; i < sizeof(isr_names) / sizeof(isr_names[0]); i++ ){
+		printf( "%-18s %6u%s\n", isr_names[i], u16( &isr, i ), u16( &isr, i ) == 0 ? "  (not run)" : "" );
+	}
+	if( u16( &budget, 2 ) < margin ){
+		fprintf( stderr, "only %u bytes of RAM never used, margin is %u\n", u16( &budget, 2 ), margin );
+		return 1;
+	}
+	return 0;
+}
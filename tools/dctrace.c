@@ -0,0 +1,179 @@
+/*
+ * Driver controls pedal to bus latency trace tool for Linux SocketCAN
+ *
+ * Reads the latency percentiles measured on the target by a firmware built with USE_TRACE, using
+ * the protocol in sc8_driver_controls/trace.h.  Each row is one stage of a pedal change's path to
+ * the bus, from the previous stage, then the whole path.  With -l, exits with status 1 if the 99th
+ * percentile total is over the limit, so it can gate a bench run: reset, work the pedal, then report.
+ *
+ * Build:
+ *		gcc -Wall -O2 -o dctrace dctrace.c
+ *
+ * Usage:
+ *		dctrace [-i interface] [-l limit_ms] report
+ *		dctrace [-i interface] reset
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+// Must match can.h and trace.h in the firmware
+#define DC_CAN_BASE			0x500
+#define DC_TRACE			31
+
+#define TRACE_CMD_REPORT	0x00
+#define TRACE_CMD_RESET		0x01
+#define TRACE_REPLY			0x80
+#define TRACE_UNIT_US		2
+
+#define REPLY_TIMEOUT_MS	500
+
+// Names by interval, as listed in trace.h
+static const char *interval_names[] = {
+	"adc_convert",
+	"pedal",
+	"comms_wait",
+	"can_queue",
+	"can_bus",
+	"total",
+};
+#define TRACE_INTERVALS		(sizeof(interval_names) / sizeof(interval_names[0]))
+
+static int sock;
+
+static void usage( void )
+{
+	fprintf( stderr,
+		"usage: dctrace [-i interface] [-l limit_ms] report\n"
+		"       dctrace [-i interface] reset\n" );
+	exit( 2 );
+}
+
+static int open_can( const char *name )
+{
+	struct sockaddr_can addr;
+	struct ifreq ifr;
+	struct can_filter filter;
+	int s;
+
+	s = socket( PF_CAN, SOCK_RAW, CAN_RAW );
+	if( s < 0 ){
+		perror( "socket" );
+		exit( 1 );
+	}
+	memset( &ifr, 0, sizeof(ifr) );
+	strncpy( ifr.ifr_name, name, IFNAMSIZ - 1 );
+	if( ioctl( s, SIOCGIFINDEX, &ifr ) < 0 ){
+		perror( name );
+		exit( 1 );
+	}
+	filter.can_id = DC_CAN_BASE + DC_TRACE;
+	filter.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	setsockopt( s, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter) );
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if( bind( s, (struct sockaddr *)&addr, sizeof(addr) ) < 0 ){
+		perror( "bind" );
+		exit( 1 );
+	}
+	return s;
+}
+
+static int send_command( uint8_t command )
+{
+	struct can_frame frame;
+
+	memset( &frame, 0, sizeof(frame) );
+	frame.can_id = DC_CAN_BASE + DC_TRACE;
+	frame.can_dlc = 8;
+	frame.data[0] = command;
+	if( write( sock, &frame, sizeof(frame) ) != sizeof(frame) ){
+		perror( "write" );
+		return -1;
+	}
+	return 0;
+}
+
+// Little endian, as stored by the MSP430, in us
+static unsigned long us( const struct can_frame *frame, int index )
+{
+	return (unsigned long)(frame->data[index] | (frame->data[index + 1] << 8)) * TRACE_UNIT_US;
+}
+
+// Collects one reply per interval, prints them, returns 1 if the total is over limit_ms, 0 if not, or -1
+static int report( double limit_ms )
+{
+	struct can_frame frame;
+	struct pollfd pfd;
+	unsigned int seen, interval, samples;
+	int failed;
+
+	if( send_command( TRACE_CMD_REPORT ) ) return -1;
+
+	printf( "%-12s %10s %10s %10s\n", "interval", "p50 us", "p90 us", "p99 us" );
+	seen = 0;
+	failed = 0;
+	samples = 0;
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	while( seen != (1u << TRACE_INTERVALS) - 1 && poll( &pfd, 1, REPLY_TIMEOUT_MS ) > 0 ){
+		if( read( sock, &frame, sizeof(frame) ) != sizeof(frame) ) continue;
+		if( frame.can_dlc != 8 || !(frame.data[0] & TRACE_REPLY) ) continue;
+		interval = frame.data[0] & ~TRACE_REPLY;
+		if( interval >= TRACE_INTERVALS ) continue;
+		samples = frame.data[1];
+		printf( "%-12s %10lu %10lu %10lu\n", interval_names[interval], us( &frame, 2 ), us( &frame, 4 ), us( &frame, 6 ) );
+		if( interval == TRACE_INTERVALS - 1 && limit_ms > 0 && us( &frame, 6 ) > limit_ms * 1000 ) failed = 1;
+		seen |= 1u << interval;
+	}
+	if( seen != (1u << TRACE_INTERVALS) - 1 ){
+		fprintf( stderr, "no reply from driver controls (firmware built without USE_TRACE?)\n" );
+		return -1;
+	}
+	printf( "%u samples%s\n", samples, samples == 0 ? ", move the pedal to trace it" : "" );
+	return failed;
+}
+
+int main( int argc, char **argv )
+{
+	const char *interface = "can0";
+	double limit_ms = 0;
+	int opt, failed;
+
+	while( (opt = getopt( argc, argv, "i:l:" )) != -1 ){
+		if( opt == 'i' ) interface = optarg;
+		else if( opt == 'l' ) limit_ms = atof( optarg );
+		else usage();
+	}
+	if( optind >= argc ) usage();
+	sock = open_can( interface );
+
+	if( strcmp( argv[optind], "report" ) == 0 ){
+		failed = report( limit_ms );
+		if( failed < 0 ) return 1;
+		if( failed > 0 ){
+			fprintf( stderr, "99th percentile total over %.1f ms\n", limit_ms );
+			return 1;
+		}
+	}
+	else if( strcmp( argv[optind], "reset" ) == 0 ){
+		if( send_command( TRACE_CMD_RESET ) ) return 1;
+	}
+	else{
+		usage();
+	}
+	close( sock );
+	return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Driver controls expansion UART telemetry reader
+ *
+ * Decodes the framed binary records streamed by a firmware built with USE_UART_TELEMETRY, using
+ * the framing in sc8_driver_controls/uart.h, and prints them as CSV for logging or plotting.
+ * Frames with a bad CRC are skipped and the reader resynchronises on the next sync pair.  Lost
+ * frames (sequence gaps), CRC errors and the firmware's own ring drops are summarised on exit.
+ *
+ * Build:
+ *		gcc -Wall -O2 -o dcuart dcuart.c
+ *
+ * Usage:
+ *		dcuart [-b baud] <device or file>
+ *			-b	line rate for a serial device, default 230400 (UART_BAUD)
+ *
+ * A regular file, such as a raw capture taken with cat, is read as is.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/stat.h>
+
+// Must match uart.h in the firmware
+#define UART_SYNC_1			0xA5
+#define UART_SYNC_2			0x5A
+#define UART_TELEMETRY		0x01
+#define TELEMETRY_LEN		40
+
+static volatile sig_atomic_t stop;
+static unsigned long frames, crc_errors, lost;
+static unsigned int drops;
+
+static void usage( void )
+{
+	fprintf( stderr, "usage: dcuart [-b baud] <device or file>\n" );
+	exit( 2 );
+}
+
+static void on_signal( int sig )
+{
+	(void)sig;
+	stop = 1;
+}
+
+static speed_t baud_code( long baud )
+{
+	switch( baud ){
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+	}
+	fprintf( stderr, "unsupported baud rate %ld\n", baud );
+	exit( 2 );
+}
+
+static int open_port( const char *path, long baud )
+{
+	struct termios tio;
+	struct stat st;
+	int fd;
+
+	fd = open( path, O_RDONLY | O_NOCTTY );
+	if( fd < 0 ){
+		perror( path );
+		exit( 1 );
+	}
+	if( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) ) return fd;
+	if( tcgetattr( fd, &tio ) < 0 ){
+		perror( path );
+		exit( 1 );
+	}
+	cfmakeraw( &tio );
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed( &tio, baud_code( baud ) );
+	cfsetospeed( &tio, baud_code( baud ) );
+	if( tcsetattr( fd, TCSANOW, &tio ) < 0 ){
+		perror( path );
+		exit( 1 );
+	}
+	tcflush( fd, TCIFLUSH );
+	return fd;
+}
+
+// CRC-16 CCITT, as uart_crc() in the firmware
+static uint16_t crc_byte( uint16_t crc, uint8_t data )
+{
+	int bit;
+
+	crc ^= (uint16_t)data << 8;
+	for( bit = 0; bit < 8; bit++ ){
+		if( crc & 0x8000 ) crc = (crc << 1) ^ 0x1021;
+		else crc = crc << 1;
+	}
+	return crc;
+}
+
+// Little endian, as stored by the MSP430
+static unsigned int u16( const uint8_t *p )
+{
+	return p[0] | (p[1] << 8);
+}
+
+static float f32( const uint8_t *p )
+{
+	uint32_t bits;
+	float value;
+
+	bits = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	memcpy( &value, &bits, sizeof(value) );
+	return value;
+}
+
+// Field offsets follow uart_telemetry in uart.h
+static void print_telemetry( const uint8_t *p )
+{
+	printf( "%u,%u,%u,%u,0x%04X,%u,0x%02X,%.4f,%.1f,%.4f,%.1f,%.2f,%.2f,%u,%u,%u,%u\n",
+		u16( p + 0 ), u16( p + 2 ), u16( p + 4 ), u16( p + 6 ), u16( p + 8 ), p[10], p[11],
+		f32( p + 12 ), f32( p + 16 ), f32( p + 20 ), f32( p + 24 ), f32( p + 28 ), f32( p + 32 ),
+		p[36], p[37], p[38], p[39] );
+	drops = p[39];
+}
+
+int main( int argc, char **argv )
+{
+	uint8_t buf[4096], frame[256 + 7];
+	long baud = 230400;
+	size_t fill = 0, need;
+	int opt, fd, first = 1;
+	uint8_t expect = 0;
+	uint16_t crc;
+	ssize_t got;
+	size_t i;
+
+	while( (opt = getopt( argc, argv, "b:" )) != -1 ){
+		if( opt == 'b' ) baud = strtol( optarg, NULL, 0 );
+		else usage();
+	}
+	if( optind != argc - 1 ) usage();
+	fd = open_port( argv[optind], baud );
+	signal( SIGINT, on_signal );
+	signal( SIGTERM, on_signal );
+
+	printf( "tick,pedal_a,pedal_b,slider_c,switches,state,flags,current,rpm,bus_current,"
+		"motor_rpm,battery_voltage,battery_current,can_state,can_free,link,drops\n" );
+	while( !stop ){
+		got = read( fd, buf + fill, sizeof(buf) - fill );
+		if( got <= 0 ) break;
+		fill += got;
+
+		// Hunt for frames, keeping any partial one for the next read
+		i = 0;
+		while( fill - i >= 7 ){
+			if( buf[i] != UART_SYNC_1 || buf[i + 1] != UART_SYNC_2 ){
+				i++;
+				continue;
+			}
+			need = buf[i + 2] + 7;
+			if( fill - i < need ) break;
+			memcpy( frame, buf + i, need );
+			crc = 0xFFFF;
+			for( size_t j = 2; j < need - 2; j++ ) crc = crc_byte( crc, frame[j] );
+			if( crc != u16( frame + need - 2 ) ){
+				crc_errors++;
+				i++;
+				continue;
+			}
+			if( !first && frame[4] != expect ) lost += (uint8_t)(frame[4] - expect);
+			first = 0;
+			expect = frame[4] + 1;
+			frames++;
+			if( frame[3] == UART_TELEMETRY && frame[2] == TELEMETRY_LEN ) print_telemetry( frame + 5 );
+			i += need;
+		}
+		memmove( buf, buf + i, fill - i );
+		fill -= i;
+		fflush( stdout );
+	}
+
+	fprintf( stderr, "%lu frames, %lu lost, %lu CRC errors, %u dropped on the target\n",
+		frames, lost, crc_errors, drops );
+	close( fd );
+	return 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * Host build stand-in for the MSP430x24x register header
+ *
+ * Lets dcreplay compile the firmware's vehicle, drive, pedal, gauge, atomic, trace, comms, power and param
+ * modules on Linux.  Only the registers those modules touch are here, as plain variables defined by the harness.
+ * The parameter store's flash routines link, but the harness never calls them.
+ * The replay harness is single threaded, so the status register always reads with interrupts off.
+ * Built with HOST_INTERRUPTS, as dcatomic is, GIE follows whether the harness's interrupt signal is unmasked.
+ *
+ */
+
+#ifndef HOST_MSP430X24X_H
+#define HOST_MSP430X24X_H
+
+extern volatile unsigned char P5OUT;
+extern volatile unsigned int TAR;
+extern volatile unsigned int TACCTL0;
+extern volatile unsigned int ADC12MEM0;
+extern volatile unsigned int ADC12MEM2;
+extern volatile unsigned int FCTL1;
+extern volatile unsigned int FCTL2;
+extern volatile unsigned int FCTL3;
+
+#define CCIFG			0x0001
+
+#define FWKEY			0xA500
+#define ERASE			0x0002
+#define WRT				0x0040
+#define BUSY			0x0001
+#define LOCK			0x0010
+#define FSSEL_1			0x0040
+
+#define GIE				0x0008
+#ifdef HOST_INTERRUPTS
+extern unsigned int host_read_sr( void );
+#define READ_SR			host_read_sr()
+#else
+#define READ_SR			0
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Host build stand-in for the mspgcc interrupt control header
+ *
+ * There are no interrupts in the replay harness, so enabling and disabling them does nothing.
+ * Built with HOST_INTERRUPTS, as dcatomic is, they mask and unmask the signal standing in for interrupts.
+ *
+ */
+
+#ifndef HOST_SIGNAL_H
+#define HOST_SIGNAL_H
+
+#ifdef HOST_INTERRUPTS
+#include_next <signal.h>			// The harness needs the real one for its signal handling
+extern void host_dint( void );
+extern void host_eint( void );
+#define dint()			host_dint()
+#define eint()			host_eint()
+#else
+#define dint()
+#define eint()
+#endif
+
+#endif